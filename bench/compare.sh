@@ -0,0 +1,52 @@
+#!/bin/sh
+#
+# Compares two results of bench/run.sh and fails if a result of NEW is
+# worse than the same result of OLD by more than THRESHOLD percent. All
+# results are costs, so a larger value is worse.
+#
+# Usage: bench/compare.sh OLD NEW [THRESHOLD]
+#
+#   OLD        the JSON file of the baseline run
+#   NEW        the JSON file of the run to check
+#   THRESHOLD  the allowed increase in percent, defaults to 10
+#
+# Results with a value of 0 in OLD are too small to be compared.
+
+set -eu
+
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 OLD NEW [THRESHOLD]" >&2
+    exit 2
+fi
+
+OLD=$1
+NEW=$2
+THRESHOLD=${3:-10}
+
+# bench/run.sh writes one "name": value pair per line
+awk -v threshold="$THRESHOLD" '
+    {
+        if (!match ($0, /"[a-z0-9_]+": [0-9.]+/))
+            next
+        pair = substr ($0, RSTART, RLENGTH)
+        split (pair, fields, /": /)
+        name = substr (fields[1], 2)
+    }
+    FNR == NR { old[name] = fields[2]; next }
+    {
+        if (!(name in old)) {
+            printf "%-26s %12s %12s\n", name, "-", fields[2]
+            next
+        }
+        change = old[name] > 0 ? (fields[2] - old[name]) * 100 / old[name] : 0
+        flag = change > threshold ? "REGRESSION" : ""
+        if (flag != "")
+            regressions++
+        printf "%-26s %12s %12s %+8.1f%% %s\n", name, old[name], fields[2], change, flag
+    }
+    END {
+        if (regressions > 0) {
+            printf "%d results are more than %s%% worse\n", regressions, threshold
+            exit 1
+        }
+    }' "$OLD" "$NEW"
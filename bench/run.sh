@@ -0,0 +1,420 @@
+#!/bin/sh
+#
+# Runs the benchmark suite and writes the results to a JSON file. tilda is
+# started with a temporary config and cache directory and driven through
+# its D-Bus interface. Every result is a cost, lower is better:
+#
+#   startup_ms               from main() until the deferred startup ended
+#   first_prompt_ms          from main() until the first shell printed
+#   pull_us                  average time to pull the window up or down
+#   new_tab_prompt_us        average time from spawning the shell of a new
+#                            tab until it printed its prompt, measured by
+#                            tilda when the contents of the tab changed
+#   cat_ms                   cat of a large file into a tab
+#   cat_scroll_on_output_ms  the same with scroll_on_output enabled
+#   paste_ms                 pasting PASTE_MB megabytes from the clipboard
+#                            into cat, needs xclip
+#   paste_frame_avg_us       average time between two frames of the
+#                            terminal during that paste
+#   paste_frame_p95_us       upper bound of the 95th percentile of it
+#   title_spam_cpu_ms        CPU time of tilda while a tab changes its
+#                            title as fast as possible
+#   search_100k_us           average time of a search without a match in
+#                            a scrollback of 100000 lines
+#   switch_tab_median_us     median time from FocusTab until the window
+#                            was painted, each of 200 tabs focused once
+#   switch_tab_p95_us        upper bound of the 95th percentile of it
+#   rss_per_tab_kb           resident memory added per tab
+#
+# Usage: bench/run.sh [TILDA] [RESULTS]
+#
+#   TILDA    the tilda binary to run, defaults to "tilda"
+#   RESULTS  the JSON file to write, defaults to bench-results.json
+#
+# The suite runs under xvfb-run and dbus-run-session if there is no display
+# or session bus. No other tilda may be running, the started instance must
+# be instance 0. Compare two results with bench/compare.sh.
+
+set -eu
+
+TILDA=${1:-tilda}
+RESULTS=${2:-bench-results.json}
+
+if [ -z "${DISPLAY:-}" ]; then
+    exec xvfb-run -a "$0" "$TILDA" "$RESULTS"
+fi
+
+if [ -z "${DBUS_SESSION_BUS_ADDRESS:-}" ]; then
+    exec dbus-run-session -- "$0" "$TILDA" "$RESULTS"
+fi
+
+# Lines of the file for the cat benchmark, about 100 bytes each
+CAT_LINES=${CAT_LINES:-500000}
+TITLE_CHANGES=${TITLE_CHANGES:-20000}
+TOGGLES=${TOGGLES:-50}
+NEW_TABS=${NEW_TABS:-10}
+SEARCHES=${SEARCHES:-5}
+TABS=${TABS:-200}
+PASTE_MB=${PASTE_MB:-50}
+
+dir=$(mktemp -d)
+pid=
+clip_pid=
+
+trap 'stop_tilda; stop_xclip; rm -rf "$dir"' EXIT
+
+: > "$dir/results"
+
+call () {
+    method=$1
+    shift
+    gdbus call --session --dest com.github.lanoxx.tilda.Actions0 \
+        --object-path /com/github/lanoxx/tilda/Actions0 \
+        --method "com.github.lanoxx.tilda.Actions.$method" "$@"
+}
+
+now_us () {
+    echo $(( $(date +%s%N) / 1000 ))
+}
+
+result () {
+    echo "$1 $2" >> "$dir/results"
+    echo "$1: $2"
+}
+
+# Opens a tab that runs the shell script $1 and prints its id
+new_tab () {
+    call NewTab "''" "'sh $1'" | sed -n 's/^(uint32 \([0-9]*\),)$/\1/p'
+}
+
+# Waits until the last lines of tab $1 contain $2
+wait_for_text () {
+    waited=0
+    until call GetScrollback "$1" 5 | grep -q -- "$2"; do
+        if [ $waited -ge 6000 ]; then
+            echo "tab $1 did not print $2" >&2
+            exit 1
+        fi
+
+        sleep 0.01
+        waited=$((waited + 1))
+    done
+}
+
+wait_for_file () {
+    waited=0
+    until [ -s "$1" ]; do
+        if [ $waited -ge 600 ]; then
+            echo "$1 was not written" >&2
+            exit 1
+        fi
+
+        sleep 0.1
+        waited=$((waited + 1))
+    done
+}
+
+wait_for_path () {
+    waited=0
+    until [ -e "$1" ]; do
+        if [ $waited -ge 600 ]; then
+            echo "$1 was not created" >&2
+            exit 1
+        fi
+
+        sleep 0.1
+        waited=$((waited + 1))
+    done
+}
+
+# Prints the value of a metric of type t
+metric () {
+    call GetMetrics | sed -n "s/.*'$1': <uint64 \([0-9]*\)>.*/\1/p"
+}
+
+# Prints the count and the sum of a histogram metric
+histogram () {
+    call GetMetrics | sed -n "s/.*'$1': <(uint64 \([0-9]*\), uint64 \([0-9]*\),.*/\1 \2/p"
+}
+
+# Prints the buckets of a histogram metric, one per line
+buckets () {
+    call GetMetrics \
+        | sed -n "s/.*'$1': <(uint64 [0-9]*, uint64 [0-9]*, \[\([^]]*\)\]).*/\1/p" \
+        | sed 's/uint64 //g' | tr ',' '\n' | tr -d ' '
+}
+
+# Prints the upper bound in microseconds of the bucket that contains the
+# quantile $2 of the histogram $1, like "tilda --stats" does
+quantile () {
+    buckets "$1" | awk -v q="$2" '
+        { count[NR - 1] = $1; total += $1 }
+        END {
+            rank = int (q * total)
+            for (i = 0; i < NR; i++) {
+                seen += count[i]
+                if (seen > rank) {
+                    printf "%d", 2 ^ i
+                    exit
+                }
+            }
+        }'
+}
+
+stop_xclip () {
+    if [ -n "$clip_pid" ]; then
+        kill "$clip_pid" 2> /dev/null || true
+        wait "$clip_pid" 2> /dev/null || true
+        clip_pid=
+    fi
+}
+
+# Prints the CPU time of tilda in milliseconds
+cpu_ms () {
+    awk -v hz="$(getconf CLK_TCK)" '{ printf "%d", ($14 + $15) * 1000 / hz }' "/proc/$pid/stat"
+}
+
+# Starts tilda with the config lines in $1 and waits for its startup
+start_tilda () {
+    cat > "$dir/config" <<CONFIG
+restore_session = false
+lines = 200000
+$1
+CONFIG
+
+    rm -rf "$dir/cache"
+    XDG_CACHE_HOME="$dir/cache" "$TILDA" --dbus --profile-startup -g "$dir/config" \
+        > "$dir/out" 2> /dev/null &
+    pid=$!
+
+    waited=0
+    until grep -q '^total ' "$dir/out" && call ListTabs > /dev/null 2>&1; do
+        if ! kill -0 "$pid" 2> /dev/null || [ $waited -ge 300 ]; then
+            echo "tilda did not start" >&2
+            exit 1
+        fi
+
+        sleep 0.1
+        waited=$((waited + 1))
+    done
+}
+
+stop_tilda () {
+    if [ -n "$pid" ]; then
+        kill "$pid" 2> /dev/null || true
+        wait "$pid" 2> /dev/null || true
+        pid=
+    fi
+}
+
+# Prints the time that cat takes to write the test file into a new tab
+measure_cat () {
+    rm -f "$dir/cat-time"
+
+    cat > "$dir/cat.sh" <<SCRIPT
+start=\$(date +%s%N)
+cat "$dir/lines"
+end=\$(date +%s%N)
+echo \$(( (end - start) / 1000000 )) > "$dir/cat-time"
+exec cat
+SCRIPT
+
+    tab=$(new_tab "$dir/cat.sh")
+    wait_for_file "$dir/cat-time"
+    call CloseTab "$tab" > /dev/null
+
+    cat "$dir/cat-time"
+}
+
+awk -v lines="$CAT_LINES" 'BEGIN {
+    for (i = 0; i < lines; i++)
+        printf "%08d The quick brown fox jumps over the lazy dog. 0123456789 abcdefghijklmnopqrstuvwxyz\n", i
+}' > "$dir/lines"
+
+start_tilda ""
+
+result startup_ms "$(awk '$1 == "total" { printf "%d", $2 }' "$dir/out")"
+result first_prompt_ms "$(awk '$1 == "first-prompt" { printf "%d", $3 }' "$dir/out")"
+
+# Pull latency, as measured by tilda itself
+i=0
+while [ $i -lt "$TOGGLES" ]; do
+    call Toggle > /dev/null
+    i=$((i + 1))
+done
+
+set -- $(histogram pull-time)
+result pull_us $(( $2 / $1 ))
+
+# Make sure that the window is shown for the remaining benchmarks
+if [ $((TOGGLES % 2)) -eq 1 ]; then
+    call Toggle > /dev/null
+fi
+
+# New tab to prompt
+echo 'PS1="bench-prompt> " exec sh -i' > "$dir/prompt.sh"
+
+set -- $(histogram prompt-time)
+prompts_before=$1
+prompt_time_before=$2
+
+# Polling only waits for the prompt, the time is recorded by tilda
+i=0
+while [ $i -lt "$NEW_TABS" ]; do
+    tab=$(new_tab "$dir/prompt.sh")
+    wait_for_text "$tab" "bench-prompt>"
+    call CloseTab "$tab" > /dev/null
+    i=$((i + 1))
+done
+
+set -- $(histogram prompt-time)
+result new_tab_prompt_us $(( ($2 - prompt_time_before) / ($1 - prompts_before) ))
+
+result cat_ms "$(measure_cat)"
+
+# Large paste, the clipboard is owned by xclip while it runs
+if command -v xclip > /dev/null; then
+    awk -v lines=$((PASTE_MB * 1024 * 1024 / 100)) 'BEGIN {
+        for (i = 0; i < lines; i++)
+            printf "%08d The quick brown fox jumps over the lazy dog. 0123456789 abcdefghijklmnopqrst\n", i
+    }' > "$dir/paste"
+    paste_bytes=$(wc -c < "$dir/paste")
+
+    xclip -quiet -selection clipboard -i "$dir/paste" > /dev/null 2>&1 &
+    clip_pid=$!
+
+    rm -f "$dir/pasted"
+    cat > "$dir/paste.sh" <<SCRIPT
+stty -echo
+: > "$dir/pasted"
+exec cat > "$dir/pasted"
+SCRIPT
+
+    tab=$(new_tab "$dir/paste.sh")
+    wait_for_path "$dir/pasted"
+
+    set -- $(histogram paste-frame-time)
+    frames_before=$1
+    frame_time_before=$2
+
+    start=$(now_us)
+    call PasteClipboard "$tab" > /dev/null
+
+    waited=0
+    until [ "$(wc -c < "$dir/pasted")" -ge "$paste_bytes" ]; do
+        if [ $waited -ge 12000 ]; then
+            echo "the paste did not arrive" >&2
+            exit 1
+        fi
+
+        sleep 0.01
+        waited=$((waited + 1))
+    done
+
+    result paste_ms $(( ($(now_us) - start) / 1000 ))
+
+    # The window must be shown, otherwise no frames are drawn
+    set -- $(histogram paste-frame-time)
+    frames=$(( $1 - frames_before ))
+
+    if [ "$frames" -eq 0 ]; then
+        echo "no frames were drawn during the paste" >&2
+        exit 1
+    fi
+
+    result paste_frame_avg_us $(( ($2 - frame_time_before) / frames ))
+    result paste_frame_p95_us "$(quantile paste-frame-time 0.95)"
+
+    call CloseTab "$tab" > /dev/null
+    stop_xclip
+    rm -f "$dir/paste" "$dir/pasted"
+else
+    echo "xclip is not installed, skipping the paste benchmark" >&2
+fi
+
+# Title spam
+rm -f "$dir/title-done"
+
+cat > "$dir/title.sh" <<SCRIPT
+i=0
+while [ \$i -lt $TITLE_CHANGES ]; do
+    printf '\\033]0;title %d\\007' \$i
+    i=\$((i + 1))
+done
+echo done > "$dir/title-done"
+exec cat
+SCRIPT
+
+before=$(cpu_ms)
+tab=$(new_tab "$dir/title.sh")
+wait_for_file "$dir/title-done"
+sleep 1
+result title_spam_cpu_ms $(( $(cpu_ms) - before ))
+call CloseTab "$tab" > /dev/null
+
+# Search in a long scrollback
+cat > "$dir/history.sh" <<SCRIPT
+seq 1 100000
+echo history-done
+exec cat
+SCRIPT
+
+tab=$(new_tab "$dir/history.sh")
+wait_for_text "$tab" "history-done"
+
+set -- $(histogram search-time)
+searches_before=$1
+search_time_before=$2
+
+i=0
+while [ $i -lt "$SEARCHES" ]; do
+    call Search "$tab" "'no such text'" false > /dev/null
+    i=$((i + 1))
+done
+
+set -- $(histogram search-time)
+result search_100k_us $(( ($2 - search_time_before) / ($1 - searches_before) ))
+call CloseTab "$tab" > /dev/null
+
+# Tab switching and memory per tab
+sleep 1
+rss_before=$(metric rss-bytes)
+
+echo 'exec cat' > "$dir/idle.sh"
+operations=
+i=1
+while [ $i -lt "$TABS" ]; do
+    operations="$operations${operations:+, }('NewTab', <('', 'sh $dir/idle.sh')>)"
+    i=$((i + 1))
+done
+
+call Batch "[$operations]" > /dev/null
+sleep 2
+
+rss_after=$(metric rss-bytes)
+result rss_per_tab_kb $(( (rss_after - rss_before) / (TABS - 1) / 1024 ))
+
+# Each switch is timed by tilda until the window was painted, the pause
+# lets the paint of one switch finish before the next one starts
+# Only the first tab id in the array is printed with its type
+for tab in $(call ListTabs | sed 's/(uint32 /(/g' | grep -o "([0-9]*, '" | tr -dc '0-9\n'); do
+    call FocusTab "$tab" > /dev/null
+    sleep 0.05
+done
+
+result switch_tab_median_us "$(quantile tab-switch-time 0.5)"
+result switch_tab_p95_us "$(quantile tab-switch-time 0.95)"
+
+stop_tilda
+
+# Output throughput with scroll_on_output
+start_tilda "scroll_on_output = true"
+result cat_scroll_on_output_ms "$(measure_cat)"
+stop_tilda
+
+awk -v version="$("$TILDA" --version | head -n 1)" '
+    BEGIN { printf "{\n  \"tilda\": \"%s\"", version }
+    { printf ",\n  \"%s\": %s", $1, $2 }
+    END { printf "\n}\n" }' "$dir/results" > "$RESULTS"
+
+echo "results written to $RESULTS"
@@ -0,0 +1,84 @@
+#!/bin/sh
+#
+# Starts tilda several times with --profile-startup and fails if a start
+# took longer than the budget. Every start uses a new cache directory and
+# config file, but the page cache is not dropped, so only the first start
+# can be a cold start of the binary and its libraries.
+#
+# Usage: bench/startup-time.sh [TILDA] [BUDGET] [RUNS]
+#
+#   TILDA   the tilda binary to run, defaults to "tilda"
+#   BUDGET  the allowed startup time in milliseconds, defaults to
+#           $TILDA_STARTUP_BUDGET or 1000
+#   RUNS    the number of starts, defaults to 5
+#
+# tilda needs a display, use xvfb-run to run this script without one. The
+# phases of the slowest start are printed. "make check" runs this script
+# with the built tilda and the budget from the environment.
+
+set -eu
+
+TILDA=${1:-tilda}
+BUDGET=${2:-${TILDA_STARTUP_BUDGET:-1000}}
+RUNS=${3:-5}
+
+dir=$(mktemp -d)
+pid=
+
+trap 'if [ -n "$pid" ]; then kill $pid 2> /dev/null; wait $pid 2> /dev/null; fi; rm -rf "$dir"' EXIT
+
+# Starts tilda and prints its startup profile
+profile () {
+    rm -rf "$dir/cache"
+
+    cat > "$dir/config" <<CONFIG
+restore_session = false
+CONFIG
+
+    XDG_CACHE_HOME="$dir/cache" "$TILDA" --profile-startup -g "$dir/config" > "$dir/out" 2> /dev/null &
+    pid=$!
+
+    waited=0
+    while ! grep -q '^total ' "$dir/out"; do
+        if ! kill -0 "$pid" 2> /dev/null || [ $waited -ge 300 ]; then
+            echo "tilda did not report its startup profile" >&2
+            exit 1
+        fi
+
+        sleep 0.1
+        waited=$((waited + 1))
+    done
+
+    kill $pid
+    wait $pid 2> /dev/null || true
+    pid=
+
+    cat "$dir/out"
+}
+
+slowest=0
+i=0
+while [ $i -lt "$RUNS" ]; do
+    profile > "$dir/profile"
+
+    total=$(awk '$1 == "total" { printf "%d", $2 }' "$dir/profile")
+    echo "start $i: $total ms"
+
+    if [ "$total" -ge "$slowest" ]; then
+        slowest=$total
+        cp "$dir/profile" "$dir/slowest"
+    fi
+
+    i=$((i + 1))
+done
+
+echo
+cat "$dir/slowest"
+echo
+
+if [ "$slowest" -gt "$BUDGET" ]; then
+    echo "slowest start took $slowest ms, the budget is $BUDGET ms" >&2
+    exit 1
+fi
+
+echo "slowest start took $slowest ms, the budget is $BUDGET ms"
@@ -0,0 +1,84 @@
+#!/bin/sh
+#
+# Changes the title of a tab as fast as possible and records the
+# TabTitleChanged D-Bus signals of tilda. Fails if two signals of the tab
+# were emitted less than dbus_title_interval milliseconds apart.
+#
+# Usage: bench/title-rate.sh [TILDA] [DURATION] [INTERVAL]
+#
+#   TILDA     the tilda binary to run, defaults to "tilda"
+#   DURATION  how long the title is changed, defaults to 10
+#   INTERVAL  the value of dbus_title_interval, defaults to 250
+#
+# No other tilda may be running, the started instance must be instance 0.
+# tilda needs a display and a session bus, use xvfb-run and dbus-run-session
+# to run this script without them. dbus-monitor must be installed.
+
+set -eu
+
+TILDA=${1:-tilda}
+DURATION=${2:-10}
+INTERVAL=${3:-250}
+
+dir=$(mktemp -d)
+
+cat > "$dir/spam.sh" <<SPAM
+end=\$(( \$(date +%s) + $DURATION ))
+i=0
+while [ \$(date +%s) -lt \$end ]; do
+    printf '\\033]0;title %d\\007' \$i
+    i=\$((i + 1))
+done
+echo \$i > "$dir/changes"
+sleep 60
+SPAM
+
+cat > "$dir/config" <<CONFIG
+run_command = true
+command = "sh $dir/spam.sh"
+restore_session = false
+dbus_title_interval = $INTERVAL
+CONFIG
+
+dbus-monitor --session --profile \
+    "type='signal',interface='com.github.lanoxx.tilda.Actions',member='TabTitleChanged'" \
+    > "$dir/signals" 2> /dev/null &
+monitor=$!
+
+XDG_CACHE_HOME="$dir/cache" "$TILDA" --dbus -g "$dir/config" > /dev/null 2>&1 &
+pid=$!
+
+trap 'kill $pid $monitor 2> /dev/null; wait $pid $monitor 2> /dev/null; rm -rf "$dir"' EXIT
+
+while [ ! -s "$dir/changes" ]; do
+    if ! kill -0 "$pid" 2> /dev/null; then
+        echo "tilda exited before the title changes were done" >&2
+        exit 1
+    fi
+
+    sleep 1
+done
+
+sleep 1
+
+# dbus-monitor --profile prints one line per message, the second field is
+# the time stamp in seconds
+awk -v interval="$INTERVAL" -v changes="$(cat "$dir/changes")" '
+    $1 == "sig" && $NF == "TabTitleChanged" {
+        if (count > 0) {
+            gap = ($2 - last) * 1000
+            if (min == "" || gap < min) min = gap
+        }
+        last = $2
+        count++
+    }
+    END {
+        printf "title changes: %d\n", changes
+        printf "signals:       %d\n", count
+        printf "minimum gap:   %.1f ms (interval %d ms)\n", min, interval
+        # Allow for the jitter of the time stamps taken by dbus-monitor
+        if (count > 1 && min < interval * 0.9) {
+            print "FAIL: signals were emitted faster than the interval"
+            exit 1
+        }
+    }' "$dir/signals"
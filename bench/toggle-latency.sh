@@ -0,0 +1,73 @@
+#!/bin/sh
+#
+# Measures how long it takes to toggle a running instance with tilda-toggle,
+# with "tilda -T" through the control socket and with "tilda -T" through
+# D-Bus. The D-Bus path is measured by moving the control socket aside,
+# which makes "tilda -T" fall back to D-Bus.
+#
+# Usage: bench/toggle-latency.sh [TILDA] [COUNT]
+#
+#   TILDA  the tilda binary to run, defaults to "tilda". tilda-toggle is
+#          taken from the same directory.
+#   COUNT  the number of toggles per path, defaults to 200
+#
+# No other tilda may be running, the started instance must be instance 0.
+# tilda needs a display and a session bus, use xvfb-run and dbus-run-session
+# to run this script without them.
+
+set -eu
+
+TILDA=${1:-tilda}
+COUNT=${2:-200}
+
+case "$TILDA" in
+    */*) TILDA_TOGGLE="$(dirname "$TILDA")/tilda-toggle" ;;
+    *) TILDA_TOGGLE=tilda-toggle ;;
+esac
+
+dir=$(mktemp -d)
+socket="${XDG_RUNTIME_DIR:?XDG_RUNTIME_DIR must be set}/tilda/control-0"
+
+cat > "$dir/config" <<CONFIG
+restore_session = false
+CONFIG
+
+XDG_CACHE_HOME="$dir/cache" "$TILDA" --dbus -g "$dir/config" > /dev/null 2>&1 &
+pid=$!
+
+trap 'kill $pid 2> /dev/null; wait $pid 2> /dev/null; rm -rf "$dir"' EXIT
+
+while [ ! -S "$socket" ]; do
+    if ! kill -0 "$pid" 2> /dev/null; then
+        echo "tilda exited before its control socket was created" >&2
+        exit 1
+    fi
+
+    sleep 1
+done
+
+# Prints the average time of the toggle command "$@" in microseconds
+measure () {
+    start=$(date +%s%N)
+
+    i=0
+    while [ $i -lt "$COUNT" ]; do
+        "$@"
+        i=$((i + 1))
+    done
+
+    end=$(date +%s%N)
+    echo $(( (end - start) / 1000 / COUNT ))
+}
+
+via_toggle=$(measure "$TILDA_TOGGLE" 0)
+via_socket=$(measure "$TILDA" -T 0)
+
+mv "$socket" "$socket.moved"
+via_dbus=$(measure "$TILDA" -T 0)
+mv "$socket.moved" "$socket"
+
+echo "toggles:              $COUNT"
+echo "tilda-toggle:         $via_toggle us"
+echo "tilda -T over socket: $via_socket us"
+echo "tilda -T over D-Bus:  $via_dbus us"
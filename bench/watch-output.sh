@@ -0,0 +1,106 @@
+#!/bin/sh
+#
+# Streams a large amount of output through a tab of tilda, once without and
+# once with an output watcher, and prints how long the terminal needed to
+# consume the output in each case. The watcher must not slow the terminal
+# down noticeably.
+#
+# The watcher sends a desktop notification for the line at the end of the
+# output. The Notify call is observed with dbus-monitor, the script fails
+# if it is not sent and prints the delay from printing the line until the
+# call reached the session bus.
+#
+# Usage: bench/watch-output.sh [TILDA] [BYTES]
+#
+#   TILDA  the tilda binary to run, defaults to "tilda"
+#   BYTES  the amount of output, defaults to 1GiB
+#
+# The script runs under xvfb-run and dbus-run-session if there is no display
+# or session bus.
+
+set -eu
+
+TILDA=${1:-tilda}
+BYTES=${2:-1073741824}
+
+if [ -z "${DISPLAY:-}" ]; then
+    exec xvfb-run -a "$0" "$TILDA" "$BYTES"
+fi
+
+if [ -z "${DBUS_SESSION_BUS_ADDRESS:-}" ]; then
+    exec dbus-run-session -- "$0" "$TILDA" "$BYTES"
+fi
+
+work=$(mktemp -d)
+monitor_pid=
+
+trap 'if [ -n "$monitor_pid" ]; then kill "$monitor_pid" 2> /dev/null; fi; rm -rf "$work"' EXIT
+
+# Prints the time in milliseconds that the terminal needed for the output.
+# The time in microseconds when the last line was printed is written to
+# $work/output_time.
+run () {
+    watchers=$1
+    dir=$(mktemp -d)
+
+    cat > "$dir/stream.sh" <<STREAM
+start=\$(date +%s%N)
+yes '[ 42%] Building C object src/tilda.c.o' | head -c $BYTES
+echo \$(( \$(date +%s%N) / 1000 )) > "$work/output_time"
+echo 'BUILD FAILED'
+end=\$(date +%s%N)
+echo \$(( (end - start) / 1000000 )) > "$dir/result"
+sleep 60
+STREAM
+
+    cat > "$dir/config" <<CONFIG
+run_command = true
+command = "sh $dir/stream.sh"
+restore_session = false
+output_watchers = {$watchers}
+CONFIG
+
+    XDG_CACHE_HOME="$dir/cache" "$TILDA" -g "$dir/config" > /dev/null 2>&1 &
+    pid=$!
+
+    while [ ! -s "$dir/result" ]; do
+        if ! kill -0 "$pid" 2> /dev/null; then
+            echo "tilda exited before the output was consumed" >&2
+            exit 1
+        fi
+
+        sleep 1
+    done
+
+    # The watcher scans the output every 100 ms
+    sleep 1
+
+    kill "$pid"
+    wait "$pid" 2> /dev/null || true
+
+    cat "$dir/result"
+    rm -rf "$dir"
+}
+
+unwatched=$(run '')
+
+dbus-monitor --session --profile \
+    "type='method_call',interface='org.freedesktop.Notifications',member='Notify'" \
+    > "$work/monitor" 2> /dev/null &
+monitor_pid=$!
+sleep 1
+
+watched=$(run '"flash,notify:BUILD FAILED|Traceback"')
+
+# The timestamp of the call is seconds and microseconds
+notified=$(awk -F '\t' '$1 == "mc" && $NF == "Notify" { sub (/\./, "", $2); print $2; exit }' "$work/monitor")
+
+if [ -z "$notified" ]; then
+    echo "the output watcher did not send a notification" >&2
+    exit 1
+fi
+
+echo "bytes:     $BYTES"
+echo "unwatched: $unwatched ms"
+echo "watched:   $watched ms"
+echo "notified:  $(( (notified - $(cat "$work/output_time")) / 1000 )) ms after the output"
@@ -27,6 +27,7 @@
 #include <unistd.h> /* fsync */
 
 #include "configsys.h"
+#include "tilda-metrics.h"
 #include <vte/vte.h>
 
 static cfg_t *tc;
@@ -170,6 +171,9 @@ static cfg_opt_t config_opts[] = {
     CFG_BOOL("start_fullscreen", FALSE, CFGF_NONE),
     /* Whether closing a tab shows a confirmation dialog. */
     CFG_BOOL("confirm_close_tab", TRUE, CFGF_NONE),
+    /* Whether closing a tab or quitting asks for confirmation if a
+     * process other than the shell is still running. */
+    CFG_BOOL("confirm_close_running", FALSE, CFGF_NONE),
 
     CFG_INT("back_alpha", 0xffff, CFGF_NONE),
 
@@ -193,6 +197,43 @@ static cfg_opt_t config_opts[] = {
      * URIs with the 'web_browser' option. */
     CFG_BOOL("use_custom_web_browser", FALSE, CFGF_NONE),
 
+    /* Whether to save the open tabs on exit and restore them on start up */
+    CFG_BOOL("restore_session", FALSE, CFGF_NONE),
+    /* Whether the saved session includes the scrollback of each tab */
+    CFG_BOOL("session_save_scrollback", FALSE, CFGF_NONE),
+
+    /* Whether to measure the resource usage of the processes in each tab */
+    CFG_BOOL("resource_monitor", FALSE, CFGF_NONE),
+    /* The interval in milliseconds in which the resource usage is measured */
+    CFG_INT("resource_monitor_interval", 2000, CFGF_NONE),
+
+    /* How the processes of hidden tabs are throttled: 0 = not at all,
+     * 1 = renice them to background_tab_nice, 2 = SCHED_IDLE. Needs an
+     * RLIMIT_NICE of at least 20 to restore the priority, see the man page. */
+    CFG_INT("background_tab_policy", 0, CFGF_NONE),
+    CFG_INT("background_tab_nice", 19, CFGF_NONE),
+
+    /* When the command is restarted on exit, give up after this many
+     * failures within restart_failure_window seconds, 0 never gives up */
+    CFG_INT("restart_max_failures", 5, CFGF_NONE),
+    CFG_INT("restart_failure_window", 60, CFGF_NONE),
+
+    /* Whether shells are spawned through a tee, so that tabs can be recorded */
+    CFG_BOOL("enable_recording", FALSE, CFGF_NONE),
+
+    /* Output watchers of the form "actions:pattern", see tilda-watch.c */
+    CFG_STR_LIST("output_watchers", "{}", CFGF_NONE),
+
+    /* Whether new tabs are marked when they produce output in the
+     * background, and after how many seconds of silence they are marked,
+     * 0 disables silence monitoring. See tilda-activity.c */
+    CFG_BOOL("monitor_activity", FALSE, CFGF_NONE),
+    CFG_INT("monitor_silence", 0, CFGF_NONE),
+
+    /* Each tab emits the TabTitleChanged D-Bus signal at most once in this
+     * many milliseconds */
+    CFG_INT("dbus_title_interval", 250, CFGF_NONE),
+
     /**
      * Deprecated tilda options. These options be commented out in the
      * configuration file and will not be initialized with default values
@@ -315,6 +356,28 @@ glong config_getnint(const gchar *key, const guint idx)
     return temp;
 }
 
+gchar* config_getnstr (const gchar *key, const guint idx)
+{
+    gchar *temp;
+
+    config_mutex_lock ();
+    temp = cfg_getnstr (tc, key, idx);
+    config_mutex_unlock ();
+
+    return temp;
+}
+
+guint config_getsize (const gchar *key)
+{
+    guint temp;
+
+    config_mutex_lock ();
+    temp = cfg_size (tc, key);
+    config_mutex_unlock ();
+
+    return temp;
+}
+
 gchar* config_getstr (const gchar *key)
 {
     gchar *temp;
@@ -345,6 +408,7 @@ gint config_write (const gchar *config_file)
     DEBUG_FUNCTION ("config_write");
     DEBUG_ASSERT (config_file != NULL);
 
+    gint64 start_time = g_get_monotonic_time ();
     gint ret = 0;
     FILE *fp;
 
@@ -390,6 +454,8 @@ gint config_write (const gchar *config_file)
         ret = 4;
     }
 
+    tilda_metrics_observe (TILDA_METRIC_CONFIG_WRITE_TIME, g_get_monotonic_time () - start_time);
+
     return ret;
 }
 
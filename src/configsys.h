@@ -65,6 +65,8 @@ glong    config_getint     (const gchar *key);
 gchar*   config_getstr     (const gchar *key);
 gboolean config_getbool    (const gchar *key);
 glong    config_getnint    (const gchar *key, const guint idx);
+gchar*   config_getnstr    (const gchar *key, const guint idx);
+guint    config_getsize    (const gchar *key);
 
 /**
  * This function uses the configured relative ratio of the window size and
@@ -19,6 +19,8 @@
 #define DEBUG_H
 
 #include "config.h"
+#include "tilda-trace.h"
+
 #include <libgen.h>
 
 #include <glib.h>
@@ -56,17 +58,21 @@
 
 /* Function tracing
  *
- * Add -DDEBUG_FUNCTIONS to your compile options to turn on function tracing.
+ * DEBUG_FUNCTION records a span from the tracepoint until the end of the enclosing
+ * block and DEBUG_FUNCTION_MESSAGE records an instant event, see tilda-trace.h. Both
+ * cost next to nothing unless tracing is switched on at runtime. The name must be a
+ * string literal or __FUNCTION__.
  *
- * If you do not have the DEBUG_FUNCTIONS symbol defined, then function tracing will
- * be turned off and compiled into a noop.
+ * Add -DDEBUG_FUNCTIONS to your compile options to also log each call with g_debug.
  */
 
 #if DEBUG_FUNCTIONS
 
-    #define DEBUG_FUNCTION(NAME) g_debug("%s: FUNCTION ENTERED: %s", basename(__FILE__), (NAME))
+    #define DEBUG_FUNCTION(NAME) TILDA_TRACE_SCOPE (NAME); \
+        g_debug("%s: FUNCTION ENTERED: %s", basename(__FILE__), (NAME))
 
     #define DEBUG_FUNCTION_MESSAGE(NAME,FORMAT,args...) { \
+        TILDA_TRACE_INSTANT (NAME); \
         gchar *message = g_strdup_printf ((FORMAT), ##args); \
         g_debug("%s: FUNCTION ENTERED: %s: %s", basename(__FILE__), (NAME), message); \
         g_free (message); \
@@ -74,9 +80,9 @@
 
 #else
 
-    #define DEBUG_FUNCTION(NAME) {}
+    #define DEBUG_FUNCTION(NAME) TILDA_TRACE_SCOPE (NAME)
 
-    #define DEBUG_FUNCTION_MESSAGE(NAME,FORMAT,args...) {}
+    #define DEBUG_FUNCTION_MESSAGE(NAME,FORMAT,args...) { TILDA_TRACE_INSTANT (NAME); }
 
 #endif
 
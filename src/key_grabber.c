@@ -21,6 +21,9 @@
 #include "debug.h"
 #include "key_grabber.h"
 #include "screen-size.h"
+#include "tilda-cpu-policy.h"
+#include "tilda-dbus-actions.h"
+#include "tilda-metrics.h"
 #include "tilda.h"
 #include <glib.h>
 #include <glib/gi18n.h>
@@ -244,10 +247,14 @@ void pull (struct tilda_window_ *tw, enum pull_action action, gboolean force_hid
         return;
     }
 
+    gint64 start_time = g_get_monotonic_time ();
+
     if ((tw->current_state == STATE_UP) && action != PULL_UP) {
         pull_down (tw);
+        tilda_metrics_observe (TILDA_METRIC_PULL_TIME, g_get_monotonic_time () - start_time);
     } else if ((tw->current_state == STATE_DOWN) && action != PULL_DOWN) {
         pull_up (tw);
+        tilda_metrics_observe (TILDA_METRIC_PULL_TIME, g_get_monotonic_time () - start_time);
     }
 
     tw->last_action = action;
@@ -318,6 +325,9 @@ static void pull_up (struct tilda_window_ *tw) {
 
     g_debug ("pull_up(): MOVED UP");
     tw->current_state = STATE_UP;
+
+    tilda_cpu_policy_update (tw, -1);
+    tilda_dbus_actions_notify_visibility_changed (tw, FALSE);
 }
 
 static void pull_down (struct tilda_window_ *tw) {
@@ -408,6 +418,9 @@ static void pull_down (struct tilda_window_ *tw) {
 
     g_debug ("pull_down(): MOVED DOWN");
     tw->current_state = STATE_DOWN;
+
+    tilda_cpu_policy_update (tw, gtk_notebook_get_current_page (GTK_NOTEBOOK (tw->notebook)));
+    tilda_dbus_actions_notify_visibility_changed (tw, TRUE);
 }
 
 static void onKeybindingPull (G_GNUC_UNUSED const char *keystring, gpointer user_data)
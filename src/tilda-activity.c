@@ -0,0 +1,218 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilda-activity.h"
+
+#include "debug.h"
+#include "tilda-dbus-actions.h"
+
+#include <gtk/gtk.h>
+
+/* The interval in which the tabs are evaluated, in seconds */
+#define TILDA_ACTIVITY_INTERVAL 1
+
+#define TILDA_ACTIVITY_STYLE_CLASS "activity"
+#define TILDA_SILENCE_STYLE_CLASS "silence"
+
+const gchar *
+tilda_activity_state_to_string (enum tilda_activity_state state)
+{
+    switch (state)
+    {
+        case TILDA_ACTIVITY_OUTPUT:
+            return "activity";
+        case TILDA_ACTIVITY_SILENCE:
+            return "silence";
+        case TILDA_ACTIVITY_NONE:
+        default:
+            return "none";
+    }
+}
+
+static const gchar *
+get_style_class (enum tilda_activity_state state)
+{
+    switch (state)
+    {
+        case TILDA_ACTIVITY_OUTPUT:
+            return TILDA_ACTIVITY_STYLE_CLASS;
+        case TILDA_ACTIVITY_SILENCE:
+            return TILDA_SILENCE_STYLE_CLASS;
+        case TILDA_ACTIVITY_NONE:
+        default:
+            return NULL;
+    }
+}
+
+static gboolean
+is_shown (tilda_term *tt)
+{
+    tilda_window *tw = tt->tw;
+    gint page;
+
+    if (tw->current_state != STATE_DOWN) {
+        return FALSE;
+    }
+
+    page = gtk_notebook_get_current_page (GTK_NOTEBOOK (tw->notebook));
+
+    return g_list_nth_data (tw->terms, (guint) page) == tt;
+}
+
+static void
+set_state (tilda_term *tt, enum tilda_activity_state state)
+{
+    GtkWidget *label;
+    const gchar *style_class;
+
+    if (tt->activity_state == state) {
+        return;
+    }
+
+    label = gtk_notebook_get_tab_label (GTK_NOTEBOOK (tt->tw->notebook), tt->hbox);
+
+    if (label != NULL)
+    {
+        GtkStyleContext *context = gtk_widget_get_style_context (label);
+
+        style_class = get_style_class (tt->activity_state);
+
+        if (style_class != NULL) {
+            gtk_style_context_remove_class (context, style_class);
+        }
+
+        style_class = get_style_class (state);
+
+        if (style_class != NULL) {
+            gtk_style_context_add_class (context, style_class);
+        }
+    }
+
+    tt->activity_state = state;
+
+    tilda_dbus_actions_notify_tab_state (tt->tw, tt->id,
+                                         tilda_activity_state_to_string (state));
+}
+
+static gboolean
+is_monitored (tilda_term *tt)
+{
+    return tt->monitor_activity || tt->monitor_silence > 0;
+}
+
+static void
+evaluate (tilda_term *tt, gint64 now)
+{
+    gboolean shown = is_shown (tt);
+
+    if (shown) {
+        set_state (tt, TILDA_ACTIVITY_NONE);
+    }
+
+    if (tt->output_seen)
+    {
+        tt->output_seen = FALSE;
+        tt->last_output_time = now;
+        tt->silence_armed = tt->monitor_silence > 0;
+
+        /* A tab that was marked as silent becomes active again */
+        if (tt->monitor_activity && !shown && tt->activity_state != TILDA_ACTIVITY_OUTPUT) {
+            set_state (tt, TILDA_ACTIVITY_OUTPUT);
+        }
+    }
+    else if (tt->silence_armed
+             && now - tt->last_output_time >= (gint64) tt->monitor_silence * G_USEC_PER_SEC)
+    {
+        tt->silence_armed = FALSE;
+
+        if (!shown) {
+            set_state (tt, TILDA_ACTIVITY_SILENCE);
+        }
+    }
+}
+
+static gboolean
+activity_timer_cb (gpointer user_data)
+{
+    tilda_window *tw = user_data;
+    gboolean monitored = FALSE;
+    gint64 now = g_get_monotonic_time ();
+
+    for (GList *item = tw->terms; item != NULL; item = item->next)
+    {
+        tilda_term *tt = item->data;
+
+        if (is_monitored (tt)) {
+            evaluate (tt, now);
+            monitored = TRUE;
+        }
+    }
+
+    if (monitored) {
+        return G_SOURCE_CONTINUE;
+    }
+
+    tw->activity_source = 0;
+
+    return G_SOURCE_REMOVE;
+}
+
+void
+tilda_activity_set_monitoring (tilda_term *tt, gboolean activity, guint silence)
+{
+    DEBUG_FUNCTION ("tilda_activity_set_monitoring");
+    DEBUG_ASSERT (tt != NULL);
+
+    tilda_window *tw = tt->tw;
+
+    tt->monitor_activity = activity;
+    tt->monitor_silence = silence;
+
+    /* Output before monitoring was enabled is not reported */
+    tt->output_seen = FALSE;
+    tt->silence_armed = FALSE;
+
+    if (!activity && tt->activity_state == TILDA_ACTIVITY_OUTPUT) {
+        set_state (tt, TILDA_ACTIVITY_NONE);
+    }
+
+    if (silence == 0 && tt->activity_state == TILDA_ACTIVITY_SILENCE) {
+        set_state (tt, TILDA_ACTIVITY_NONE);
+    }
+
+    /* The timer stops by itself once no tab is monitored anymore */
+    if (is_monitored (tt) && tw->activity_source == 0) {
+        tw->activity_source = g_timeout_add_seconds (TILDA_ACTIVITY_INTERVAL,
+                                                     activity_timer_cb, tw);
+    }
+}
+
+void
+tilda_activity_tab_shown (tilda_term *tt)
+{
+    set_state (tt, TILDA_ACTIVITY_NONE);
+}
+
+void
+tilda_activity_stop (tilda_window *tw)
+{
+    DEBUG_FUNCTION ("tilda_activity_stop");
+    DEBUG_ASSERT (tw != NULL);
+
+    if (tw->activity_source) {
+        g_source_remove (tw->activity_source);
+        tw->activity_source = 0;
+    }
+}
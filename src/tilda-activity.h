@@ -0,0 +1,68 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILDA_ACTIVITY_H
+#define TILDA_ACTIVITY_H
+
+#include "tilda_window.h"
+#include "tilda_terminal.h"
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Activity and silence monitoring of background tabs.
+ *
+ * A tab with activity monitoring is marked when it produces output while
+ * it is not shown. A tab with silence monitoring is marked when it has
+ * been quiet for a number of seconds after it produced output, e.g. when
+ * a long compile finished. The marks are shown with the style classes
+ * "activity" and "silence" on the tab label, and are cleared when the tab
+ * is shown.
+ *
+ * The contents-changed handler of a terminal only sets tt->output_seen,
+ * all tabs are evaluated by a single timer that only runs while at least
+ * one tab has monitoring enabled.
+ */
+
+/**
+ * Enables or disables the monitoring of a tab. silence is the number of
+ * seconds without output after which the tab is marked, 0 disables
+ * silence monitoring.
+ */
+void tilda_activity_set_monitoring (tilda_term *tt,
+                                    gboolean activity,
+                                    guint silence);
+
+/**
+ * Clears the mark of a tab, must be called when the tab is shown.
+ */
+void tilda_activity_tab_shown (tilda_term *tt);
+
+/**
+ * Returns the name of a state as used in D-Bus signals: "none",
+ * "activity" or "silence".
+ */
+const gchar *tilda_activity_state_to_string (enum tilda_activity_state state);
+
+/**
+ * Stops the timer of the window.
+ */
+void tilda_activity_stop (tilda_window *tw);
+
+G_END_DECLS
+
+#endif /* TILDA_ACTIVITY_H */
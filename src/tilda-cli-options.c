@@ -21,6 +21,11 @@ static gboolean toggle_option_cb (const gchar *option_name,
                                   gpointer user_data,
                                   GError **error);
 
+static gboolean stats_option_cb (const gchar *option_name,
+                                 const gchar *value,
+                                 gpointer user_data,
+                                 GError **error);
+
 gboolean tilda_cli_options_parse_options (tilda_cli_options *cli_options,
                                           gint argc,
                                           gchar *argv[],
@@ -47,6 +52,7 @@ gboolean tilda_cli_options_parse_options (tilda_cli_options *cli_options,
             { "y-pos",              'y', 0, G_OPTION_ARG_INT,       &(cli_options->y_pos),             N_("Y Position"), NULL },
             { "background-alpha",   't', 0, G_OPTION_ARG_INT,       &(cli_options->back_alpha),        N_("Opaqueness: 0-100%"), NULL },
             { "config",             'C', 0, G_OPTION_ARG_NONE,      &(cli_options->show_config),       N_("Show Configuration Wizard"), NULL },
+            { "profile-startup",    0,   0, G_OPTION_ARG_NONE,      &(cli_options->profile_startup),   N_("Print the duration of each startup phase"), NULL },
             G_OPTION_ENTRY_NULL
     };
 
@@ -56,6 +62,9 @@ gboolean tilda_cli_options_parse_options (tilda_cli_options *cli_options,
             { "toggle-window", 'T', G_OPTION_FLAG_OPTIONAL_ARG, G_OPTION_ARG_CALLBACK,
               toggle_option_cb,  N_("Toggle N-th instance Window visibility and exit"), NULL
             },
+            { "stats", 0, G_OPTION_FLAG_OPTIONAL_ARG, G_OPTION_ARG_CALLBACK,
+              stats_option_cb,  N_("Print the runtime metrics of the N-th instance and exit"), NULL
+            },
             G_OPTION_ENTRY_NULL
     };
 
@@ -119,32 +128,22 @@ tilda_cli_options *tilda_cli_options_new ()
     // instance id of the windows will be in range from 0 to N,
     // defaults to -1 (unset) if option is not used.
     options->toggle_window = -1;
+    options->show_stats = -1;
 
     return options;
 }
 
 /**
- * toggle_option_cb: A GOptionArgFunc which parses the toggle-window option
- * argument. Using this toggle function allows us to assign a default value,
- * if the user just specifies the option without a value. For example, the
- * user may use '-T' instead of '-T 0', in this case we set the default
- * instance_id to 0. Most users will want to use the default unless they
- * are running multiple tilda instances and thus this makes the setup
- * of toggle shortcuts easier.
+ * parse_instance_argument: Parses the optional instance id argument of the
+ * toggle-window and stats options. If no instance id was given, it
+ * defaults to 0.
  */
-static gboolean toggle_option_cb (G_GNUC_UNUSED const gchar *option_name,
-                                  const gchar *value,
-                                  gpointer user_data,
-                                  GError **error)
+static gboolean parse_instance_argument (const gchar *value,
+                                         gint *instance,
+                                         GError **error)
 {
-    if (!user_data) {
-        g_error("Missing user_data pointer in toggle_option_cb function.");
-    }
-
-    tilda_cli_options *options = user_data;
-
     if (!value || !value[0]) {
-        options->toggle_window = 0;
+        *instance = 0;
         return TRUE;
     }
 
@@ -153,7 +152,7 @@ static gboolean toggle_option_cb (G_GNUC_UNUSED const gchar *option_name,
     long instance_id = strtol(value, &parseEnd, 10);
 
     if (parseEnd != NULL && *parseEnd != '\0') {
-        g_set_error(error, tilda_error_quark(), TILDA_CONFIG_ERROR_BAD_INPUT, "Could not parse the toggle argument. The argument must be a valid integer.");
+        g_set_error(error, tilda_error_quark(), TILDA_CONFIG_ERROR_BAD_INPUT, "Could not parse the instance argument. The argument must be a valid integer.");
         return FALSE;
     }
 
@@ -163,7 +162,7 @@ static gboolean toggle_option_cb (G_GNUC_UNUSED const gchar *option_name,
     // against INT_MAX
     if (instance_id > INT_MAX) {
         g_set_error (error, tilda_error_quark(), TILDA_CONFIG_ERROR_BAD_INPUT,
-                     "The toggle window option cannot must not be greater than %d, but value was %ld.", INT_MAX, instance_id);
+                     "The instance argument must not be greater than %d, but value was %ld.", INT_MAX, instance_id);
         return FALSE;
     }
 
@@ -172,7 +171,48 @@ static gboolean toggle_option_cb (G_GNUC_UNUSED const gchar *option_name,
         instance_id = 0;
     }
 
-    options->toggle_window = (gint) instance_id;
+    *instance = (gint) instance_id;
 
     return TRUE;
 }
+
+/**
+ * toggle_option_cb: A GOptionArgFunc which parses the toggle-window option
+ * argument. Using this toggle function allows us to assign a default value,
+ * if the user just specifies the option without a value. For example, the
+ * user may use '-T' instead of '-T 0', in this case we set the default
+ * instance_id to 0. Most users will want to use the default unless they
+ * are running multiple tilda instances and thus this makes the setup
+ * of toggle shortcuts easier.
+ */
+static gboolean toggle_option_cb (G_GNUC_UNUSED const gchar *option_name,
+                                  const gchar *value,
+                                  gpointer user_data,
+                                  GError **error)
+{
+    if (!user_data) {
+        g_error("Missing user_data pointer in toggle_option_cb function.");
+    }
+
+    tilda_cli_options *options = user_data;
+
+    return parse_instance_argument (value, &options->toggle_window, error);
+}
+
+/**
+ * stats_option_cb: A GOptionArgFunc which parses the stats option argument
+ * in the same way as toggle_option_cb.
+ */
+static gboolean stats_option_cb (G_GNUC_UNUSED const gchar *option_name,
+                                 const gchar *value,
+                                 gpointer user_data,
+                                 GError **error)
+{
+    if (!user_data) {
+        g_error("Missing user_data pointer in stats_option_cb function.");
+    }
+
+    tilda_cli_options *options = user_data;
+
+    return parse_instance_argument (value, &options->show_stats, error);
+}
@@ -11,6 +11,7 @@ struct tilda_cli_options {
     gchar *font;
     gchar *working_dir;
     gint toggle_window;
+    gint show_stats;
     gint back_alpha;
     gint lines;
     gint x_pos;
@@ -20,6 +21,7 @@ struct tilda_cli_options {
     gboolean version;
     gboolean hidden;
     gboolean enable_dbus;
+    gboolean profile_startup;
 };
 
 /**
@@ -1,7 +1,13 @@
 #include "tilda-context-menu.h"
 
+#include "configsys.h"
 #include "debug.h"
 #include "wizard.h"
+#include "tilda-activity.h"
+#include "tilda-paste.h"
+#include "tilda-recorder.h"
+#include "tilda-scrollback.h"
+#include "tilda-startup.h"
 #include "tilda-url-spawner.h"
 
 #include <vte/vte.h>
@@ -62,7 +68,78 @@ menu_paste_cb (GSimpleAction *action,
 
     tilda_term *tt = TILDA_TERM (user_data);
 
-    vte_terminal_paste_clipboard (VTE_TERMINAL (tt->vte_term));
+    tilda_paste_clipboard (tt);
+}
+
+static void
+menu_save_scrollback_cb (GSimpleAction *action,
+                         GVariant      *parameter,
+                         gpointer       user_data)
+{
+    DEBUG_FUNCTION ("menu_save_scrollback_cb");
+    DEBUG_ASSERT (user_data != NULL);
+
+    tilda_scrollback_save_with_dialog (TILDA_TERM (user_data));
+}
+
+static void
+menu_toggle_recording_cb (GSimpleAction *action,
+                          GVariant      *parameter,
+                          gpointer       user_data)
+{
+    DEBUG_FUNCTION ("menu_toggle_recording_cb");
+    DEBUG_ASSERT (user_data != NULL);
+
+    tilda_term *tt = TILDA_TERM (user_data);
+    GError *error = NULL;
+
+    if (tilda_recorder_get_path (tt) != NULL) {
+        tilda_recorder_stop (tt);
+        return;
+    }
+
+    if (!tilda_recorder_start (tt, &error)) {
+        g_printerr (_("Could not start recording: %s\n"), error->message);
+        g_error_free (error);
+    }
+}
+
+/* Silence monitoring enabled from the menu uses the configured number of
+ * seconds, or this default if it is disabled in the configuration. */
+#define DEFAULT_MONITOR_SILENCE 10
+
+static void
+menu_monitor_activity_cb (GSimpleAction *action,
+                          GVariant      *value,
+                          gpointer       user_data)
+{
+    DEBUG_FUNCTION ("menu_monitor_activity_cb");
+    DEBUG_ASSERT (user_data != NULL);
+
+    tilda_term *tt = TILDA_TERM (user_data);
+
+    tilda_activity_set_monitoring (tt, g_variant_get_boolean (value), tt->monitor_silence);
+    g_simple_action_set_state (action, value);
+}
+
+static void
+menu_monitor_silence_cb (GSimpleAction *action,
+                         GVariant      *value,
+                         gpointer       user_data)
+{
+    DEBUG_FUNCTION ("menu_monitor_silence_cb");
+    DEBUG_ASSERT (user_data != NULL);
+
+    tilda_term *tt = TILDA_TERM (user_data);
+    guint silence = 0;
+
+    if (g_variant_get_boolean (value)) {
+        gint configured = config_getint ("monitor_silence");
+        silence = configured > 0 ? (guint) configured : DEFAULT_MONITOR_SILENCE;
+    }
+
+    tilda_activity_set_monitoring (tt, tt->monitor_activity, silence);
+    g_simple_action_set_state (action, value);
 }
 
 static void
@@ -203,6 +280,28 @@ create_menu_model (TildaContextMenu * context_menu)
 
     g_menu_append_section (menu, NULL, G_MENU_MODEL (match_section));
 
+    // scrollback section
+
+    GMenu *scrollback_section = g_menu_new ();
+    g_menu_append (scrollback_section, _("_Save Scrollback..."), "window.save-scrollback");
+
+    if (tilda_recorder_can_record (context_menu->tt)) {
+        if (tilda_recorder_get_path (context_menu->tt) != NULL) {
+            g_menu_append (scrollback_section, _("Stop _Recording"), "window.toggle-recording");
+        } else {
+            g_menu_append (scrollback_section, _("Start _Recording"), "window.toggle-recording");
+        }
+    }
+
+    g_menu_append_section (menu, NULL, G_MENU_MODEL (scrollback_section));
+
+    // monitor section
+
+    GMenu *monitor_section = g_menu_new ();
+    g_menu_append (monitor_section, _("Monitor for _Activity"), "window.monitor-activity");
+    g_menu_append (monitor_section, _("Monitor for Si_lence"), "window.monitor-silence");
+    g_menu_append_section (menu, NULL, G_MENU_MODEL (monitor_section));
+
     // toggle section
 
     GMenu *toggle_section = g_menu_new ();
@@ -232,16 +331,15 @@ tilda_context_menu_popup (tilda_window *tw, tilda_term *tt, const char * match,
     DEBUG_ASSERT (tw != NULL);
     DEBUG_ASSERT (tt != NULL);
 
+    /* The menu shows the accelerators and may open the wizard */
+    tilda_startup_finish (tw);
+
     TildaContextMenu * context_menu = g_new0 (TildaContextMenu, 1);
     context_menu->tw = tw;
     context_menu->tt = tt;
     context_menu->match = g_strdup (match);
     context_menu->match_entry = entry;
 
-    GtkBuilder *builder = gtk_builder_new ();
-
-    gtk_builder_add_from_resource (builder, "/org/tilda/menu.ui", NULL);
-
     /* Create the action group */
     GSimpleActionGroup *action_group = g_simple_action_group_new ();
 
@@ -265,7 +363,11 @@ tilda_context_menu_popup (tilda_window *tw, tilda_term *tt, const char * match,
 
     GActionEntry entries_for_tilda_terminal[] = {
             { .name="copy", menu_copy_cb},
-            { .name="paste", menu_paste_cb}
+            { .name="paste", menu_paste_cb},
+            { .name="save-scrollback", menu_save_scrollback_cb},
+            { .name="toggle-recording", menu_toggle_recording_cb},
+            { .name="monitor-activity", .state="false", .change_state=menu_monitor_activity_cb},
+            { .name="monitor-silence", .state="false", .change_state=menu_monitor_silence_cb}
     };
 
     GActionEntry entries_for_match_copy [] = {
@@ -281,6 +383,13 @@ tilda_context_menu_popup (tilda_window *tw, tilda_term *tt, const char * match,
     g_action_map_add_action_entries (G_ACTION_MAP (action_group),
                                      entries_for_tilda_terminal, G_N_ELEMENTS (entries_for_tilda_terminal), tt);
 
+    g_simple_action_set_state (G_SIMPLE_ACTION (g_action_map_lookup_action (G_ACTION_MAP (action_group),
+                                                                            "monitor-activity")),
+                               g_variant_new_boolean (tt->monitor_activity));
+    g_simple_action_set_state (G_SIMPLE_ACTION (g_action_map_lookup_action (G_ACTION_MAP (action_group),
+                                                                            "monitor-silence")),
+                               g_variant_new_boolean (tt->monitor_silence > 0));
+
     g_action_map_add_action_entries (G_ACTION_MAP (action_group),
                                      entries_for_match_copy, G_N_ELEMENTS (entries_for_match_copy), context_menu->match);
 
@@ -303,7 +412,6 @@ tilda_context_menu_popup (tilda_window *tw, tilda_term *tt, const char * match,
     g_signal_connect (G_OBJECT (menu), "selection-done", G_CALLBACK (on_selection_done), context_menu);
 
     g_object_unref (action_group);
-    g_object_unref (builder);
 
     return menu;
 }
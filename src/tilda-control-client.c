@@ -0,0 +1,106 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L /* feature test macro for SOCK_CLOEXEC */
+
+#include "tilda-control-client.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TILDA_CONTROL_SOCKET_DIR "tilda"
+#define TILDA_CONTROL_SOCKET_NAME "control-%d"
+
+int
+tilda_control_client_get_address (int instance, struct sockaddr_un *address)
+{
+    const char *runtime_dir = getenv ("XDG_RUNTIME_DIR");
+    int length;
+
+    if (runtime_dir == NULL || runtime_dir[0] == '\0') {
+        return -1;
+    }
+
+    memset (address, 0, sizeof (*address));
+    address->sun_family = AF_UNIX;
+
+    length = snprintf (address->sun_path, sizeof (address->sun_path),
+                       "%s/" TILDA_CONTROL_SOCKET_DIR "/" TILDA_CONTROL_SOCKET_NAME,
+                       runtime_dir, instance);
+
+    if (length < 0 || (size_t) length >= sizeof (address->sun_path)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int
+tilda_control_client_parse_instance (const char *value, int *instance)
+{
+    char *end = NULL;
+    long parsed;
+
+    if (value == NULL || value[0] == '\0') {
+        *instance = 0;
+        return 0;
+    }
+
+    errno = 0;
+    parsed = strtol (value, &end, 10);
+
+    if (errno != 0 || *end != '\0' || parsed > INT_MAX) {
+        return -1;
+    }
+
+    *instance = parsed < 0 ? 0 : (int) parsed;
+
+    return 0;
+}
+
+int
+tilda_control_client_send (int instance, char command)
+{
+    struct sockaddr_un address;
+    int fd;
+    ssize_t written;
+
+    if (tilda_control_client_get_address (instance, &address) < 0) {
+        return -1;
+    }
+
+    fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (connect (fd, (struct sockaddr *) &address, sizeof (address)) < 0) {
+        close (fd);
+        return -1;
+    }
+
+    do {
+        written = write (fd, &command, 1);
+    } while (written < 0 && errno == EINTR);
+
+    close (fd);
+
+    return written == 1 ? 0 : -1;
+}
@@ -0,0 +1,51 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILDA_CONTROL_CLIENT_H
+#define TILDA_CONTROL_CLIENT_H
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/**
+ * The client side of the control socket of an instance, see
+ * tilda-control-socket.h. It only uses libc, so that tilda-toggle does not
+ * link GLib or GTK and tilda can use it before they are initialized.
+ */
+
+enum tilda_control_command {
+    TILDA_CONTROL_TOGGLE = 't'
+};
+
+/**
+ * Writes the path of the socket of instance into address. Returns -1 if
+ * XDG_RUNTIME_DIR is not set or the path is too long, 0 otherwise.
+ */
+int tilda_control_client_get_address (int instance, struct sockaddr_un *address);
+
+/**
+ * Parses the instance argument of -T like the option parser of tilda does.
+ * An empty or missing value is instance 0. Returns -1 if value is not a
+ * number, 0 otherwise.
+ */
+int tilda_control_client_parse_instance (const char *value, int *instance);
+
+/**
+ * Sends command to the socket of instance. Returns -1 if the instance
+ * could not be reached, 0 otherwise.
+ */
+int tilda_control_client_send (int instance, char command);
+
+#endif /* TILDA_CONTROL_CLIENT_H */
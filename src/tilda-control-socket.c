@@ -0,0 +1,200 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE /* feature test macro for accept4 */
+
+#include "tilda-control-socket.h"
+
+#include "debug.h"
+#include "key_grabber.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib-unix.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+struct tilda_control_socket_
+{
+    gint fd;
+    guint source;
+    gchar *path;
+};
+
+gboolean
+tilda_control_socket_try_toggle (int argc, char *argv[])
+{
+    const char *value = NULL;
+    int instance;
+
+    if (argc < 2 || argc > 3) {
+        return FALSE;
+    }
+
+    if (strcmp (argv[1], "-T") == 0 || strcmp (argv[1], "--toggle-window") == 0) {
+        /* Like GOption, take the next argument as the value unless it
+         * looks like an option */
+        if (argc == 3) {
+            if (argv[2][0] == '-') {
+                return FALSE;
+            }
+
+            value = argv[2];
+        }
+    } else if (argc == 2 && strncmp (argv[1], "-T", 2) == 0) {
+        value = argv[1] + 2;
+    } else if (argc == 2 && strncmp (argv[1], "--toggle-window=", 16) == 0) {
+        value = argv[1] + 16;
+    } else {
+        return FALSE;
+    }
+
+    if (tilda_control_client_parse_instance (value, &instance) < 0) {
+        return FALSE;
+    }
+
+    return tilda_control_client_send (instance, TILDA_CONTROL_TOGGLE) == 0;
+}
+
+static void
+run_command (tilda_window *tw, char command)
+{
+    switch (command)
+    {
+        case TILDA_CONTROL_TOGGLE:
+            pull (tw, PULL_TOGGLE, FALSE);
+            break;
+        default:
+            g_debug ("Ignoring unknown control command %d", command);
+            break;
+    }
+}
+
+static gboolean
+client_readable_cb (gint fd, G_GNUC_UNUSED GIOCondition condition, gpointer user_data)
+{
+    char command;
+    ssize_t count;
+
+    count = read (fd, &command, 1);
+
+    if (count < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return G_SOURCE_CONTINUE;
+    }
+
+    if (count == 1) {
+        run_command (user_data, command);
+    }
+
+    close (fd);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+accept_cb (gint fd, G_GNUC_UNUSED GIOCondition condition, gpointer user_data)
+{
+    gint client_fd;
+
+    client_fd = accept4 (fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+
+    if (client_fd < 0) {
+        return G_SOURCE_CONTINUE;
+    }
+
+    /* The command usually arrives with the connection, but it may follow
+     * later, so it is read once the client socket becomes readable. */
+    g_unix_fd_add (client_fd, G_IO_IN | G_IO_HUP | G_IO_ERR, client_readable_cb, user_data);
+
+    return G_SOURCE_CONTINUE;
+}
+
+void
+tilda_control_socket_init (tilda_window *tw)
+{
+    DEBUG_FUNCTION ("tilda_control_socket_init");
+    DEBUG_ASSERT (tw != NULL);
+
+    struct sockaddr_un address;
+    gchar *dir;
+    gint fd;
+
+    if (tilda_control_client_get_address (tw->instance, &address) < 0) {
+        return;
+    }
+
+    dir = g_path_get_dirname (address.sun_path);
+
+    if (g_mkdir_with_parents (dir, 0700) < 0) {
+        g_printerr (_("Could not create the directory %s: %s\n"), dir, g_strerror (errno));
+        g_free (dir);
+        return;
+    }
+
+    g_free (dir);
+
+    fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+
+    if (fd < 0) {
+        g_printerr (_("Could not create the control socket: %s\n"), g_strerror (errno));
+        return;
+    }
+
+    /* The instance lock is held, so a socket that already exists was left
+     * behind by a previous instance that crashed. */
+    g_unlink (address.sun_path);
+
+    if (bind (fd, (struct sockaddr *) &address, sizeof (address)) < 0
+        || listen (fd, 8) < 0)
+    {
+        g_printerr (_("Could not listen on the control socket %s: %s\n"),
+                    address.sun_path, g_strerror (errno));
+        close (fd);
+        return;
+    }
+
+    tw->control_socket = g_new0 (struct tilda_control_socket_, 1);
+    tw->control_socket->fd = fd;
+    tw->control_socket->path = g_strdup (address.sun_path);
+    tw->control_socket->source = g_unix_fd_add (fd, G_IO_IN, accept_cb, tw);
+}
+
+void
+tilda_control_socket_free (tilda_window *tw)
+{
+    DEBUG_FUNCTION ("tilda_control_socket_free");
+    DEBUG_ASSERT (tw != NULL);
+
+    struct tilda_control_socket_ *control_socket = tw->control_socket;
+
+    if (control_socket == NULL) {
+        return;
+    }
+
+    if (control_socket->source) {
+        g_source_remove (control_socket->source);
+    }
+
+    close (control_socket->fd);
+    g_unlink (control_socket->path);
+    g_free (control_socket->path);
+    g_free (control_socket);
+
+    tw->control_socket = NULL;
+}
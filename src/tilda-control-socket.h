@@ -0,0 +1,62 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILDA_CONTROL_SOCKET_H
+#define TILDA_CONTROL_SOCKET_H
+
+#include "tilda-control-client.h"
+#include "tilda_window.h"
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * A Unix socket per instance that accepts single byte commands, so that
+ * "tilda -T" can toggle a running instance without going through the
+ * session bus. The socket is $XDG_RUNTIME_DIR/tilda/control-N for the
+ * instance N.
+ *
+ * The client side is in tilda-control-client.c. It is used by the
+ * tilda-toggle program, which does not link GTK, and by "tilda -T" at the
+ * very start of main(), before GLib or GTK are initialized but after their
+ * libraries were loaded.
+ */
+
+/**
+ * Creates the socket of the instance of tw and starts accepting commands.
+ * Does nothing if XDG_RUNTIME_DIR is not set.
+ */
+void tilda_control_socket_init (tilda_window *tw);
+
+/**
+ * Stops accepting commands and removes the socket.
+ */
+void tilda_control_socket_free (tilda_window *tw);
+
+/**
+ * If the command line only asks to toggle an instance (-T, -T N, -TN,
+ * --toggle-window or --toggle-window=N), sends the toggle command to the
+ * socket of the instance. Returns TRUE if the command was sent, FALSE if
+ * the command line has other options or the instance could not be reached,
+ * in which case the command line must be handled as usual.
+ *
+ * This function must not use GLib, it runs before anything is initialized.
+ */
+gboolean tilda_control_socket_try_toggle (int argc, char *argv[]);
+
+G_END_DECLS
+
+#endif /* TILDA_CONTROL_SOCKET_H */
@@ -0,0 +1,428 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE /* feature test macro for SCHED_IDLE */
+
+#include "tilda-cpu-policy.h"
+
+#include "configsys.h"
+#include "debug.h"
+#include "tilda-proc-monitor.h"
+#include "tilda_terminal.h"
+
+#include <errno.h>
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+struct tilda_cpu_policy_
+{
+    enum tilda_cpu_policy policy;
+
+    /* The nice value of throttled threads for TILDA_CPU_POLICY_NICE */
+    gint nice;
+
+    /* The lowest nice value that we are allowed to set, only threads
+     * with a nice value of at least this value can be restored. */
+    gint lowest_nice;
+
+    /* Runs the requests one after another in a single worker thread */
+    GThreadPool *pool;
+
+    /* Maps tab ids to TildaThrottledTab, only used by the worker thread */
+    GHashTable *throttled_tabs;
+};
+
+typedef struct
+{
+    gint nice;
+    gint policy;
+} TildaSchedulingState;
+
+typedef struct
+{
+    /* The original state of the shell, which is used for processes that
+     * were started while the tab was throttled */
+    TildaSchedulingState root;
+
+    /* Maps thread ids to their original TildaSchedulingState */
+    GHashTable *threads;
+} TildaThrottledTab;
+
+typedef struct
+{
+    guint id;
+    GPid pid;
+    gboolean visible;
+} TildaCpuPolicyTab;
+
+static void
+throttled_tab_free (TildaThrottledTab *tab)
+{
+    g_hash_table_destroy (tab->threads);
+    g_free (tab);
+}
+
+static gboolean
+get_scheduling_state (pid_t tid, TildaSchedulingState *state)
+{
+    errno = 0;
+    state->nice = getpriority (PRIO_PROCESS, (id_t) tid);
+
+    if (state->nice == -1 && errno != 0) {
+        return FALSE;
+    }
+
+    state->policy = sched_getscheduler (tid);
+
+    return state->policy != -1;
+}
+
+static void
+set_scheduling_state (pid_t tid, const TildaSchedulingState *state)
+{
+    struct sched_param param = { 0 };
+
+    if (sched_getscheduler (tid) != state->policy) {
+        sched_setscheduler (tid, state->policy, &param);
+    }
+
+    setpriority (PRIO_PROCESS, (id_t) tid, state->nice);
+}
+
+/* Nice values and scheduling policies apply to threads, so we need to
+ * change all threads of all processes in the tree. */
+static GArray *
+list_threads (GArray *tree)
+{
+    GArray *threads;
+
+    threads = g_array_new (FALSE, FALSE, sizeof (pid_t));
+
+    for (guint i = 0; i < tree->len; i++)
+    {
+        gchar *path;
+        GDir *dir;
+        const gchar *name;
+
+        path = g_strdup_printf ("/proc/%d/task", g_array_index (tree, GPid, i));
+        dir = g_dir_open (path, 0, NULL);
+        g_free (path);
+
+        if (dir == NULL) {
+            continue;
+        }
+
+        while ((name = g_dir_read_name (dir)) != NULL)
+        {
+            pid_t tid = (pid_t) atoi (name);
+
+            if (tid > 0) {
+                g_array_append_val (threads, tid);
+            }
+        }
+
+        g_dir_close (dir);
+    }
+
+    return threads;
+}
+
+static gboolean
+is_throttled_state (struct tilda_cpu_policy_ *policy,
+                    const TildaSchedulingState *state)
+{
+    if (policy->policy == TILDA_CPU_POLICY_IDLE) {
+        return state->policy == SCHED_IDLE;
+    }
+
+    return state->nice == policy->nice;
+}
+
+static void
+throttle_tab (struct tilda_cpu_policy_ *policy,
+              TildaThrottledTab *tab,
+              GArray *tree)
+{
+    struct sched_param param = { 0 };
+    GArray *threads;
+
+    threads = list_threads (tree);
+
+    for (guint i = 0; i < threads->len; i++)
+    {
+        pid_t tid = g_array_index (threads, pid_t, i);
+        TildaSchedulingState *original;
+        TildaSchedulingState state;
+
+        if (g_hash_table_contains (tab->threads, GINT_TO_POINTER (tid))
+            || !get_scheduling_state (tid, &state))
+        {
+            continue;
+        }
+
+        /* Real time threads are left alone, and we never change a thread
+         * whose priority we would not be allowed to restore. */
+        if ((state.policy != SCHED_OTHER && state.policy != SCHED_BATCH)
+            || state.nice < policy->lowest_nice)
+        {
+            continue;
+        }
+
+        if (policy->policy == TILDA_CPU_POLICY_NICE) {
+            if (state.nice >= policy->nice
+                || setpriority (PRIO_PROCESS, (id_t) tid, policy->nice) == -1)
+            {
+                continue;
+            }
+        } else {
+            if (sched_setscheduler (tid, SCHED_IDLE, &param) == -1) {
+                continue;
+            }
+        }
+
+        original = g_new (TildaSchedulingState, 1);
+        *original = state;
+
+        g_hash_table_insert (tab->threads, GINT_TO_POINTER (tid), original);
+    }
+
+    g_array_unref (threads);
+}
+
+static void
+restore_tab (struct tilda_cpu_policy_ *policy,
+             TildaThrottledTab *tab,
+             GArray *tree)
+{
+    GArray *threads;
+
+    threads = list_threads (tree);
+
+    for (guint i = 0; i < threads->len; i++)
+    {
+        pid_t tid = g_array_index (threads, pid_t, i);
+        TildaSchedulingState *original;
+        TildaSchedulingState state;
+
+        original = g_hash_table_lookup (tab->threads, GINT_TO_POINTER (tid));
+
+        if (original != NULL) {
+            set_scheduling_state (tid, original);
+            continue;
+        }
+
+        /* The thread was started while the tab was throttled and
+         * inherited the lowered priority from its parent. */
+        if (get_scheduling_state (tid, &state) && is_throttled_state (policy, &state)) {
+            set_scheduling_state (tid, &tab->root);
+        }
+    }
+
+    g_array_unref (threads);
+}
+
+static void
+apply_policy (gpointer data, gpointer user_data)
+{
+    GArray *tabs = data;
+    struct tilda_cpu_policy_ *policy = user_data;
+    GHashTable *ids;
+    GHashTable *trees;
+    GHashTableIter iter;
+    gpointer id;
+    GPid *roots;
+
+    roots = g_new (GPid, tabs->len);
+    ids = g_hash_table_new (NULL, NULL);
+
+    for (guint i = 0; i < tabs->len; i++)
+    {
+        TildaCpuPolicyTab *tab = &g_array_index (tabs, TildaCpuPolicyTab, i);
+
+        roots[i] = tab->pid;
+        g_hash_table_add (ids, GUINT_TO_POINTER (tab->id));
+    }
+
+    trees = tilda_proc_monitor_get_process_trees (roots, tabs->len);
+
+    for (guint i = 0; i < tabs->len; i++)
+    {
+        TildaCpuPolicyTab *tab = &g_array_index (tabs, TildaCpuPolicyTab, i);
+        TildaThrottledTab *throttled;
+        GArray *tree;
+
+        tree = g_hash_table_lookup (trees, GINT_TO_POINTER (tab->pid));
+        throttled = g_hash_table_lookup (policy->throttled_tabs, GUINT_TO_POINTER (tab->id));
+
+        if (tab->visible) {
+            if (throttled != NULL && tree != NULL) {
+                restore_tab (policy, throttled, tree);
+            }
+
+            g_hash_table_remove (policy->throttled_tabs, GUINT_TO_POINTER (tab->id));
+            continue;
+        }
+
+        if (tree == NULL) {
+            continue;
+        }
+
+        if (throttled == NULL) {
+            throttled = g_new0 (TildaThrottledTab, 1);
+            throttled->threads = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+
+            if (!get_scheduling_state (tab->pid, &throttled->root)) {
+                throttled->root.nice = 0;
+                throttled->root.policy = SCHED_OTHER;
+            }
+
+            g_hash_table_insert (policy->throttled_tabs, GUINT_TO_POINTER (tab->id), throttled);
+        }
+
+        throttle_tab (policy, throttled, tree);
+    }
+
+    /* Forget the tabs that have been closed */
+    g_hash_table_iter_init (&iter, policy->throttled_tabs);
+    while (g_hash_table_iter_next (&iter, &id, NULL))
+    {
+        if (!g_hash_table_contains (ids, id)) {
+            g_hash_table_iter_remove (&iter);
+        }
+    }
+
+    g_hash_table_unref (trees);
+    g_hash_table_unref (ids);
+    g_free (roots);
+    g_array_unref (tabs);
+}
+
+static void
+push_request (tilda_window *tw, gint visible_page, gboolean all_visible)
+{
+    GArray *tabs;
+    gint page = 0;
+
+    tabs = g_array_new (FALSE, FALSE, sizeof (TildaCpuPolicyTab));
+
+    for (GList *item = tw->terms; item != NULL; item = item->next, page++)
+    {
+        tilda_term *tt = item->data;
+        TildaCpuPolicyTab tab = { tt->id, tt->pid, all_visible || page == visible_page };
+
+        if (tt->pid > 0) {
+            g_array_append_val (tabs, tab);
+        }
+    }
+
+    g_thread_pool_push (tw->cpu_policy->pool, tabs, NULL);
+}
+
+void
+tilda_cpu_policy_init (tilda_window *tw)
+{
+    DEBUG_FUNCTION ("tilda_cpu_policy_init");
+    DEBUG_ASSERT (tw != NULL);
+
+    struct tilda_cpu_policy_ *policy;
+    struct rlimit limit;
+    gint policy_type;
+    gint lowest_nice;
+    gint background_nice;
+
+    policy_type = config_getint ("background_tab_policy");
+
+    if (policy_type != TILDA_CPU_POLICY_NICE && policy_type != TILDA_CPU_POLICY_IDLE) {
+        return;
+    }
+
+    /* An unprivileged process may only lower the nice value of a thread
+     * (and leave SCHED_IDLE) down to 20 - RLIMIT_NICE. */
+    if (geteuid () == 0) {
+        lowest_nice = -20;
+    } else if (getrlimit (RLIMIT_NICE, &limit) == 0) {
+        lowest_nice = limit.rlim_cur == RLIM_INFINITY ? -20 : 20 - (gint) MIN (limit.rlim_cur, 40);
+    } else {
+        lowest_nice = 20;
+    }
+
+    background_nice = CLAMP (config_getint ("background_tab_nice"), 1, 19);
+
+    /* Only threads whose priority can be restored are throttled, see
+     * throttle_tab(). If there can be no such thread the policy is off. */
+    if (lowest_nice > 19 || (policy_type == TILDA_CPU_POLICY_NICE && lowest_nice >= background_nice)) {
+        g_printerr (_("The background tab policy is disabled, because the priority of "
+                      "processes could not be restored. Raise the RLIMIT_NICE resource "
+                      "limit to at least 20 to enable it, see \"man tilda\".\n"));
+        return;
+    }
+
+    if (lowest_nice > 0) {
+        g_printerr (_("The background tab policy only applies to processes with a nice "
+                      "value of at least %d, because the priority of other processes "
+                      "could not be restored. Raise the RLIMIT_NICE resource limit to at "
+                      "least 20 to apply it to all processes.\n"), lowest_nice);
+    }
+
+    policy = g_new0 (struct tilda_cpu_policy_, 1);
+    policy->policy = policy_type;
+    policy->nice = background_nice;
+    policy->lowest_nice = lowest_nice;
+    policy->throttled_tabs = g_hash_table_new_full (NULL, NULL, NULL,
+                                                    (GDestroyNotify) throttled_tab_free);
+    policy->pool = g_thread_pool_new (apply_policy, policy, 1, FALSE, NULL);
+
+    tw->cpu_policy = policy;
+}
+
+void
+tilda_cpu_policy_update (tilda_window *tw, gint visible_page)
+{
+    DEBUG_FUNCTION ("tilda_cpu_policy_update");
+    DEBUG_ASSERT (tw != NULL);
+
+    if (tw->cpu_policy == NULL) {
+        return;
+    }
+
+    push_request (tw, visible_page, FALSE);
+}
+
+void
+tilda_cpu_policy_free (tilda_window *tw)
+{
+    DEBUG_FUNCTION ("tilda_cpu_policy_free");
+    DEBUG_ASSERT (tw != NULL);
+
+    struct tilda_cpu_policy_ *policy = tw->cpu_policy;
+
+    if (policy == NULL) {
+        return;
+    }
+
+    /* Processes may outlive tilda, so they get their priority back */
+    push_request (tw, -1, TRUE);
+
+    g_thread_pool_free (policy->pool, FALSE, TRUE);
+    g_hash_table_destroy (policy->throttled_tabs);
+    g_free (policy);
+
+    tw->cpu_policy = NULL;
+}
@@ -0,0 +1,65 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILDA_CPU_POLICY_H
+#define TILDA_CPU_POLICY_H
+
+#include "tilda_window.h"
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * The CPU policy lowers the CPU priority of the processes in tabs that are
+ * not visible, either because another tab is selected or because the tilda
+ * window is pulled up. The original priority is restored once the tab
+ * becomes visible again.
+ *
+ * The policy is off unless it is selected with the "background_tab_policy"
+ * option. Only unprivileged mechanisms are used, and only if the original
+ * priority can be restored again. An unprivileged process can only restore
+ * a nice value of 0 with an RLIMIT_NICE of at least 20, under the default
+ * limit of 0 the policy stays off. This is documented in the man page.
+ */
+enum tilda_cpu_policy {
+    TILDA_CPU_POLICY_NONE,
+    /* Renice the threads to the "background_tab_nice" value */
+    TILDA_CPU_POLICY_NICE,
+    /* Move the threads to the SCHED_IDLE scheduling policy */
+    TILDA_CPU_POLICY_IDLE
+};
+
+/**
+ * Sets up the CPU policy according to the configuration.
+ */
+void tilda_cpu_policy_init (tilda_window *tw);
+
+/**
+ * Applies the CPU policy to all tabs. The tab at visible_page keeps its
+ * original priority, all other tabs are throttled. Pass -1 if no tab is
+ * visible. The work is done asynchronously in a worker thread.
+ */
+void tilda_cpu_policy_update (tilda_window *tw, gint visible_page);
+
+/**
+ * Restores the original priority of all processes and releases the CPU
+ * policy. Waits until the restore has been completed.
+ */
+void tilda_cpu_policy_free (tilda_window *tw);
+
+G_END_DECLS
+
+#endif /* TILDA_CPU_POLICY_H */
@@ -1,7 +1,17 @@
 #include "tilda-dbus-actions.h"
 
+#include "configsys.h"
 #include "key_grabber.h"
+#include "tilda-activity.h"
 #include "tilda-dbus.h"
+#include "tilda-metrics.h"
+#include "tilda-paste.h"
+#include "tilda-proc-monitor.h"
+#include "tilda-regex-cache.h"
+#include "tilda-scrollback.h"
+#include "tilda-trace.h"
+#include "tilda-watch.h"
+#include "tilda_terminal.h"
 
 #define TILDA_DBUS_ACTIONS_BUS_NAME "com.github.lanoxx.tilda.Actions"
 #define TILDA_DBUS_ACTIONS_OBJECT_PATH "/com/github/lanoxx/tilda/Actions"
@@ -31,6 +41,716 @@ on_handle_toggle (TildaDbusActions *skeleton,
     return GDK_EVENT_STOP;
 }
 
+static gboolean
+on_handle_get_tab_resources (TildaDbusActions *skeleton,
+                             GDBusMethodInvocation *invocation,
+                             gpointer user_data)
+{
+    tilda_window *window;
+    GVariantBuilder builder;
+
+    window = user_data;
+
+    if (!tilda_proc_monitor_is_running (window)) {
+        g_dbus_method_invocation_return_error (invocation,
+                                               G_DBUS_ERROR,
+                                               G_DBUS_ERROR_NOT_SUPPORTED,
+                                               "The resource monitor is not enabled");
+        return GDK_EVENT_STOP;
+    }
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(udtt)"));
+
+    for (GList *item = window->terms; item != NULL; item = item->next)
+    {
+        tilda_term *tt = item->data;
+
+        g_variant_builder_add (&builder, "(udtt)",
+                               tt->id, tt->cpu_usage,
+                               tt->memory_usage, tt->io_rate);
+    }
+
+    tilda_dbus_actions_complete_get_tab_resources (skeleton, invocation,
+                                                   g_variant_builder_end (&builder));
+
+    return GDK_EVENT_STOP;
+}
+
+/* Returns the tab with the id tab, or the current tab if tab is 0. */
+static tilda_term *
+find_tab (tilda_window *window, guint tab, GError **error)
+{
+    tilda_term *tt = NULL;
+
+    if (tab == 0) {
+        gint page = gtk_notebook_get_current_page (GTK_NOTEBOOK (window->notebook));
+        tt = page >= 0 ? g_list_nth_data (window->terms, (guint) page) : NULL;
+    }
+
+    for (GList *item = window->terms; item != NULL && tt == NULL; item = item->next)
+    {
+        if (TILDA_TERM (item->data)->id == tab) {
+            tt = item->data;
+        }
+    }
+
+    if (tt == NULL) {
+        g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                     "There is no tab with the id %u", tab);
+    }
+
+    return tt;
+}
+
+/* Like find_tab() but returns the error to the caller of the method */
+static tilda_term *
+lookup_tab (tilda_window *window, guint tab, GDBusMethodInvocation *invocation)
+{
+    GError *error = NULL;
+    tilda_term *tt;
+
+    tt = find_tab (window, tab, &error);
+
+    if (tt == NULL) {
+        g_dbus_method_invocation_take_error (invocation, error);
+    }
+
+    return tt;
+}
+
+/* The methods below are operations that can also be run in a batch. Each
+ * takes the parameters of the method as a tuple and returns its result as
+ * a tuple, or NULL and an error. */
+
+static GVariant *
+run_new_tab (tilda_window *window, GVariant *parameters, GError **error)
+{
+    const gchar *cwd;
+    const gchar *command;
+    tilda_term *tt;
+
+    g_variant_get (parameters, "(&s&s)", &cwd, &command);
+
+    tt = tilda_window_add_tab_full (window, -1,
+                                    cwd[0] != '\0' ? cwd : NULL,
+                                    command[0] != '\0' ? command : NULL,
+                                    FALSE);
+
+    if (tt == NULL) {
+        g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_FAILED, "Could not create the tab");
+        return NULL;
+    }
+
+    return g_variant_new ("(u)", tt->id);
+}
+
+static GVariant *
+run_close_tab (tilda_window *window, GVariant *parameters, GError **error)
+{
+    tilda_term *tt;
+    guint tab;
+    gint page;
+
+    g_variant_get (parameters, "(u)", &tab);
+
+    tt = find_tab (window, tab, error);
+
+    if (tt == NULL) {
+        return NULL;
+    }
+
+    page = gtk_notebook_page_num (GTK_NOTEBOOK (window->notebook), tt->hbox);
+    tilda_window_close_tab (window, page, FALSE);
+
+    return g_variant_new ("()");
+}
+
+static void
+stop_switch_timing (tilda_window *window)
+{
+    if (window->dbus_switch_paint_handler) {
+        g_signal_handler_disconnect (gtk_widget_get_frame_clock (window->window),
+                                     window->dbus_switch_paint_handler);
+        window->dbus_switch_paint_handler = 0;
+    }
+}
+
+static void
+switch_painted_cb (G_GNUC_UNUSED GdkFrameClock *frame_clock, tilda_window *window)
+{
+    tilda_metrics_observe (TILDA_METRIC_TAB_SWITCH_TIME,
+                           g_get_monotonic_time () - window->dbus_switch_time);
+
+    stop_switch_timing (window);
+}
+
+/* Records the time from a tab switch until the window was painted with
+ * the new tab. A hidden window is not painted and is not measured. */
+static void
+start_switch_timing (tilda_window *window)
+{
+    GdkFrameClock *frame_clock = gtk_widget_get_frame_clock (window->window);
+
+    stop_switch_timing (window);
+
+    if (!gtk_widget_get_visible (window->window) || frame_clock == NULL) {
+        return;
+    }
+
+    window->dbus_switch_time = g_get_monotonic_time ();
+    window->dbus_switch_paint_handler = g_signal_connect (frame_clock, "after-paint",
+                                                          G_CALLBACK (switch_painted_cb),
+                                                          window);
+}
+
+static GVariant *
+run_focus_tab (tilda_window *window, GVariant *parameters, GError **error)
+{
+    tilda_term *tt;
+    guint tab;
+    gint page;
+
+    g_variant_get (parameters, "(u)", &tab);
+
+    tt = find_tab (window, tab, error);
+
+    if (tt == NULL) {
+        return NULL;
+    }
+
+    page = gtk_notebook_page_num (GTK_NOTEBOOK (window->notebook), tt->hbox);
+
+    if (page != gtk_notebook_get_current_page (GTK_NOTEBOOK (window->notebook))) {
+        start_switch_timing (window);
+    }
+
+    gtk_notebook_set_current_page (GTK_NOTEBOOK (window->notebook), page);
+    gtk_widget_grab_focus (tt->vte_term);
+
+    return g_variant_new ("()");
+}
+
+static GVariant *
+run_send_text (tilda_window *window, GVariant *parameters, GError **error)
+{
+    const gchar *text;
+    tilda_term *tt;
+    guint tab;
+
+    g_variant_get (parameters, "(u&s)", &tab, &text);
+
+    tt = find_tab (window, tab, error);
+
+    if (tt == NULL) {
+        return NULL;
+    }
+
+    if (!tilda_term_feed_child (tt, text, -1)) {
+        g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
+                     "The shell of tab %u is not running", tab);
+        return NULL;
+    }
+
+    return g_variant_new ("()");
+}
+
+static GVariant *
+run_paste_clipboard (tilda_window *window, GVariant *parameters, GError **error)
+{
+    tilda_term *tt;
+    guint tab;
+
+    g_variant_get (parameters, "(u)", &tab);
+
+    tt = find_tab (window, tab, error);
+
+    if (tt == NULL) {
+        return NULL;
+    }
+
+    tilda_paste_clipboard (tt);
+
+    return g_variant_new ("()");
+}
+
+static GVariant *
+run_list_tabs (tilda_window *window,
+               G_GNUC_UNUSED GVariant *parameters,
+               G_GNUC_UNUSED GError **error)
+{
+    GVariantBuilder builder;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(usis)"));
+
+    for (GList *item = window->terms; item != NULL; item = item->next)
+    {
+        tilda_term *tt = item->data;
+        gchar *title = tilda_terminal_get_title (tt);
+        gchar *cwd = tilda_term_get_cwd (tt);
+
+        g_variant_builder_add (&builder, "(usis)",
+                               tt->id,
+                               title != NULL ? title : "",
+                               (gint32) tt->pid,
+                               cwd != NULL ? cwd : "");
+
+        g_free (title);
+        g_free (cwd);
+    }
+
+    return g_variant_new ("(a(usis))", &builder);
+}
+
+static GVariant *
+run_get_scrollback (tilda_window *window, GVariant *parameters, GError **error)
+{
+    GtkAdjustment *adjustment;
+    tilda_term *tt;
+    GVariant *result;
+    gchar *text;
+    glong first_row;
+    glong cursor_row;
+    guint tab;
+    guint lines;
+
+    g_variant_get (parameters, "(uu)", &tab, &lines);
+
+    tt = find_tab (window, tab, error);
+
+    if (tt == NULL) {
+        return NULL;
+    }
+
+    adjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (tt->vte_term));
+    first_row = (glong) gtk_adjustment_get_lower (adjustment);
+    vte_terminal_get_cursor_position (VTE_TERMINAL (tt->vte_term), NULL, &cursor_row);
+
+    if (lines > 0) {
+        first_row = MAX (first_row, cursor_row + 1 - (glong) lines);
+    }
+
+    text = tilda_terminal_get_rows_text (tt, first_row, cursor_row + 1);
+    result = g_variant_new ("(s)", text != NULL ? text : "");
+    g_free (text);
+
+    return result;
+}
+
+static GVariant *
+run_search (tilda_window *window, GVariant *parameters, GError **error)
+{
+    const gchar *pattern;
+    VteRegex *regex;
+    tilda_term *tt;
+    gboolean backward;
+    gboolean found;
+    guint tab;
+
+    g_variant_get (parameters, "(u&sb)", &tab, &pattern, &backward);
+
+    tt = find_tab (window, tab, error);
+
+    if (tt == NULL) {
+        return NULL;
+    }
+
+    regex = tilda_regex_cache_get_vte_regex (tilda_regex_cache_get_default (),
+                                             pattern, TRUE, TRUE, error);
+
+    if (regex == NULL) {
+        return NULL;
+    }
+
+    found = tilda_terminal_search (tt, regex, backward, TRUE);
+    vte_regex_unref (regex);
+
+    return g_variant_new ("(b)", found);
+}
+
+static GVariant *
+run_get_metrics (tilda_window *window,
+                 G_GNUC_UNUSED GVariant *parameters,
+                 G_GNUC_UNUSED GError **error)
+{
+    return g_variant_new ("(@a{sv})", tilda_metrics_collect (window));
+}
+
+typedef GVariant * (*TildaDbusOperationFunc) (tilda_window *window,
+                                              GVariant *parameters,
+                                              GError **error);
+
+static const struct {
+    const gchar *name;
+    const gchar *parameters_type;
+    TildaDbusOperationFunc run;
+} operations[] = {
+    { "NewTab", "(ss)", run_new_tab },
+    { "CloseTab", "(u)", run_close_tab },
+    { "FocusTab", "(u)", run_focus_tab },
+    { "SendText", "(us)", run_send_text },
+    { "PasteClipboard", "(u)", run_paste_clipboard },
+    { "ListTabs", "()", run_list_tabs },
+    { "GetScrollback", "(uu)", run_get_scrollback },
+    { "Search", "(usb)", run_search },
+    { "GetMetrics", "()", run_get_metrics }
+};
+
+static GVariant *
+run_operation (tilda_window *window,
+               const gchar *name,
+               GVariant *parameters,
+               GError **error)
+{
+    for (guint i = 0; i < G_N_ELEMENTS (operations); i++)
+    {
+        if (g_strcmp0 (operations[i].name, name) != 0) {
+            continue;
+        }
+
+        if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE (operations[i].parameters_type))) {
+            g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                         "The parameters of %s must be of type %s, not %s",
+                         name, operations[i].parameters_type,
+                         g_variant_get_type_string (parameters));
+            return NULL;
+        }
+
+        return operations[i].run (window, parameters, error);
+    }
+
+    g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD,
+                 "Unknown operation %s", name);
+
+    return NULL;
+}
+
+/* Runs the operation with the name of the invoked method */
+static gboolean
+handle_operation (GDBusMethodInvocation *invocation, tilda_window *window)
+{
+    GError *error = NULL;
+    GVariant *result;
+
+    result = run_operation (window,
+                            g_dbus_method_invocation_get_method_name (invocation),
+                            g_dbus_method_invocation_get_parameters (invocation),
+                            &error);
+
+    if (result == NULL) {
+        g_dbus_method_invocation_take_error (invocation, error);
+    } else {
+        g_dbus_method_invocation_return_value (invocation, result);
+    }
+
+    return GDK_EVENT_STOP;
+}
+
+static gboolean
+on_handle_new_tab (G_GNUC_UNUSED TildaDbusActions *skeleton,
+                   GDBusMethodInvocation *invocation,
+                   G_GNUC_UNUSED const gchar *cwd,
+                   G_GNUC_UNUSED const gchar *command,
+                   gpointer user_data)
+{
+    return handle_operation (invocation, user_data);
+}
+
+static gboolean
+on_handle_close_tab (G_GNUC_UNUSED TildaDbusActions *skeleton,
+                     GDBusMethodInvocation *invocation,
+                     G_GNUC_UNUSED guint tab,
+                     gpointer user_data)
+{
+    return handle_operation (invocation, user_data);
+}
+
+static gboolean
+on_handle_focus_tab (G_GNUC_UNUSED TildaDbusActions *skeleton,
+                     GDBusMethodInvocation *invocation,
+                     G_GNUC_UNUSED guint tab,
+                     gpointer user_data)
+{
+    return handle_operation (invocation, user_data);
+}
+
+static gboolean
+on_handle_send_text (G_GNUC_UNUSED TildaDbusActions *skeleton,
+                     GDBusMethodInvocation *invocation,
+                     G_GNUC_UNUSED guint tab,
+                     G_GNUC_UNUSED const gchar *text,
+                     gpointer user_data)
+{
+    return handle_operation (invocation, user_data);
+}
+
+static gboolean
+on_handle_paste_clipboard (G_GNUC_UNUSED TildaDbusActions *skeleton,
+                           GDBusMethodInvocation *invocation,
+                           G_GNUC_UNUSED guint tab,
+                           gpointer user_data)
+{
+    return handle_operation (invocation, user_data);
+}
+
+static gboolean
+on_handle_list_tabs (G_GNUC_UNUSED TildaDbusActions *skeleton,
+                     GDBusMethodInvocation *invocation,
+                     gpointer user_data)
+{
+    return handle_operation (invocation, user_data);
+}
+
+static gboolean
+on_handle_get_scrollback (G_GNUC_UNUSED TildaDbusActions *skeleton,
+                          GDBusMethodInvocation *invocation,
+                          G_GNUC_UNUSED guint tab,
+                          G_GNUC_UNUSED guint lines,
+                          gpointer user_data)
+{
+    return handle_operation (invocation, user_data);
+}
+
+static gboolean
+on_handle_search (G_GNUC_UNUSED TildaDbusActions *skeleton,
+                  GDBusMethodInvocation *invocation,
+                  G_GNUC_UNUSED guint tab,
+                  G_GNUC_UNUSED const gchar *pattern,
+                  G_GNUC_UNUSED gboolean backward,
+                  gpointer user_data)
+{
+    return handle_operation (invocation, user_data);
+}
+
+static gboolean
+on_handle_get_metrics (G_GNUC_UNUSED TildaDbusActions *skeleton,
+                       GDBusMethodInvocation *invocation,
+                       gpointer user_data)
+{
+    return handle_operation (invocation, user_data);
+}
+
+/* Runs all operations in this main loop iteration and returns their
+ * results. The batch stops at the first operation that fails, the
+ * operations before it have taken effect. */
+static gboolean
+on_handle_batch (TildaDbusActions *skeleton,
+                 GDBusMethodInvocation *invocation,
+                 GVariant *batch,
+                 gpointer user_data)
+{
+    GVariantBuilder results;
+    GVariantIter iter;
+    const gchar *name;
+    GVariant *parameters;
+    guint index = 0;
+
+    g_variant_builder_init (&results, G_VARIANT_TYPE ("av"));
+    g_variant_iter_init (&iter, batch);
+
+    while (g_variant_iter_next (&iter, "(&sv)", &name, &parameters))
+    {
+        GError *error = NULL;
+        GVariant *result;
+
+        result = run_operation (user_data, name, parameters, &error);
+
+        if (result == NULL) {
+            g_prefix_error (&error, "Operation %u (%s) failed: ", index, name);
+            g_dbus_method_invocation_take_error (invocation, error);
+            g_variant_builder_clear (&results);
+            g_variant_unref (parameters);
+            return GDK_EVENT_STOP;
+        }
+
+        g_variant_builder_add (&results, "v", result);
+        g_variant_unref (parameters);
+        index++;
+    }
+
+    tilda_dbus_actions_complete_batch (skeleton, invocation, g_variant_builder_end (&results));
+
+    return GDK_EVENT_STOP;
+}
+
+typedef struct
+{
+    TildaDbusActions *skeleton;
+    GDBusMethodInvocation *invocation;
+} TildaDbusPendingCall;
+
+static void
+save_scrollback_done_cb (G_GNUC_UNUSED GObject *source_object,
+                         GAsyncResult *result,
+                         gpointer user_data)
+{
+    TildaDbusPendingCall *call = user_data;
+    GError *error = NULL;
+    guint64 bytes;
+
+    if (tilda_scrollback_save_finish (result, &bytes, &error)) {
+        tilda_dbus_actions_complete_save_scrollback (call->skeleton, call->invocation, bytes);
+    } else {
+        g_dbus_method_invocation_take_error (call->invocation, error);
+    }
+
+    g_object_unref (call->skeleton);
+    g_free (call);
+}
+
+static gboolean
+on_handle_save_scrollback (TildaDbusActions *skeleton,
+                           GDBusMethodInvocation *invocation,
+                           guint tab,
+                           const gchar *path,
+                           gboolean compress,
+                           gpointer user_data)
+{
+    tilda_term *tt;
+
+    tt = lookup_tab (user_data, tab, invocation);
+
+    if (tt == NULL) {
+        return GDK_EVENT_STOP;
+    }
+
+    if (!g_path_is_absolute (path)) {
+        g_dbus_method_invocation_return_error (invocation,
+                                               G_DBUS_ERROR,
+                                               G_DBUS_ERROR_INVALID_ARGS,
+                                               "The path must be absolute");
+        return GDK_EVENT_STOP;
+    }
+
+    TildaDbusPendingCall *call = g_new (TildaDbusPendingCall, 1);
+    call->skeleton = g_object_ref (skeleton);
+    call->invocation = invocation;
+
+    tilda_scrollback_save_async (tt, path, compress, NULL, NULL, NULL,
+                                 save_scrollback_done_cb, call);
+
+    return GDK_EVENT_STOP;
+}
+
+static gboolean
+on_handle_start_trace (TildaDbusActions *skeleton,
+                       GDBusMethodInvocation *invocation,
+                       G_GNUC_UNUSED gpointer user_data)
+{
+    tilda_trace_start ();
+
+    tilda_dbus_actions_complete_start_trace (skeleton, invocation);
+
+    return GDK_EVENT_STOP;
+}
+
+static gboolean
+on_handle_stop_trace (TildaDbusActions *skeleton,
+                      GDBusMethodInvocation *invocation,
+                      const gchar *name,
+                      G_GNUC_UNUSED gpointer user_data)
+{
+    GError *error = NULL;
+    gchar *path;
+    guint events;
+
+    /* The trace can only be written to the cache directory of tilda, so
+     * that the method cannot be used to overwrite other files of the user */
+    if (tilda_trace_stop (name[0] != '\0' ? name : NULL, &path, &events, &error)) {
+        tilda_dbus_actions_complete_stop_trace (skeleton, invocation, path, events);
+        g_free (path);
+    } else {
+        g_dbus_method_invocation_take_error (invocation, error);
+    }
+
+    return GDK_EVENT_STOP;
+}
+
+static gboolean
+on_handle_add_output_watcher (TildaDbusActions *skeleton,
+                              GDBusMethodInvocation *invocation,
+                              guint tab,
+                              const gchar *pattern,
+                              const gchar * const *action_names,
+                              gpointer user_data)
+{
+    GError *error = NULL;
+    tilda_term *tt;
+    guint actions;
+    guint id;
+
+    tt = lookup_tab (user_data, tab, invocation);
+
+    if (tt == NULL) {
+        return GDK_EVENT_STOP;
+    }
+
+    if (!tilda_watch_parse_actions (action_names, &actions, &error)
+        || (id = tilda_watch_add (tt, pattern, actions, &error)) == 0)
+    {
+        g_dbus_method_invocation_return_error (invocation,
+                                               G_DBUS_ERROR,
+                                               G_DBUS_ERROR_INVALID_ARGS,
+                                               "%s", error->message);
+        g_error_free (error);
+        return GDK_EVENT_STOP;
+    }
+
+    tilda_dbus_actions_complete_add_output_watcher (skeleton, invocation, id);
+
+    return GDK_EVENT_STOP;
+}
+
+static gboolean
+on_handle_remove_output_watcher (TildaDbusActions *skeleton,
+                                 GDBusMethodInvocation *invocation,
+                                 guint tab,
+                                 guint id,
+                                 gpointer user_data)
+{
+    tilda_term *tt;
+
+    tt = lookup_tab (user_data, tab, invocation);
+
+    if (tt == NULL) {
+        return GDK_EVENT_STOP;
+    }
+
+    if (!tilda_watch_remove (tt, id)) {
+        g_dbus_method_invocation_return_error (invocation,
+                                               G_DBUS_ERROR,
+                                               G_DBUS_ERROR_INVALID_ARGS,
+                                               "There is no output watcher with the id %u", id);
+        return GDK_EVENT_STOP;
+    }
+
+    tilda_dbus_actions_complete_remove_output_watcher (skeleton, invocation);
+
+    return GDK_EVENT_STOP;
+}
+
+static gboolean
+on_handle_set_tab_monitoring (TildaDbusActions *skeleton,
+                              GDBusMethodInvocation *invocation,
+                              guint tab,
+                              gboolean activity,
+                              guint silence,
+                              gpointer user_data)
+{
+    tilda_term *tt;
+
+    tt = lookup_tab (user_data, tab, invocation);
+
+    if (tt == NULL) {
+        return GDK_EVENT_STOP;
+    }
+
+    tilda_activity_set_monitoring (tt, activity, silence);
+
+    tilda_dbus_actions_complete_set_tab_monitoring (skeleton, invocation);
+
+    return GDK_EVENT_STOP;
+}
+
 static void
 on_name_acquired (GDBusConnection *connection,
                   const gchar *name,
@@ -50,6 +770,40 @@ on_name_acquired (GDBusConnection *connection,
     actions = tilda_dbus_actions_skeleton_new ();
 
     g_signal_connect (actions, "handle-toggle",G_CALLBACK (on_handle_toggle), window);
+    g_signal_connect (actions, "handle-get-tab-resources",
+                      G_CALLBACK (on_handle_get_tab_resources), window);
+    g_signal_connect (actions, "handle-save-scrollback",
+                      G_CALLBACK (on_handle_save_scrollback), window);
+    g_signal_connect (actions, "handle-add-output-watcher",
+                      G_CALLBACK (on_handle_add_output_watcher), window);
+    g_signal_connect (actions, "handle-remove-output-watcher",
+                      G_CALLBACK (on_handle_remove_output_watcher), window);
+    g_signal_connect (actions, "handle-set-tab-monitoring",
+                      G_CALLBACK (on_handle_set_tab_monitoring), window);
+    g_signal_connect (actions, "handle-start-trace",
+                      G_CALLBACK (on_handle_start_trace), window);
+    g_signal_connect (actions, "handle-stop-trace",
+                      G_CALLBACK (on_handle_stop_trace), window);
+    g_signal_connect (actions, "handle-new-tab",
+                      G_CALLBACK (on_handle_new_tab), window);
+    g_signal_connect (actions, "handle-close-tab",
+                      G_CALLBACK (on_handle_close_tab), window);
+    g_signal_connect (actions, "handle-focus-tab",
+                      G_CALLBACK (on_handle_focus_tab), window);
+    g_signal_connect (actions, "handle-send-text",
+                      G_CALLBACK (on_handle_send_text), window);
+    g_signal_connect (actions, "handle-paste-clipboard",
+                      G_CALLBACK (on_handle_paste_clipboard), window);
+    g_signal_connect (actions, "handle-list-tabs",
+                      G_CALLBACK (on_handle_list_tabs), window);
+    g_signal_connect (actions, "handle-get-scrollback",
+                      G_CALLBACK (on_handle_get_scrollback), window);
+    g_signal_connect (actions, "handle-search",
+                      G_CALLBACK (on_handle_search), window);
+    g_signal_connect (actions, "handle-get-metrics",
+                      G_CALLBACK (on_handle_get_metrics), window);
+    g_signal_connect (actions, "handle-batch",
+                      G_CALLBACK (on_handle_batch), window);
 
     path = tilda_dbus_actions_get_object_path (tw);
 
@@ -64,6 +818,8 @@ on_name_acquired (GDBusConnection *connection,
                  TILDA_DBUS_ACTIONS_OBJECT_PATH, error->message);
     }
 
+    tw->dbus_actions = G_DBUS_INTERFACE_SKELETON (actions);
+
     g_free (path);
 }
 
@@ -123,12 +879,183 @@ void tilda_dbus_actions_toggle (gint instance_id)
     g_object_unref (conn);
 }
 
+gboolean tilda_dbus_actions_print_metrics (gint instance_id)
+{
+    GDBusConnection *conn = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, NULL);
+
+    GError * error = NULL;
+
+    if (!conn)
+    {
+        return FALSE;
+    }
+
+    gchar * name = tilda_dbus_actions_get_bus_name_for_instance (instance_id);
+    gchar * path = tilda_dbus_actions_get_object_path_for_instance (instance_id);
+
+    GVariant * result;
+
+    result = g_dbus_connection_call_sync (conn, name, path,
+                                          "com.github.lanoxx.tilda.Actions", "GetMetrics",
+                                          NULL, G_VARIANT_TYPE ("(a{sv})"), G_DBUS_CALL_FLAGS_NONE,
+                                          -1, NULL, &error);
+
+    if (error != NULL)
+    {
+        g_printerr ("Failed to get the metrics of instance %d: %s\n",
+                    instance_id, error->message);
+        g_error_free (error);
+    } else {
+        GVariant *metrics = g_variant_get_child_value (result, 0);
+
+        tilda_metrics_print (metrics);
+
+        g_variant_unref (metrics);
+        g_variant_unref (result);
+    }
+
+    g_free (name);
+    g_free (path);
+
+    g_object_unref (conn);
+
+    return error == NULL;
+}
+
 gchar *
 tilda_dbus_actions_get_bus_name (tilda_window *window)
 {
     return tilda_dbus_actions_get_bus_name_for_instance (window->instance);
 }
 
+void
+tilda_dbus_actions_notify_tab_created (tilda_window *window, guint tab)
+{
+    if (window->dbus_actions == NULL) {
+        return;
+    }
+
+    tilda_dbus_actions_emit_tab_created (TILDA_DBUS_ACTIONS (window->dbus_actions), tab);
+}
+
+void
+tilda_dbus_actions_notify_tab_closed (tilda_window *window, guint tab)
+{
+    if (window->dbus_actions == NULL) {
+        return;
+    }
+
+    if (window->dbus_pending_titles != NULL) {
+        g_hash_table_remove (window->dbus_pending_titles, GUINT_TO_POINTER (tab));
+    }
+
+    tilda_dbus_actions_emit_tab_closed (TILDA_DBUS_ACTIONS (window->dbus_actions), tab);
+}
+
+/* Emits the latest title of each tab whose title changed since the last
+ * run. The timer keeps running for one more interval after it emitted
+ * something, so that no tab emits twice within an interval. */
+static gboolean
+emit_titles_cb (gpointer user_data)
+{
+    tilda_window *window = user_data;
+    guint emitted = 0;
+
+    for (GList *item = window->terms; item != NULL; item = item->next)
+    {
+        tilda_term *tt = item->data;
+        gchar *title;
+
+        if (!g_hash_table_remove (window->dbus_pending_titles, GUINT_TO_POINTER (tt->id))) {
+            continue;
+        }
+
+        title = tilda_terminal_get_title (tt);
+        tilda_dbus_actions_emit_tab_title_changed (TILDA_DBUS_ACTIONS (window->dbus_actions),
+                                                   tt->id, title != NULL ? title : "");
+        g_free (title);
+
+        emitted++;
+    }
+
+    if (emitted > 0) {
+        return G_SOURCE_CONTINUE;
+    }
+
+    window->dbus_title_source = 0;
+
+    return G_SOURCE_REMOVE;
+}
+
+void
+tilda_dbus_actions_notify_title_changed (tilda_window *window, guint tab)
+{
+    if (window->dbus_actions == NULL) {
+        return;
+    }
+
+    if (window->dbus_pending_titles == NULL) {
+        window->dbus_pending_titles = g_hash_table_new (NULL, NULL);
+    }
+
+    g_hash_table_add (window->dbus_pending_titles, GUINT_TO_POINTER (tab));
+
+    if (window->dbus_title_source == 0) {
+        window->dbus_title_source = g_timeout_add ((guint) MAX (config_getint ("dbus_title_interval"), 1),
+                                                   emit_titles_cb, window);
+    }
+}
+
+void
+tilda_dbus_actions_notify_process_exited (tilda_window *window, guint tab, gint status)
+{
+    if (window->dbus_actions == NULL) {
+        return;
+    }
+
+    tilda_dbus_actions_emit_process_exited (TILDA_DBUS_ACTIONS (window->dbus_actions), tab, status);
+}
+
+void
+tilda_dbus_actions_notify_visibility_changed (tilda_window *window, gboolean visible)
+{
+    if (window->dbus_actions == NULL) {
+        return;
+    }
+
+    tilda_dbus_actions_emit_visibility_changed (TILDA_DBUS_ACTIONS (window->dbus_actions), visible);
+}
+
+void
+tilda_dbus_actions_notify_tab_state (tilda_window *window,
+                                     guint tab,
+                                     const gchar *state)
+{
+    if (window->dbus_actions == NULL) {
+        return;
+    }
+
+    tilda_dbus_actions_emit_tab_state_changed (TILDA_DBUS_ACTIONS (window->dbus_actions),
+                                               tab, state);
+}
+
+void
+tilda_dbus_actions_unexport (tilda_window *window)
+{
+    if (window->dbus_title_source) {
+        g_source_remove (window->dbus_title_source);
+        window->dbus_title_source = 0;
+    }
+
+    g_clear_pointer (&window->dbus_pending_titles, g_hash_table_destroy);
+    stop_switch_timing (window);
+
+    if (window->dbus_actions != NULL) {
+        g_dbus_interface_skeleton_unexport (window->dbus_actions);
+        g_clear_object (&window->dbus_actions);
+    }
+}
+
 void
 tilda_dbus_actions_finish (guint bus_identifier)
 {
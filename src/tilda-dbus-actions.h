@@ -7,8 +7,36 @@ guint  tilda_dbus_actions_init (tilda_window *window);
 
 void tilda_dbus_actions_toggle(gint instance_id);
 
+/* Prints the metrics of a running instance, returns FALSE on failure */
+gboolean tilda_dbus_actions_print_metrics (gint instance_id);
+
 gchar *tilda_dbus_actions_get_bus_name (tilda_window *window);
 
+/* The functions below emit the signals of the D-Bus interface. They do
+ * nothing if the interface is not exported. */
+
+void   tilda_dbus_actions_notify_tab_created (tilda_window *window, guint tab);
+
+void   tilda_dbus_actions_notify_tab_closed (tilda_window *window, guint tab);
+
+/* Title changes are coalesced and emitted at most once per
+ * dbus_title_interval milliseconds and tab. */
+void   tilda_dbus_actions_notify_title_changed (tilda_window *window, guint tab);
+
+void   tilda_dbus_actions_notify_process_exited (tilda_window *window,
+                                                 guint tab,
+                                                 gint status);
+
+void   tilda_dbus_actions_notify_visibility_changed (tilda_window *window,
+                                                     gboolean visible);
+
+void   tilda_dbus_actions_notify_tab_state (tilda_window *window,
+                                            guint tab,
+                                            const gchar *state);
+
+/* Stops emitting signals and removes the interface from the bus */
+void   tilda_dbus_actions_unexport (tilda_window *window);
+
 void   tilda_dbus_actions_finish (guint bus_identifier);
 
 #endif
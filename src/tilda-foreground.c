@@ -0,0 +1,219 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilda-foreground.h"
+
+#include "debug.h"
+#include "tilda-recorder.h"
+
+#include <glib.h>
+#include <gtk/gtk.h>
+#include <unistd.h>
+#include <vte/vte.h>
+
+/* The interval in milliseconds in which queued terminals are updated */
+#define TILDA_FOREGROUND_UPDATE_INTERVAL 1000
+
+/* The style class of the tab label of a busy terminal, it can be used
+ * to style busy tabs in the style.css file. */
+#define TILDA_FOREGROUND_BUSY_STYLE_CLASS "busy"
+
+/* The terminals that need to be updated by the next timer tick */
+static GHashTable *queued_terms = NULL;
+static guint update_source = 0;
+
+static gchar *
+read_process_name (GPid pid)
+{
+    gchar *file;
+    gchar *name = NULL;
+
+    file = g_strdup_printf ("/proc/%d/comm", pid);
+
+    if (g_file_get_contents (file, &name, NULL, NULL)) {
+        g_strchomp (name);
+    }
+
+    g_free (file);
+
+    return name;
+}
+
+/* Returns TRUE if the foreground process group of the terminal changed */
+static gboolean
+update_foreground (tilda_term *tt)
+{
+    VtePty *pty;
+    GPid pgrp = -1;
+
+    pty = tilda_recorder_get_child_pty (tt);
+
+    if (pty != NULL && tt->pid > 0) {
+        pgrp = tcgetpgrp (vte_pty_get_fd (pty));
+    }
+
+    if (pgrp <= 0) {
+        pgrp = -1;
+    }
+
+    if (pgrp == tt->foreground_pid) {
+        return FALSE;
+    }
+
+    tt->foreground_pid = pgrp;
+    tt->busy = pgrp != -1 && pgrp != tt->pid;
+
+    g_free (tt->foreground_name);
+    tt->foreground_name = pgrp != -1 ? read_process_name (pgrp) : NULL;
+
+    return TRUE;
+}
+
+/* Returns TRUE if the working directory for the title changed */
+static gboolean
+update_title_cwd (tilda_term *tt)
+{
+    gchar *cwd;
+
+    /* The directory reported by the shell is used directly */
+    if (tt->cwd != NULL) {
+        return FALSE;
+    }
+
+    cwd = tilda_term_get_cwd (tt);
+
+    if (g_strcmp0 (cwd, tt->title_cwd) == 0) {
+        g_free (cwd);
+        return FALSE;
+    }
+
+    g_free (tt->title_cwd);
+    tt->title_cwd = cwd;
+
+    return TRUE;
+}
+
+static void
+show_foreground (tilda_term *tt)
+{
+    GtkWidget *label;
+    GtkStyleContext *context;
+
+    label = gtk_notebook_get_tab_label (GTK_NOTEBOOK (tt->tw->notebook), tt->hbox);
+
+    if (label != NULL) {
+        context = gtk_widget_get_style_context (label);
+
+        if (tt->busy) {
+            gtk_style_context_add_class (context, TILDA_FOREGROUND_BUSY_STYLE_CLASS);
+        } else {
+            gtk_style_context_remove_class (context, TILDA_FOREGROUND_BUSY_STYLE_CLASS);
+        }
+    }
+
+    /* The title may contain the name of the foreground process */
+    tilda_terminal_update_title (tt);
+}
+
+static gboolean
+update_queued_terms_cb (G_GNUC_UNUSED gpointer user_data)
+{
+    DEBUG_FUNCTION ("update_queued_terms_cb");
+
+    GHashTableIter iter;
+    gpointer key;
+
+    g_hash_table_iter_init (&iter, queued_terms);
+
+    while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+        tilda_term *tt = key;
+        gboolean changed;
+
+        g_hash_table_iter_remove (&iter);
+
+        changed = update_foreground (tt);
+        changed = update_title_cwd (tt) || changed;
+
+        if (changed) {
+            show_foreground (tt);
+        }
+    }
+
+    update_source = 0;
+
+    return G_SOURCE_REMOVE;
+}
+
+void
+tilda_foreground_queue_update (tilda_term *tt)
+{
+    if (queued_terms == NULL) {
+        queued_terms = g_hash_table_new (NULL, NULL);
+    }
+
+    g_hash_table_add (queued_terms, tt);
+
+    if (update_source == 0) {
+        update_source = g_timeout_add (TILDA_FOREGROUND_UPDATE_INTERVAL,
+                                       update_queued_terms_cb, NULL);
+    }
+}
+
+void
+tilda_foreground_forget (tilda_term *tt)
+{
+    if (queued_terms == NULL) {
+        return;
+    }
+
+    g_hash_table_remove (queued_terms, tt);
+
+    if (g_hash_table_size (queued_terms) == 0 && update_source != 0) {
+        g_source_remove (update_source);
+        update_source = 0;
+    }
+}
+
+gboolean
+tilda_foreground_is_busy (tilda_term *tt)
+{
+    DEBUG_FUNCTION ("tilda_foreground_is_busy");
+    DEBUG_ASSERT (tt != NULL);
+
+    if (update_foreground (tt)) {
+        show_foreground (tt);
+    }
+
+    return tt->busy;
+}
+
+guint
+tilda_foreground_count_busy (tilda_window *tw)
+{
+    DEBUG_FUNCTION ("tilda_foreground_count_busy");
+    DEBUG_ASSERT (tw != NULL);
+
+    guint count = 0;
+
+    for (GList *item = tw->terms; item != NULL; item = item->next)
+    {
+        if (tilda_foreground_is_busy (item->data)) {
+            count++;
+        }
+    }
+
+    return count;
+}
@@ -0,0 +1,61 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILDA_FOREGROUND_H
+#define TILDA_FOREGROUND_H
+
+#include "tilda_window.h"
+#include "tilda_terminal.h"
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Tracks which process group is in the foreground of each terminal.
+ *
+ * A terminal is busy if a process other than its shell is in the
+ * foreground. Terminals are not polled, instead a terminal is queued for an
+ * update whenever its content changes or its child exits. All queued
+ * terminals are updated together by a single low frequency timer, which
+ * only runs while there are queued terminals.
+ */
+
+/**
+ * Queues the terminal for an update of its foreground process.
+ */
+void tilda_foreground_queue_update (tilda_term *tt);
+
+/**
+ * Removes the terminal from the update queue. Must be called before the
+ * terminal is freed.
+ */
+void tilda_foreground_forget (tilda_term *tt);
+
+/**
+ * Updates the foreground process of the terminal immediately and returns
+ * whether a process other than the shell is running in the foreground.
+ */
+gboolean tilda_foreground_is_busy (tilda_term *tt);
+
+/**
+ * Returns the number of terminals of the tilda window which have a process
+ * other than the shell running in the foreground.
+ */
+guint tilda_foreground_count_busy (tilda_window *tw);
+
+G_END_DECLS
+
+#endif /* TILDA_FOREGROUND_H */
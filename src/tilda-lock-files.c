@@ -13,10 +13,13 @@
  * License along with this library. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define _POSIX_C_SOURCE 200809L /* feature test macro for O_CLOEXEC */
+
 #include "tilda-lock-files.h"
 
 #include "debug.h"
 
+#include <errno.h>
 #include <fcntl.h>
 #include <glib.h>
 #include <glib/gi18n.h>
@@ -27,16 +30,11 @@
 
 static gchar *create_lock_file (struct lock_info *lock);
 static struct lock_info *islockfile (const gchar *filename);
-static GSList *getPids();
-static gint remove_stale_lock_files (void);
-static gint get_instance_number (void);
+static gint scan_lock_directory (void);
 
 gboolean
 tilda_lock_files_obtain_instance_lock (struct lock_info * lock_info)
 {
-    /* Remove stale lock files */
-    remove_stale_lock_files ();
-
     /* The global lock file is used to synchronize the start-up of multiple simultaneously starting tilda processes.
      * The processes will synchronize on a lock file named lock_0_0, such that the part of determining the instance
      * number and creating the per process lock file (lock_<pid>_<instance>) is atomic. Without this it could
@@ -52,6 +50,7 @@ tilda_lock_files_obtain_instance_lock (struct lock_info * lock_info)
     global_lock.instance = 0;
     global_lock.pid = 0;
     gchar *global_lock_file = NULL;
+    gboolean obtained = FALSE;
 
     global_lock_file = create_lock_file(&global_lock);
 
@@ -64,33 +63,51 @@ tilda_lock_files_obtain_instance_lock (struct lock_info * lock_info)
 
     if (lockResult == -1) {
         perror("Could not acquire global tilda lock file lock.");
-        return FALSE;
+        goto out;
     }
 
     /* Start of atomic section. */
     lock_info->pid = getpid ();
-    lock_info->instance = get_instance_number ();
+    lock_info->instance = scan_lock_directory ();
     lock_info->lock_file = create_lock_file (lock_info);
+
+    /* Every running instance holds an exclusive lock on its own lock file
+     * until it exits, which is how other instances tell that it is alive. */
+    if (lock_info->lock_file == NULL) {
+        perror("Error creating instance lock file.");
+    } else if (flock(lock_info->file_descriptor, LOCK_EX | LOCK_NB) == -1) {
+        perror("Could not acquire instance lock file lock.");
+        tilda_lock_files_free (lock_info);
+    } else {
+        obtained = TRUE;
+    }
     /* End of atomic section */
 
     flock(global_lock.file_descriptor, LOCK_UN);
-    close(lock_info->file_descriptor);
 
+out:
+    close(global_lock.file_descriptor);
     g_free(global_lock_file);
 
-    return TRUE;
+    return obtained;
 }
 
 void tilda_lock_files_free (struct lock_info * lock_info)
 {
+    /* Remove the file before the lock is released by closing it, such that
+     * no other instance can see it as a stale lock file in between. */
     remove (lock_info->lock_file);
+    close (lock_info->file_descriptor);
     g_free (lock_info->lock_file);
     lock_info->lock_file = NULL;
+    lock_info->file_descriptor = -1;
 }
 
 /**
 * If lock->pid is 0 then the file is not opened exclusively. Instead flock() must be used to obtain a lock.
-* Otherwise an exclusive lock file is created for the process.
+* Otherwise an exclusive lock file is created for the process. The file is
+* opened with O_CLOEXEC, such that the lock is not inherited by the shells
+* that tilda spawns and goes away together with the tilda process.
 */
 static gchar *create_lock_file (struct lock_info *lock)
 {
@@ -115,9 +132,9 @@ static gchar *create_lock_file (struct lock_info *lock)
 
     /* Create the lock file */
     if(lock->pid == 0) {
-        ret = open(lock_file_full, O_CREAT, S_IRUSR | S_IWUSR);
+        ret = open(lock_file_full, O_RDONLY | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
     } else {
-        ret = open(lock_file_full, O_WRONLY | O_CREAT | O_EXCL, 0);
+        ret = open(lock_file_full, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, S_IRUSR | S_IWUSR);
     }
 
     if (ret == -1)
@@ -212,116 +229,30 @@ static struct lock_info *islockfile (const gchar *filename)
 }
 
 /**
-* Gets a list of the pids in
-*/
-static GSList *getPids() {
-    GSList *pids = NULL;
-    FILE *ps_output;
-    const gchar ps_command[] = "ps -C tilda -o pid=";
-    gchar buf[16]; /* Really shouldn't need more than 6 */
-
-    if ((ps_output = popen (ps_command, "r")) == NULL) {
-        g_printerr (_("Unable to run command: `%s'\n"), ps_command);
-        return NULL;
-    }
-
-    /* The popen() succeeded, get all of the pids */
-    while (fgets (buf, sizeof(buf), ps_output) != NULL)
-        pids = g_slist_append (pids, GINT_TO_POINTER (atoi (buf)));
-
-    /* We've read all of the pids, exit */
-    pclose (ps_output);
-    return pids;
-}
-
-/**
- * Remove stale lock files from the ~/.tilda/locks/ directory.
+ * scan_lock_directory ()
  *
- * Success: returns 0
- * Failure: returns non-zero
- */
-static gint remove_stale_lock_files (void)
-{
-    DEBUG_FUNCTION ("remove_stale_lock_files");
-
-    GSList *pids = getPids();
-    if(pids == NULL) {
-        return -1;
-    }
-
-    struct lock_info *lock;
-    gchar *lock_dir = g_build_filename (g_get_user_cache_dir (), "tilda", "locks", NULL);
-    gchar *remove_file;
-    gchar *filename;
-    GDir *dir;
-
-    /* if the lock dir does not exist then there are no stale lock files to remove. */
-    if (!g_file_test (lock_dir, G_FILE_TEST_EXISTS)) {
-        g_free (lock_dir);
-        return 0;
-    }
-
-    /* Open the lock directory for reading */
-    dir = g_dir_open (lock_dir, 0, NULL);
-
-    if (dir == NULL)
-    {
-        g_printerr (_("Unable to open lock directory: %s\n"), lock_dir);
-        g_free (lock_dir);
-        return -2;
-    }
-
-    /* For each possible lock file, check if it is a lock, and see if
-     * it matches one of the running tildas */
-    while ((filename = (gchar*) g_dir_read_name (dir)) != NULL)
-    {
-        lock = islockfile (filename);
-
-        if (lock && (g_slist_find (pids, GINT_TO_POINTER (lock->pid)) == NULL))
-        {
-            /* We have found a stale element */
-            remove_file = g_build_filename (lock_dir, filename, NULL);
-            remove (remove_file);
-            g_free (remove_file);
-        }
-
-        if (lock)
-            g_free (lock);
-    }
-
-    g_dir_close (dir);
-    g_free (lock_dir);
-    g_slist_free(pids);
-
-    return 0;
-}
-
-static gint _cmp_locks(gconstpointer a, gconstpointer b, gpointer userdata) {
-    return GPOINTER_TO_INT (a) - GPOINTER_TO_INT (b);
-}
-
-/**
- * get_instance_number ()
- *
- * Gets the next available tilda instance number. This will always pick the
- * lowest non-running tilda available.
+ * Removes stale lock files and gets the next available tilda instance number
+ * in a single pass over the lock directory. A lock file is stale if its lock
+ * can be obtained, because a running instance holds the lock on its lock file
+ * until it exits. This does not depend on the pid in the file name, which may
+ * have been reused by another process. Must be called with the global lock
+ * held. This will always pick the lowest non-running tilda available.
  *
  * Success: return next available instance number (>=0)
  * Failure: return 0
  */
-static gint get_instance_number ()
+static gint scan_lock_directory (void)
 {
-    DEBUG_FUNCTION ("get_instance_number");
-
-    gchar *name;
+    DEBUG_FUNCTION ("scan_lock_directory");
 
-    GSequence *seq;
-    GSequenceIter *iter;
+    GHashTable *taken;
     gint lowest_lock_instance = 0;
-    gint current_lock_instance;
 
     GDir *dir;
+    gchar *name;
+    gchar *lock_file;
     struct lock_info *lock;
+    gint fd;
     gchar *lock_dir = g_build_filename (g_get_user_cache_dir (), "tilda", "locks", NULL);
 
     /* Open the lock directory */
@@ -335,35 +266,47 @@ static gint get_instance_number ()
         return 0;
     }
 
-    /* Look through every file in the lock directory, and see if it is a lock file.
-     * If it is a lock file, insert it in a sorted sequence. */
-    seq = g_sequence_new(NULL);
-    while ((name = (gchar*)g_dir_read_name (dir)) != NULL)
+    taken = g_hash_table_new (NULL, NULL);
+
+    while ((name = (gchar*) g_dir_read_name (dir)) != NULL)
     {
         lock = islockfile (name);
 
-        if (lock != NULL)
+        if (lock == NULL)
+            continue;
+
+        lock_file = g_build_filename (lock_dir, name, NULL);
+        fd = open (lock_file, O_RDONLY | O_CLOEXEC);
+
+        if (fd != -1 && flock (fd, LOCK_EX | LOCK_NB) == -1 && errno == EWOULDBLOCK)
+        {
+            /* The lock is held by a running tilda */
+            g_hash_table_add (taken, GINT_TO_POINTER (lock->instance));
+        }
+        else if (fd != -1 || errno != ENOENT)
         {
-            g_sequence_insert_sorted(seq, GINT_TO_POINTER(lock->instance), _cmp_locks, NULL);
-            g_free (lock);
+            /* We have found a stale element. Files that cannot be opened
+             * were created by older versions of tilda, which did not hold
+             * a lock on them, and are removed as well. */
+            remove (lock_file);
         }
+
+        if (fd != -1)
+            close (fd);
+
+        g_free (lock_file);
+        g_free (lock);
     }
 
     g_dir_close (dir);
     g_free (lock_dir);
 
-    /* We iterate the sorted sequence of lock instances to find the first (lowest) number *not* taken. */
-    for (iter = g_sequence_get_begin_iter(seq); !g_sequence_iter_is_end(iter); iter = g_sequence_iter_next(iter)) {
-        current_lock_instance = GPOINTER_TO_INT(g_sequence_get(iter));
-        if (lowest_lock_instance < current_lock_instance)
-            break;
-        else
-            lowest_lock_instance = current_lock_instance + 1;
-    }
+    while (g_hash_table_contains (taken, GINT_TO_POINTER (lowest_lock_instance)))
+        lowest_lock_instance++;
 
-    g_sequence_free(seq);
+    g_hash_table_destroy (taken);
 
-    DEBUG_FUNCTION_MESSAGE("get_instance_number", "assigned instance: %d", lowest_lock_instance);
+    DEBUG_FUNCTION_MESSAGE("scan_lock_directory", "assigned instance: %d", lowest_lock_instance);
 
     return lowest_lock_instance;
 }
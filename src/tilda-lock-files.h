@@ -26,8 +26,16 @@ struct lock_info
     char * lock_file;
 };
 
+/**
+ * Removes stale lock files, picks the lowest free instance number and creates
+ * the lock file of this process. The lock on the file is held until
+ * tilda_lock_files_free() is called or the process exits.
+ */
 gboolean tilda_lock_files_obtain_instance_lock (struct lock_info * lock_info);
 
+/**
+ * Removes the lock file of this process and releases its lock.
+ */
 void tilda_lock_files_free (struct lock_info * lock_info);
 
 #endif
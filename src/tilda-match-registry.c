@@ -118,6 +118,47 @@ tilda_match_registry_add (TildaMatchRegistry * registry,
     g_hash_table_insert (registry->entries, GINT_TO_POINTER (tag), entry);
 }
 
+/* The patterns are the same for every terminal, so they are compiled only
+ * once per process and every registry holds references to the same
+ * regexes. A pattern that fails to compile is NULL. */
+static VteRegex **
+get_compiled_regexes (void)
+{
+    static VteRegex * regexes[G_N_ELEMENTS (pattern_items)];
+    static gboolean compiled = FALSE;
+
+    guint32 flags = PCRE2_CASELESS | PCRE2_MULTILINE;
+
+    if (compiled) {
+        return regexes;
+    }
+
+    for (guint i = 0; i < G_N_ELEMENTS (pattern_items); i++)
+    {
+        GError * error = NULL;
+        const PatternItem * pattern_item = pattern_items + i;
+
+        regexes[i] = vte_regex_new_for_match (pattern_item->pattern,
+                                              -1,
+                                              flags,
+                                              &error);
+
+        if (error) {
+            g_critical ("Could not register match pattern for flavor %d: %s",
+                        pattern_item->flavor,
+                        error->message);
+            g_error_free (error);
+            continue;
+        }
+
+        vte_regex_jit (regexes[i], PCRE2_JIT_COMPLETE, NULL);
+    }
+
+    compiled = TRUE;
+
+    return regexes;
+}
+
 /**
  * tilda_match_registry_for_each:
  * @registry: An instance of a TildaMatchRegistry.
@@ -140,32 +181,23 @@ void tilda_match_registry_for_each (TildaMatchRegistry * registry,
                                     TildaMatchHookFunc callback,
                                     gpointer user_data)
 {
-    guint32 flags = PCRE2_CASELESS | PCRE2_MULTILINE;
+    VteRegex ** regexes = get_compiled_regexes ();
 
     for (guint i = 0; i < G_N_ELEMENTS (pattern_items); i++)
     {
-        GError * error = NULL;
         const PatternItem * pattern_item = pattern_items + i;
 
-        VteRegex * regex = vte_regex_new_for_match (pattern_item->pattern,
-                                                    -1,
-                                                    flags,
-                                                    &error);
-
-        if (error) {
-            g_critical ("Could not register match pattern for flavor %d: %s",
-                        pattern_item->flavor,
-                        error->message);
-            g_error_free (error);
+        if (regexes[i] == NULL) {
+            continue;
         }
 
-        gint tag = callback (regex, pattern_item->flavor, user_data);
+        gint tag = callback (regexes[i], pattern_item->flavor, user_data);
 
         if (tag == TILDA_MATCH_REGISTRY_IGNORE) {
             continue;
         }
 
-        tilda_match_registry_add (registry, pattern_item, regex, tag);
+        tilda_match_registry_add (registry, pattern_item, vte_regex_ref (regexes[i]), tag);
     }
 }
 
@@ -0,0 +1,246 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilda-metrics.h"
+
+#include "tilda_terminal.h"
+
+#include <gtk/gtk.h>
+#include <stdio.h>
+#include <unistd.h>
+
+typedef struct
+{
+    guint64 count;
+    guint64 sum;
+    guint64 buckets[TILDA_METRICS_BUCKETS];
+} Histogram;
+
+static const gchar *counter_names[TILDA_METRIC_COUNTER_LAST] = {
+    "title-changes",
+    "tabs-closed"
+};
+
+static const gchar *histogram_names[TILDA_METRIC_HISTOGRAM_LAST] = {
+    "pull-time",
+    "tab-creation-time",
+    "spawn-time",
+    "search-time",
+    "config-write-time",
+    "paste-frame-time",
+    "prompt-time",
+    "tab-switch-time"
+};
+
+static guint64 counters[TILDA_METRIC_COUNTER_LAST];
+static Histogram histograms[TILDA_METRIC_HISTOGRAM_LAST];
+static gint64 start_time;
+
+void
+tilda_metrics_init (void)
+{
+    start_time = g_get_monotonic_time ();
+}
+
+void
+tilda_metrics_count (TildaMetricCounter counter)
+{
+    __atomic_fetch_add (&counters[counter], 1, __ATOMIC_RELAXED);
+}
+
+void
+tilda_metrics_observe (TildaMetricHistogram histogram, gint64 usec)
+{
+    Histogram *h = &histograms[histogram];
+    guint bucket;
+
+    if (usec < 0) {
+        usec = 0;
+    }
+
+    bucket = usec == 0 ? 0 : MIN (g_bit_storage ((gulong) usec), TILDA_METRICS_BUCKETS - 1);
+
+    __atomic_fetch_add (&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&h->sum, (guint64) usec, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&h->buckets[bucket], 1, __ATOMIC_RELAXED);
+}
+
+/* Returns the resident set size of the process in bytes, or 0 */
+static guint64
+get_rss (void)
+{
+    unsigned long size;
+    unsigned long resident;
+    FILE *file;
+    int fields;
+
+    file = fopen ("/proc/self/statm", "r");
+
+    if (file == NULL) {
+        return 0;
+    }
+
+    fields = fscanf (file, "%lu %lu", &size, &resident);
+    fclose (file);
+
+    if (fields != 2) {
+        return 0;
+    }
+
+    return (guint64) resident * (guint64) sysconf (_SC_PAGESIZE);
+}
+
+static GVariant *
+get_scrollback_rows (tilda_window *tw)
+{
+    GVariantBuilder builder;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ut)"));
+
+    for (GList *item = tw->terms; item != NULL; item = item->next)
+    {
+        tilda_term *tt = item->data;
+        GtkAdjustment *adjustment;
+        gdouble rows;
+
+        adjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (tt->vte_term));
+        rows = gtk_adjustment_get_upper (adjustment) - gtk_adjustment_get_lower (adjustment);
+
+        g_variant_builder_add (&builder, "(ut)", tt->id, (guint64) MAX (rows, 0));
+    }
+
+    return g_variant_builder_end (&builder);
+}
+
+GVariant *
+tilda_metrics_collect (tilda_window *tw)
+{
+    GVariantBuilder builder;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+
+    g_variant_builder_add (&builder, "{sv}", "uptime-seconds",
+                           g_variant_new_uint64 ((guint64) (g_get_monotonic_time () - start_time)
+                                                 / G_USEC_PER_SEC));
+    g_variant_builder_add (&builder, "{sv}", "tabs",
+                           g_variant_new_uint32 (g_list_length (tw->terms)));
+    g_variant_builder_add (&builder, "{sv}", "rss-bytes", g_variant_new_uint64 (get_rss ()));
+    g_variant_builder_add (&builder, "{sv}", "scrollback-rows", get_scrollback_rows (tw));
+
+    for (guint i = 0; i < TILDA_METRIC_COUNTER_LAST; i++)
+    {
+        g_variant_builder_add (&builder, "{sv}", counter_names[i],
+                               g_variant_new_uint64 (__atomic_load_n (&counters[i], __ATOMIC_RELAXED)));
+    }
+
+    for (guint i = 0; i < TILDA_METRIC_HISTOGRAM_LAST; i++)
+    {
+        guint64 buckets[TILDA_METRICS_BUCKETS];
+
+        for (guint j = 0; j < TILDA_METRICS_BUCKETS; j++) {
+            buckets[j] = __atomic_load_n (&histograms[i].buckets[j], __ATOMIC_RELAXED);
+        }
+
+        g_variant_builder_add (&builder, "{sv}", histogram_names[i],
+                               g_variant_new ("(tt@at)",
+                                              __atomic_load_n (&histograms[i].count, __ATOMIC_RELAXED),
+                                              __atomic_load_n (&histograms[i].sum, __ATOMIC_RELAXED),
+                                              g_variant_new_fixed_array (G_VARIANT_TYPE_UINT64,
+                                                                         buckets,
+                                                                         TILDA_METRICS_BUCKETS,
+                                                                         sizeof (guint64))));
+    }
+
+    return g_variant_builder_end (&builder);
+}
+
+/* Returns the upper bound of the bucket that contains the given quantile,
+ * in microseconds */
+static guint64
+get_quantile (const guint64 *buckets, gsize n_buckets, guint64 count, gdouble quantile)
+{
+    guint64 rank = (guint64) (quantile * (gdouble) count);
+    guint64 seen = 0;
+
+    for (gsize i = 0; i < n_buckets; i++)
+    {
+        seen += buckets[i];
+
+        if (seen > rank) {
+            return (guint64) 1 << i;
+        }
+    }
+
+    return (guint64) 1 << (n_buckets - 1);
+}
+
+static void
+print_histogram (const gchar *name, GVariant *value)
+{
+    GVariant *bucket_array;
+    const guint64 *buckets;
+    gsize n_buckets;
+    guint64 count;
+    guint64 sum;
+
+    g_variant_get (value, "(tt@at)", &count, &sum, &bucket_array);
+
+    buckets = g_variant_get_fixed_array (bucket_array, &n_buckets, sizeof (guint64));
+
+    if (count == 0 || n_buckets == 0) {
+        printf ("%-20s 0\n", name);
+    } else {
+        printf ("%-20s %" G_GUINT64_FORMAT "  mean %.1f ms  p50 < %.1f ms  p99 < %.1f ms\n",
+                name, count,
+                (gdouble) sum / (gdouble) count / 1000.0,
+                (gdouble) get_quantile (buckets, n_buckets, count, 0.5) / 1000.0,
+                (gdouble) get_quantile (buckets, n_buckets, count, 0.99) / 1000.0);
+    }
+
+    g_variant_unref (bucket_array);
+}
+
+void
+tilda_metrics_print (GVariant *metrics)
+{
+    GVariantIter iter;
+    const gchar *name;
+    GVariant *value;
+
+    g_variant_iter_init (&iter, metrics);
+
+    while (g_variant_iter_next (&iter, "{&sv}", &name, &value))
+    {
+        if (g_variant_is_of_type (value, G_VARIANT_TYPE ("(ttat)"))) {
+            print_histogram (name, value);
+        } else if (g_variant_is_of_type (value, G_VARIANT_TYPE ("a(ut)"))) {
+            GVariantIter rows;
+            guint32 tab;
+            guint64 count;
+
+            g_variant_iter_init (&rows, value);
+
+            while (g_variant_iter_next (&rows, "(ut)", &tab, &count)) {
+                printf ("%-20s tab %u: %" G_GUINT64_FORMAT "\n", name, tab, count);
+            }
+        } else if (g_variant_is_of_type (value, G_VARIANT_TYPE_UINT64)) {
+            printf ("%-20s %" G_GUINT64_FORMAT "\n", name, g_variant_get_uint64 (value));
+        } else if (g_variant_is_of_type (value, G_VARIANT_TYPE_UINT32)) {
+            printf ("%-20s %u\n", name, g_variant_get_uint32 (value));
+        }
+
+        g_variant_unref (value);
+    }
+}
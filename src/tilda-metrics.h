@@ -0,0 +1,87 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILDA_METRICS_H
+#define TILDA_METRICS_H
+
+#include "tilda_window.h"
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Runtime metrics that are cheap enough to be always collected. Counters
+ * and histograms are updated with relaxed atomic operations and can be
+ * updated from any thread. They are read with GetMetrics over D-Bus or
+ * printed with "tilda --stats".
+ *
+ * Histograms count durations in microseconds in buckets of powers of two:
+ * bucket i counts the durations d with 2^(i-1) <= d < 2^i, bucket 0 counts
+ * durations of 0.
+ */
+
+typedef enum {
+    TILDA_METRIC_TITLE_CHANGES,
+    TILDA_METRIC_TABS_CLOSED,
+    TILDA_METRIC_COUNTER_LAST
+} TildaMetricCounter;
+
+typedef enum {
+    /* Pulling the window up or down */
+    TILDA_METRIC_PULL_TIME,
+    /* Creating a tab, without spawning its shell */
+    TILDA_METRIC_TAB_CREATION_TIME,
+    /* From starting to spawn a shell until it runs */
+    TILDA_METRIC_SPAWN_TIME,
+    /* Searching the current tab from the search bar */
+    TILDA_METRIC_SEARCH_TIME,
+    /* Writing the config file */
+    TILDA_METRIC_CONFIG_WRITE_TIME,
+    /* The time between two frames of a terminal while a large paste runs */
+    TILDA_METRIC_PASTE_FRAME_TIME,
+    /* From starting to spawn a shell until it printed its first output */
+    TILDA_METRIC_PROMPT_TIME,
+    /* From switching the tab with FocusTab until the window was painted */
+    TILDA_METRIC_TAB_SWITCH_TIME,
+    TILDA_METRIC_HISTOGRAM_LAST
+} TildaMetricHistogram;
+
+#define TILDA_METRICS_BUCKETS 32
+
+/**
+ * Remembers the start time of the process for the uptime.
+ */
+void tilda_metrics_init (void);
+
+void tilda_metrics_count (TildaMetricCounter counter);
+
+void tilda_metrics_observe (TildaMetricHistogram histogram, gint64 usec);
+
+/**
+ * Returns all metrics as a dictionary of type a{sv}. Counters are of type
+ * t, histograms of type (ttat) with the count, the sum in microseconds
+ * and the buckets.
+ */
+GVariant *tilda_metrics_collect (tilda_window *tw);
+
+/**
+ * Prints metrics returned by tilda_metrics_collect() to stdout.
+ */
+void tilda_metrics_print (GVariant *metrics);
+
+G_END_DECLS
+
+#endif /* TILDA_METRICS_H */
@@ -0,0 +1,413 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilda-paste.h"
+
+#include "debug.h"
+#include "tilda-metrics.h"
+
+#include <errno.h>
+#include <glib.h>
+#include <glib-unix.h>
+#include <glib/gi18n.h>
+#include <gtk/gtk.h>
+#include <string.h>
+#include <unistd.h>
+#include <vte/vte.h>
+
+/* Texts up to this size are pasted by VTE in one go */
+#define TILDA_PASTE_CHUNKED_THRESHOLD (64 * 1024)
+
+/* The maximum number of bytes written to the PTY at once */
+#define TILDA_PASTE_CHUNK_SIZE 4096
+
+/* The minimum time between two updates of the progress bar in microseconds */
+#define TILDA_PASTE_PROGRESS_INTERVAL (100 * 1000)
+
+struct tilda_paste_
+{
+    gchar *text;
+    gsize length;
+    /* The position of the next byte of text that goes into the buffer */
+    gsize offset;
+
+    /* The converted chunk that is currently written to the PTY, and the
+     * number of bytes of text it was converted from */
+    gchar buffer[TILDA_PASTE_CHUNK_SIZE];
+    gsize buffer_length;
+    gsize buffer_offset;
+    gsize chunk_length;
+
+    /* The number of bytes of all texts of this paste, including those that
+     * were appended while it was running, and how many of them were
+     * written. */
+    gsize total;
+    gsize done;
+
+    /* The marker that ends the bracketed paste, NULL if the program did
+     * not enable bracketed paste */
+    gchar *bracket_end;
+
+    guint source;
+
+    /* Measures the time between two frames while the paste is running */
+    guint tick_id;
+    gint64 frame_time;
+
+    /* When the progress bar was updated the last time */
+    gint64 progress_time;
+};
+
+/* Identifies the terminal that requested the clipboard, since it may be
+ * closed before the text arrives. */
+typedef struct
+{
+    tilda_window *tw;
+    guint id;
+} TildaPasteRequest;
+
+static void
+paste_free (struct tilda_paste_ *paste)
+{
+    if (paste->source != 0) {
+        g_source_remove (paste->source);
+    }
+
+    g_free (paste->bracket_end);
+    g_free (paste->text);
+    g_free (paste);
+}
+
+static void
+finish_paste (tilda_term *tt)
+{
+    struct tilda_paste_ *paste = tt->paste;
+
+    tt->paste = NULL;
+
+    /* The program waits for the end of the paste, also if it was
+     * cancelled. VTE writes it after the text that was written already. */
+    if (paste->bracket_end != NULL) {
+        vte_terminal_feed_child (VTE_TERMINAL (tt->vte_term), paste->bracket_end, -1);
+    }
+
+    if (paste->tick_id != 0) {
+        gtk_widget_remove_tick_callback (tt->vte_term, paste->tick_id);
+    }
+
+    paste_free (paste);
+
+    tilda_paste_update_progress (tt->tw);
+}
+
+#if VTE_CHECK_VERSION (0, 68, 0)
+
+/* Converts the next chunk of text like VTE does for pastes: line feeds and
+ * CRLF sequences become carriage returns, and control characters other
+ * than tab and carriage return are dropped, so that the text cannot end a
+ * bracketed paste early. A chunk does not end between the carriage return
+ * and the line feed of a CRLF sequence. */
+static void
+fill_buffer (struct tilda_paste_ *paste)
+{
+    const gchar *text = paste->text;
+    gsize end = MIN (paste->offset + TILDA_PASTE_CHUNK_SIZE, paste->length);
+    gsize length = 0;
+
+    if (end < paste->length && end > paste->offset + 1
+        && text[end - 1] == '\r' && text[end] == '\n')
+    {
+        end--;
+    }
+
+    for (gsize i = paste->offset; i < end; i++)
+    {
+        guchar c = (guchar) text[i];
+
+        if (c == '\n') {
+            if (i == 0 || text[i - 1] != '\r') {
+                paste->buffer[length++] = '\r';
+            }
+        } else if ((c >= 0x20 && c != 0x7f) || c == '\t' || c == '\r') {
+            paste->buffer[length++] = (gchar) c;
+        }
+    }
+
+    paste->buffer_length = length;
+    paste->buffer_offset = 0;
+    paste->chunk_length = end - paste->offset;
+    paste->offset = end;
+}
+
+/* Writes the next chunk whenever the PTY can take more data, so the speed
+ * of the paste is limited by the program that reads it. */
+static gboolean
+pty_writable_cb (gint fd,
+                 G_GNUC_UNUSED GIOCondition condition,
+                 gpointer user_data)
+{
+    tilda_term *tt = user_data;
+    struct tilda_paste_ *paste = tt->paste;
+    gssize written;
+
+    if (paste->buffer_offset == paste->buffer_length) {
+        fill_buffer (paste);
+    }
+
+    written = write (fd, paste->buffer + paste->buffer_offset,
+                     paste->buffer_length - paste->buffer_offset);
+
+    if (written < 0) {
+        if (errno == EAGAIN || errno == EINTR) {
+            return G_SOURCE_CONTINUE;
+        }
+
+        g_printerr (_("Failed to paste into the terminal: %s\n"), g_strerror (errno));
+        paste->source = 0;
+        finish_paste (tt);
+        return G_SOURCE_REMOVE;
+    }
+
+    paste->buffer_offset += (gsize) written;
+
+    if (paste->buffer_offset == paste->buffer_length) {
+        paste->done += paste->chunk_length;
+
+        if (paste->offset == paste->length) {
+            paste->source = 0;
+            finish_paste (tt);
+            return G_SOURCE_REMOVE;
+        }
+    }
+
+    if (g_get_monotonic_time () - paste->progress_time >= TILDA_PASTE_PROGRESS_INTERVAL) {
+        paste->progress_time = g_get_monotonic_time ();
+        tilda_paste_update_progress (tt->tw);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+paste_tick_cb (G_GNUC_UNUSED GtkWidget *widget,
+               GdkFrameClock *frame_clock,
+               gpointer user_data)
+{
+    struct tilda_paste_ *paste = TILDA_TERM (user_data)->paste;
+    gint64 frame_time = gdk_frame_clock_get_frame_time (frame_clock);
+
+    if (paste->frame_time != 0) {
+        tilda_metrics_observe (TILDA_METRIC_PASTE_FRAME_TIME, frame_time - paste->frame_time);
+    }
+
+    paste->frame_time = frame_time;
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+commit_cb (G_GNUC_UNUSED VteTerminal *terminal,
+           const gchar *text,
+           guint size,
+           gpointer user_data)
+{
+    g_string_append_len (user_data, text, size);
+}
+
+/* Returns the markers that start and end a paste into the terminal, or
+ * FALSE if the program did not enable bracketed paste. VTE does not expose
+ * the mode, so an empty text is pasted and the markers that VTE sends for
+ * it are taken. An empty bracketed paste does nothing. */
+static gboolean
+get_bracket_markers (VteTerminal *terminal, gchar **start, gchar **end)
+{
+    GString *committed = g_string_new (NULL);
+    const gchar *marker;
+    gulong handler;
+
+    handler = g_signal_connect (terminal, "commit", G_CALLBACK (commit_cb), committed);
+    vte_terminal_paste_text (terminal, "");
+    g_signal_handler_disconnect (terminal, handler);
+
+    marker = strstr (committed->str, "200~");
+
+    if (marker != NULL) {
+        marker += strlen ("200~");
+        *start = g_strndup (committed->str, (gsize) (marker - committed->str));
+        *end = g_strdup (marker);
+    }
+
+    g_string_free (committed, TRUE);
+
+    return marker != NULL;
+}
+
+static void
+start_paste (tilda_term *tt, const gchar *text)
+{
+    VteTerminal *terminal = VTE_TERMINAL (tt->vte_term);
+    struct tilda_paste_ *paste = tt->paste;
+    gchar *bracket_start;
+    VtePty *pty;
+
+    /* Append the text to the paste that is still running */
+    if (paste != NULL) {
+        gchar *remaining = g_strconcat (paste->text + paste->offset, text, NULL);
+
+        g_free (paste->text);
+        paste->text = remaining;
+        paste->length = strlen (remaining);
+        paste->offset = 0;
+        paste->total += strlen (text);
+
+        return;
+    }
+
+    pty = vte_terminal_get_pty (terminal);
+
+    if (pty == NULL || !vte_terminal_get_input_enabled (terminal)) {
+        return;
+    }
+
+    paste = g_new0 (struct tilda_paste_, 1);
+    paste->text = g_strdup (text);
+    paste->length = strlen (text);
+    paste->total = paste->length;
+
+    /* The markers are sent once around the whole text. VTE writes what is
+     * sent through it from a source of a higher priority than the one
+     * below, so the start marker reaches the PTY before the text. */
+    if (get_bracket_markers (terminal, &bracket_start, &paste->bracket_end)) {
+        vte_terminal_feed_child (terminal, bracket_start, -1);
+        g_free (bracket_start);
+    }
+
+    /* VTE opens the PTY in non-blocking mode, so a write never stalls the
+     * main loop. The text is written to the PTY directly instead of
+     * through VTE, which would buffer all of it at once. */
+    paste->source = g_unix_fd_add (vte_pty_get_fd (pty), G_IO_OUT, pty_writable_cb, tt);
+    paste->tick_id = gtk_widget_add_tick_callback (tt->vte_term, paste_tick_cb, tt, NULL);
+
+    tt->paste = paste;
+
+    tilda_paste_update_progress (tt->tw);
+}
+
+static void
+clipboard_text_received_cb (G_GNUC_UNUSED GtkClipboard *clipboard,
+                            const gchar *text,
+                            gpointer user_data)
+{
+    TildaPasteRequest *request = user_data;
+    tilda_term *tt = NULL;
+
+    for (GList *item = request->tw->terms; item != NULL; item = item->next)
+    {
+        if (TILDA_TERM (item->data)->id == request->id) {
+            tt = item->data;
+            break;
+        }
+    }
+
+    g_free (request);
+
+    if (tt == NULL || text == NULL) {
+        return;
+    }
+
+    if (tt->paste == NULL && strlen (text) <= TILDA_PASTE_CHUNKED_THRESHOLD) {
+        vte_terminal_paste_text (VTE_TERMINAL (tt->vte_term), text);
+        return;
+    }
+
+    start_paste (tt, text);
+}
+
+#endif
+
+void
+tilda_paste_clipboard (tilda_term *tt)
+{
+    DEBUG_FUNCTION ("tilda_paste_clipboard");
+    DEBUG_ASSERT (tt != NULL);
+
+#if VTE_CHECK_VERSION (0, 68, 0)
+    GtkClipboard *clipboard;
+    TildaPasteRequest *request;
+
+    clipboard = gtk_widget_get_clipboard (tt->vte_term, GDK_SELECTION_CLIPBOARD);
+
+    request = g_new (TildaPasteRequest, 1);
+    request->tw = tt->tw;
+    request->id = tt->id;
+
+    gtk_clipboard_request_text (clipboard, clipboard_text_received_cb, request);
+#else
+    /* Older versions of VTE can only paste the clipboard themselves. Writing
+     * large texts to the PTY in chunks would bypass bracketed paste, so VTE
+     * pastes everything. */
+    vte_terminal_paste_clipboard (VTE_TERMINAL (tt->vte_term));
+#endif
+}
+
+gboolean
+tilda_paste_cancel (tilda_term *tt)
+{
+    DEBUG_FUNCTION ("tilda_paste_cancel");
+    DEBUG_ASSERT (tt != NULL);
+
+    if (tt->paste == NULL) {
+        return FALSE;
+    }
+
+    finish_paste (tt);
+
+    return TRUE;
+}
+
+void
+tilda_paste_update_progress (tilda_window *tw)
+{
+    DEBUG_ASSERT (tw != NULL);
+
+    GtkProgressBar *progress;
+    tilda_term *tt;
+    gint page;
+
+    if (tw->paste_progress == NULL) {
+        return;
+    }
+
+    progress = GTK_PROGRESS_BAR (tw->paste_progress);
+    page = gtk_notebook_get_current_page (GTK_NOTEBOOK (tw->notebook));
+    tt = page >= 0 ? g_list_nth_data (tw->terms, (guint) page) : NULL;
+
+    if (tt == NULL || tt->paste == NULL) {
+        gtk_widget_hide (tw->paste_progress);
+        return;
+    }
+
+    gchar *done = g_format_size (tt->paste->done);
+    gchar *total = g_format_size (tt->paste->total);
+    gchar *text = g_strdup_printf (_("Pasted %s of %s, press Escape to cancel"), done, total);
+
+    gtk_progress_bar_set_fraction (progress, (gdouble) tt->paste->done / (gdouble) tt->paste->total);
+    gtk_progress_bar_set_text (progress, text);
+    gtk_widget_show (tw->paste_progress);
+
+    g_free (done);
+    g_free (total);
+    g_free (text);
+}
@@ -0,0 +1,59 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILDA_PASTE_H
+#define TILDA_PASTE_H
+
+#include "tilda_window.h"
+#include "tilda_terminal.h"
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Pastes the clipboard into terminals without blocking the user interface.
+ *
+ * The clipboard is read asynchronously. Small texts are pasted by VTE as
+ * usual. Large texts are pasted in chunks whenever the PTY can take more
+ * data, so the speed of the paste is limited by the program that reads it.
+ * If the program enabled bracketed paste, the whole text is sent between
+ * one pair of markers. The progress of a large paste is shown below the
+ * terminal, and it can be cancelled with Escape. The time between frames
+ * during a large paste is recorded in the paste-frame-time metric.
+ * Chunked pastes need VTE 0.68, with older versions VTE pastes all texts.
+ */
+
+/**
+ * Pastes the content of the clipboard into the terminal. If a large paste
+ * is already running in the terminal, the text is pasted after it.
+ */
+void     tilda_paste_clipboard (tilda_term *tt);
+
+/**
+ * Cancels the large paste that is running in the terminal. Returns TRUE if
+ * a paste was cancelled.
+ */
+gboolean tilda_paste_cancel (tilda_term *tt);
+
+/**
+ * Shows or hides the progress bar of the window for the paste in the
+ * current tab. Must be called when the current tab changes.
+ */
+void     tilda_paste_update_progress (tilda_window *tw);
+
+G_END_DECLS
+
+#endif /* TILDA_PASTE_H */
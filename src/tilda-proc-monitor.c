@@ -0,0 +1,550 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L /* feature test macro for O_CLOEXEC */
+
+#include "tilda-proc-monitor.h"
+
+#include "configsys.h"
+#include "debug.h"
+#include "tilda_terminal.h"
+
+#include <fcntl.h>
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* The minimal interval in milliseconds between two scans of /proc */
+#define TILDA_PROC_MONITOR_MIN_INTERVAL 500
+
+struct tilda_proc_monitor_
+{
+    tilda_window *tw;
+
+    GThread *thread;
+    GAsyncQueue *requests;
+
+    guint timer_source;
+
+    /* TRUE while the worker thread is busy with a scan, used to skip
+     * intervals if a scan takes longer than the interval. */
+    gboolean scan_pending;
+};
+
+typedef struct
+{
+    guint id;
+    GPid pid;
+} TildaProcRoot;
+
+typedef struct
+{
+    guint id;
+    gdouble cpu_usage;
+    guint64 memory_usage;
+    guint64 io_rate;
+} TildaProcUsage;
+
+/* A request for the worker thread to scan the process trees of the roots */
+typedef struct
+{
+    GArray *roots;
+} TildaProcScanRequest;
+
+typedef struct
+{
+    tilda_window *tw;
+    struct tilda_proc_monitor_ *monitor;
+    GArray *usage;
+} TildaProcScanResult;
+
+typedef struct
+{
+    GPid ppid;
+    guint64 start_time;
+    guint64 cpu_ticks;
+    guint64 memory;
+    guint64 io_bytes;
+} TildaProcInfo;
+
+/* The state of the worker thread which is carried from one scan to
+ * the next one to calculate rates. */
+typedef struct
+{
+    GHashTable *previous;
+    gint64 previous_time;
+} TildaProcScanner;
+
+/* Pushed to the request queue to stop the worker thread */
+static TildaProcScanRequest quit_request;
+
+static gssize
+read_proc_file (const gchar *path, gchar *buffer, gsize size)
+{
+    gint fd;
+    gssize length;
+
+    fd = open (path, O_RDONLY | O_CLOEXEC);
+
+    if (fd == -1) {
+        return -1;
+    }
+
+    length = read (fd, buffer, size - 1);
+    close (fd);
+
+    if (length >= 0) {
+        buffer[length] = '\0';
+    }
+
+    return length;
+}
+
+static gboolean
+read_proc_info (const gchar *pid, TildaProcInfo *info)
+{
+    gchar path[64];
+    gchar buffer[1024];
+    gchar *fields;
+    gint ppid;
+    unsigned long long utime, stime, start_time;
+    long long rss;
+
+    g_snprintf (path, sizeof (path), "/proc/%s/stat", pid);
+
+    if (read_proc_file (path, buffer, sizeof (buffer)) <= 0) {
+        return FALSE;
+    }
+
+    /* The command name is enclosed in parentheses and may contain
+     * spaces, so the remaining fields start after the last ')'. */
+    fields = strrchr (buffer, ')');
+
+    if (fields == NULL) {
+        return FALSE;
+    }
+
+    if (sscanf (fields + 1,
+                " %*c %d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu"
+                " %*d %*d %*d %*d %*d %*d %llu %*u %lld",
+                &ppid, &utime, &stime, &start_time, &rss) != 5)
+    {
+        return FALSE;
+    }
+
+    info->ppid = ppid;
+    info->start_time = start_time;
+    info->cpu_ticks = utime + stime;
+    info->memory = rss > 0 ? (guint64) rss * (guint64) sysconf (_SC_PAGESIZE) : 0;
+    info->io_bytes = 0;
+
+    /* The I/O counters are not available for processes of other users */
+    g_snprintf (path, sizeof (path), "/proc/%s/io", pid);
+
+    if (read_proc_file (path, buffer, sizeof (buffer)) > 0) {
+        const gchar *read_bytes = strstr (buffer, "\nread_bytes:");
+        const gchar *write_bytes = strstr (buffer, "\nwrite_bytes:");
+
+        if (read_bytes != NULL) {
+            info->io_bytes += g_ascii_strtoull (read_bytes + strlen ("\nread_bytes:"), NULL, 10);
+        }
+
+        if (write_bytes != NULL) {
+            info->io_bytes += g_ascii_strtoull (write_bytes + strlen ("\nwrite_bytes:"), NULL, 10);
+        }
+    }
+
+    return TRUE;
+}
+
+static gboolean
+is_pid (const gchar *name)
+{
+    for (const gchar *c = name; *c != '\0'; c++) {
+        if (!g_ascii_isdigit (*c)) {
+            return FALSE;
+        }
+    }
+
+    return *name != '\0';
+}
+
+/* Reads all processes of the system into a table that maps pids to their
+ * TildaProcInfo and a table that maps pids to an array of their children. */
+static GHashTable *
+scan_processes (GHashTable **children)
+{
+    GHashTable *processes;
+    GDir *dir;
+    const gchar *name;
+
+    processes = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+    *children = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify) g_array_unref);
+
+    dir = g_dir_open ("/proc", 0, NULL);
+
+    if (dir == NULL) {
+        return processes;
+    }
+
+    while ((name = g_dir_read_name (dir)) != NULL)
+    {
+        TildaProcInfo info;
+        GArray *siblings;
+        GPid pid;
+
+        if (!is_pid (name) || !read_proc_info (name, &info)) {
+            continue;
+        }
+
+        pid = (GPid) g_ascii_strtoll (name, NULL, 10);
+
+        TildaProcInfo *copy = g_new (TildaProcInfo, 1);
+        *copy = info;
+
+        g_hash_table_insert (processes, GINT_TO_POINTER (pid), copy);
+
+        siblings = g_hash_table_lookup (*children, GINT_TO_POINTER (info.ppid));
+
+        if (siblings == NULL) {
+            siblings = g_array_new (FALSE, FALSE, sizeof (GPid));
+            g_hash_table_insert (*children, GINT_TO_POINTER (info.ppid), siblings);
+        }
+
+        g_array_append_val (siblings, pid);
+    }
+
+    g_dir_close (dir);
+
+    return processes;
+}
+
+static void
+sum_process_tree (TildaProcScanner *scanner,
+                  GHashTable *processes,
+                  GHashTable *children,
+                  GPid root,
+                  gboolean have_previous,
+                  guint64 *cpu_ticks,
+                  guint64 *memory,
+                  guint64 *io_bytes)
+{
+    GArray *stack;
+
+    stack = g_array_new (FALSE, FALSE, sizeof (GPid));
+    g_array_append_val (stack, root);
+
+    while (stack->len > 0)
+    {
+        GPid pid = g_array_index (stack, GPid, stack->len - 1);
+        TildaProcInfo *info;
+        TildaProcInfo *previous;
+        GArray *child_pids;
+
+        g_array_set_size (stack, stack->len - 1);
+
+        info = g_hash_table_lookup (processes, GINT_TO_POINTER (pid));
+
+        if (info == NULL) {
+            continue;
+        }
+
+        *memory += info->memory;
+
+        /* Processes that started after the previous scan spent all of
+         * their time within the current interval. */
+        if (have_previous) {
+            previous = g_hash_table_lookup (scanner->previous, GINT_TO_POINTER (pid));
+
+            if (previous != NULL && previous->start_time == info->start_time) {
+                *cpu_ticks += info->cpu_ticks - MIN (previous->cpu_ticks, info->cpu_ticks);
+                *io_bytes += info->io_bytes - MIN (previous->io_bytes, info->io_bytes);
+            } else {
+                *cpu_ticks += info->cpu_ticks;
+                *io_bytes += info->io_bytes;
+            }
+        }
+
+        child_pids = g_hash_table_lookup (children, GINT_TO_POINTER (pid));
+
+        if (child_pids != NULL) {
+            g_array_append_vals (stack, child_pids->data, child_pids->len);
+        }
+    }
+
+    g_array_unref (stack);
+}
+
+GHashTable *
+tilda_proc_monitor_get_process_trees (const GPid *roots, guint n_roots)
+{
+    GHashTable *processes;
+    GHashTable *children;
+    GHashTable *trees;
+
+    processes = scan_processes (&children);
+    trees = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify) g_array_unref);
+
+    for (guint i = 0; i < n_roots; i++)
+    {
+        GArray *tree;
+
+        if (!g_hash_table_contains (processes, GINT_TO_POINTER (roots[i]))) {
+            continue;
+        }
+
+        tree = g_array_new (FALSE, FALSE, sizeof (GPid));
+        g_array_append_val (tree, roots[i]);
+
+        /* The tree array doubles as the work list of a breadth first search */
+        for (guint j = 0; j < tree->len; j++)
+        {
+            GPid pid = g_array_index (tree, GPid, j);
+            GArray *child_pids = g_hash_table_lookup (children, GINT_TO_POINTER (pid));
+
+            if (child_pids != NULL) {
+                g_array_append_vals (tree, child_pids->data, child_pids->len);
+            }
+        }
+
+        g_hash_table_insert (trees, GINT_TO_POINTER (roots[i]), tree);
+    }
+
+    g_hash_table_unref (processes);
+    g_hash_table_unref (children);
+
+    return trees;
+}
+
+static GArray *
+scan (TildaProcScanner *scanner, GArray *roots)
+{
+    GHashTable *processes;
+    GHashTable *children;
+    GArray *usage;
+    gint64 now;
+    gdouble elapsed = 0;
+    gboolean have_previous;
+    glong ticks_per_second;
+
+    processes = scan_processes (&children);
+    now = g_get_monotonic_time ();
+
+    have_previous = scanner->previous != NULL;
+
+    if (have_previous) {
+        elapsed = (gdouble) (now - scanner->previous_time) / G_USEC_PER_SEC;
+    }
+
+    ticks_per_second = sysconf (_SC_CLK_TCK);
+
+    usage = g_array_sized_new (FALSE, TRUE, sizeof (TildaProcUsage), roots->len);
+
+    for (guint i = 0; i < roots->len; i++)
+    {
+        TildaProcRoot *root = &g_array_index (roots, TildaProcRoot, i);
+        TildaProcUsage root_usage = { 0 };
+        guint64 cpu_ticks = 0;
+        guint64 io_bytes = 0;
+
+        root_usage.id = root->id;
+
+        sum_process_tree (scanner, processes, children, root->pid, have_previous,
+                          &cpu_ticks, &root_usage.memory_usage, &io_bytes);
+
+        if (elapsed > 0 && ticks_per_second > 0) {
+            root_usage.cpu_usage = 100.0 * cpu_ticks / ticks_per_second / elapsed;
+            root_usage.io_rate = (guint64) (io_bytes / elapsed);
+        }
+
+        g_array_append_val (usage, root_usage);
+    }
+
+    if (scanner->previous != NULL) {
+        g_hash_table_unref (scanner->previous);
+    }
+
+    scanner->previous = processes;
+    scanner->previous_time = now;
+
+    g_hash_table_unref (children);
+
+    return usage;
+}
+
+static gboolean
+apply_scan_result_cb (gpointer user_data)
+{
+    TildaProcScanResult *result = user_data;
+    tilda_window *tw = result->tw;
+
+    /* The monitor may have been stopped while the result was queued */
+    if (tw->proc_monitor != result->monitor) {
+        goto out;
+    }
+
+    tw->proc_monitor->scan_pending = FALSE;
+
+    for (GList *item = tw->terms; item != NULL; item = item->next)
+    {
+        tilda_term *tt = item->data;
+
+        for (guint i = 0; i < result->usage->len; i++)
+        {
+            TildaProcUsage *usage = &g_array_index (result->usage, TildaProcUsage, i);
+
+            if (usage->id != tt->id) {
+                continue;
+            }
+
+            tt->resources_valid = TRUE;
+            tt->cpu_usage = usage->cpu_usage;
+            tt->memory_usage = usage->memory_usage;
+            tt->io_rate = usage->io_rate;
+
+            tilda_terminal_update_tooltip (tt);
+            break;
+        }
+    }
+
+out:
+    g_array_unref (result->usage);
+    g_free (result);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gpointer
+monitor_thread (gpointer user_data)
+{
+    struct tilda_proc_monitor_ *monitor = user_data;
+    TildaProcScanner scanner = { NULL, 0 };
+    TildaProcScanRequest *request;
+
+    while ((request = g_async_queue_pop (monitor->requests)) != &quit_request)
+    {
+        TildaProcScanResult *result = g_new0 (TildaProcScanResult, 1);
+
+        result->tw = monitor->tw;
+        result->monitor = monitor;
+        result->usage = scan (&scanner, request->roots);
+
+        g_idle_add (apply_scan_result_cb, result);
+
+        g_array_unref (request->roots);
+        g_free (request);
+    }
+
+    if (scanner.previous != NULL) {
+        g_hash_table_unref (scanner.previous);
+    }
+
+    return NULL;
+}
+
+static gboolean
+request_scan_cb (gpointer user_data)
+{
+    struct tilda_proc_monitor_ *monitor = user_data;
+    TildaProcScanRequest *request;
+
+    if (monitor->scan_pending) {
+        return G_SOURCE_CONTINUE;
+    }
+
+    request = g_new0 (TildaProcScanRequest, 1);
+    request->roots = g_array_new (FALSE, FALSE, sizeof (TildaProcRoot));
+
+    for (GList *item = monitor->tw->terms; item != NULL; item = item->next)
+    {
+        tilda_term *tt = item->data;
+        TildaProcRoot root = { tt->id, tt->pid };
+
+        if (tt->pid > 0) {
+            g_array_append_val (request->roots, root);
+        }
+    }
+
+    monitor->scan_pending = TRUE;
+    g_async_queue_push (monitor->requests, request);
+
+    return G_SOURCE_CONTINUE;
+}
+
+void
+tilda_proc_monitor_start (tilda_window *tw)
+{
+    DEBUG_FUNCTION ("tilda_proc_monitor_start");
+    DEBUG_ASSERT (tw != NULL);
+
+    struct tilda_proc_monitor_ *monitor;
+    guint interval;
+
+    if (tw->proc_monitor != NULL || !config_getbool ("resource_monitor")) {
+        return;
+    }
+
+    interval = (guint) MAX (config_getint ("resource_monitor_interval"),
+                            TILDA_PROC_MONITOR_MIN_INTERVAL);
+
+    monitor = g_new0 (struct tilda_proc_monitor_, 1);
+    monitor->tw = tw;
+    monitor->requests = g_async_queue_new ();
+    monitor->thread = g_thread_new ("tilda-proc-monitor", monitor_thread, monitor);
+    monitor->timer_source = g_timeout_add (interval, request_scan_cb, monitor);
+
+    tw->proc_monitor = monitor;
+
+    /* Take the first sample right away, such that the first rates are
+     * available after one interval. */
+    request_scan_cb (monitor);
+}
+
+void
+tilda_proc_monitor_stop (tilda_window *tw)
+{
+    DEBUG_FUNCTION ("tilda_proc_monitor_stop");
+    DEBUG_ASSERT (tw != NULL);
+
+    struct tilda_proc_monitor_ *monitor = tw->proc_monitor;
+
+    if (monitor == NULL) {
+        return;
+    }
+
+    tw->proc_monitor = NULL;
+
+    g_source_remove (monitor->timer_source);
+
+    g_async_queue_push (monitor->requests, &quit_request);
+    g_thread_join (monitor->thread);
+
+    /* Free the requests that were not processed anymore */
+    TildaProcScanRequest *request;
+    while ((request = g_async_queue_try_pop (monitor->requests)) != NULL) {
+        g_array_unref (request->roots);
+        g_free (request);
+    }
+
+    g_async_queue_unref (monitor->requests);
+    g_free (monitor);
+}
+
+gboolean
+tilda_proc_monitor_is_running (tilda_window *tw)
+{
+    return tw->proc_monitor != NULL;
+}
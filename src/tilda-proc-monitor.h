@@ -0,0 +1,62 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILDA_PROC_MONITOR_H
+#define TILDA_PROC_MONITOR_H
+
+#include "tilda_window.h"
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * The process monitor measures the CPU usage, the resident memory and the
+ * I/O rate of the process tree below the shell of each tab.
+ *
+ * In each interval a single worker thread scans /proc once, builds the
+ * process tree of the whole system and sums up the usage for the tree of
+ * every tab. The results are handed back to the GTK thread with g_idle_add()
+ * where they are stored in the tilda_term and shown in the tab tooltips.
+ */
+
+/**
+ * Starts the process monitor if it is enabled with the "resource_monitor"
+ * option.
+ */
+void     tilda_proc_monitor_start (tilda_window *tw);
+
+/**
+ * Stops the process monitor and waits for its worker thread to finish.
+ */
+void     tilda_proc_monitor_stop (tilda_window *tw);
+
+/**
+ * Returns TRUE if the process monitor is running.
+ */
+gboolean tilda_proc_monitor_is_running (tilda_window *tw);
+
+/**
+ * Scans /proc once and returns the process trees below the given root pids.
+ * The result maps each root pid (GINT_TO_POINTER) to a GArray of GPid which
+ * contains the root and all of its descendants. Roots that do not exist are
+ * not contained in the result. This function blocks on file I/O and should be
+ * called from a worker thread.
+ */
+GHashTable *tilda_proc_monitor_get_process_trees (const GPid *roots, guint n_roots);
+
+G_END_DECLS
+
+#endif /* TILDA_PROC_MONITOR_H */
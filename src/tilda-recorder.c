@@ -0,0 +1,963 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE /* feature test macro for posix_openpt, cfmakeraw and O_CLOEXEC */
+
+#include "tilda-recorder.h"
+
+#include "configsys.h"
+#include "debug.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib-unix.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vte/vte.h>
+
+/* The maximum number of bytes read from the PTY of the child at once */
+#define TILDA_RECORDER_READ_SIZE (64 * 1024)
+
+/* The size of the buffer between the terminal and the writer thread */
+#define TILDA_RECORDER_RING_SIZE (4 * 1024 * 1024)
+
+/* The header of each event in the ring buffer, followed by its data */
+typedef struct
+{
+    /* The monotonic time of the event in microseconds */
+    gint64 time;
+    guint32 length;
+    /* The asciicast event type, 'o' for output and 'r' for a resize */
+    gchar type;
+} TildaRecorderEvent;
+
+typedef struct
+{
+    GMutex mutex;
+    GCond cond;
+
+    /* The ring buffer and the position and number of the bytes in it */
+    guint8 *ring;
+    gsize head;
+    gsize length;
+
+    gboolean quit;
+    /* The number of bytes of output that did not fit into the buffer */
+    guint64 dropped;
+
+    GThread *thread;
+    FILE *file;
+    gchar *path;
+    gint64 start_time;
+
+    /* An incomplete UTF-8 sequence at the end of the last output event,
+     * only used by the writer thread */
+    gchar carry[4];
+    gsize carry_length;
+} TildaRecording;
+
+struct tilda_recorder_
+{
+    tilda_term *tt;
+
+    /* Cancels the spawn of the child that is in progress */
+    GCancellable *cancellable;
+
+    /* The PTY the child runs on, and the slave side of the PTY of VTE */
+    VtePty *child_pty;
+    gint terminal_fd;
+
+    /* Output of the child that VTE did not accept yet, and input from
+     * VTE that the child did not accept yet */
+    GByteArray *output;
+    GByteArray *input;
+    gboolean child_eof;
+
+    guint child_source;
+    guint terminal_source;
+    guint output_source;
+    guint input_source;
+
+    gulong size_allocate_handler;
+    glong rows;
+    glong columns;
+
+    TildaRecording *recording;
+};
+
+typedef struct
+{
+    struct tilda_recorder_ *recorder;
+    GCancellable *cancellable;
+    VtePty *terminal_pty;
+    gint terminal_fd;
+    VteTerminalSpawnAsyncCallback callback;
+    gpointer user_data;
+} TildaRecorderSpawn;
+
+static gboolean child_readable_cb (gint fd, GIOCondition condition, gpointer user_data);
+
+static void
+remove_source (guint *source)
+{
+    if (*source != 0) {
+        g_source_remove (*source);
+        *source = 0;
+    }
+}
+
+/* Ring buffer, the caller must hold the mutex of the recording */
+
+static void
+ring_write (TildaRecording *recording, gconstpointer data, gsize size)
+{
+    const guint8 *bytes = data;
+    gsize tail = (recording->head + recording->length) % TILDA_RECORDER_RING_SIZE;
+    gsize first = MIN (size, TILDA_RECORDER_RING_SIZE - tail);
+
+    memcpy (recording->ring + tail, bytes, first);
+    memcpy (recording->ring, bytes + first, size - first);
+
+    recording->length += size;
+}
+
+static void
+ring_read (TildaRecording *recording, gpointer data, gsize size)
+{
+    guint8 *bytes = data;
+    gsize first = MIN (size, TILDA_RECORDER_RING_SIZE - recording->head);
+
+    memcpy (bytes, recording->ring + recording->head, first);
+    memcpy (bytes + first, recording->ring, size - first);
+
+    recording->head = (recording->head + size) % TILDA_RECORDER_RING_SIZE;
+    recording->length -= size;
+}
+
+/* Called on the GTK thread, never blocks on the writer thread for longer
+ * than a copy into the ring buffer. */
+static void
+recording_push (TildaRecording *recording, gchar type, const gchar *data, gsize size)
+{
+    TildaRecorderEvent event = { g_get_monotonic_time (), (guint32) size, type };
+
+    g_mutex_lock (&recording->mutex);
+
+    if (TILDA_RECORDER_RING_SIZE - recording->length < sizeof (event) + size) {
+        recording->dropped += size;
+        g_mutex_unlock (&recording->mutex);
+        return;
+    }
+
+    ring_write (recording, &event, sizeof (event));
+    ring_write (recording, data, size);
+
+    g_cond_signal (&recording->cond);
+    g_mutex_unlock (&recording->mutex);
+}
+
+/* Event formatting, only used by the writer thread */
+
+static void
+append_escaped_char (GString *line, gunichar c, const gchar *start, const gchar *end)
+{
+    switch (c)
+    {
+        case '"':
+            g_string_append (line, "\\\"");
+            break;
+        case '\\':
+            g_string_append (line, "\\\\");
+            break;
+        case '\n':
+            g_string_append (line, "\\n");
+            break;
+        case '\r':
+            g_string_append (line, "\\r");
+            break;
+        case '\t':
+            g_string_append (line, "\\t");
+            break;
+        default:
+            if (c < 0x20 || c == 0x7f) {
+                g_string_append_printf (line, "\\u%04x", c);
+            } else {
+                g_string_append_len (line, start, end - start);
+            }
+            break;
+    }
+}
+
+/* Appends the data as the content of a JSON string. Invalid UTF-8 is
+ * replaced, and a sequence that is cut off at the end of the data is kept
+ * for the next event if carry is TRUE. */
+static void
+append_escaped (TildaRecording *recording, GString *line,
+                const gchar *data, gsize length, gboolean carry)
+{
+    const gchar *p = data;
+    const gchar *end = data + length;
+
+    while (p < end)
+    {
+        gunichar c;
+        const gchar *next;
+
+        if (*p == '\0') {
+            g_string_append (line, "\\u0000");
+            p++;
+            continue;
+        }
+
+        c = g_utf8_get_char_validated (p, end - p);
+
+        if (c == (gunichar) -2 && carry && (gsize) (end - p) < sizeof (recording->carry)) {
+            recording->carry_length = end - p;
+            memcpy (recording->carry, p, recording->carry_length);
+            break;
+        }
+
+        if (c == (gunichar) -1 || c == (gunichar) -2) {
+            g_string_append (line, "\\ufffd");
+            p++;
+            continue;
+        }
+
+        next = g_utf8_next_char (p);
+        append_escaped_char (line, c, p, next);
+        p = next;
+    }
+}
+
+static void
+format_event (TildaRecording *recording, GString *line,
+              const TildaRecorderEvent *event, const gchar *data)
+{
+    gchar time[G_ASCII_DTOSTR_BUF_SIZE];
+
+    g_ascii_formatd (time, sizeof (time), "%.6f",
+                     (event->time - recording->start_time) / (gdouble) G_USEC_PER_SEC);
+
+    g_string_truncate (line, 0);
+    g_string_append_printf (line, "[%s, \"%c\", \"", time, event->type);
+
+    if (event->type == 'o' && recording->carry_length > 0) {
+        gsize length = recording->carry_length + event->length;
+        gchar *joined = g_malloc (length);
+
+        memcpy (joined, recording->carry, recording->carry_length);
+        memcpy (joined + recording->carry_length, data, event->length);
+        recording->carry_length = 0;
+
+        append_escaped (recording, line, joined, length, TRUE);
+        g_free (joined);
+    } else {
+        append_escaped (recording, line, data, event->length, event->type == 'o');
+    }
+
+    g_string_append (line, "\"]\n");
+}
+
+static gpointer
+recording_thread (gpointer user_data)
+{
+    TildaRecording *recording = user_data;
+    TildaRecorderEvent event;
+    GString *line;
+    gchar *data;
+
+    line = g_string_new (NULL);
+    data = g_malloc (TILDA_RECORDER_READ_SIZE);
+
+    while (TRUE)
+    {
+        gboolean drained;
+
+        g_mutex_lock (&recording->mutex);
+
+        while (recording->length == 0 && !recording->quit) {
+            g_cond_wait (&recording->cond, &recording->mutex);
+        }
+
+        if (recording->length == 0) {
+            g_mutex_unlock (&recording->mutex);
+            break;
+        }
+
+        ring_read (recording, &event, sizeof (event));
+        ring_read (recording, data, event.length);
+        drained = recording->length == 0;
+
+        g_mutex_unlock (&recording->mutex);
+
+        format_event (recording, line, &event, data);
+        fwrite (line->str, 1, line->len, recording->file);
+
+        /* Flush once all pending events were written, so that the recording
+         * can be followed while it is written and survives a crash */
+        if (drained) {
+            fflush (recording->file);
+        }
+    }
+
+    g_free (data);
+    g_string_free (line, TRUE);
+
+    return NULL;
+}
+
+/* The tee between the PTY of the child and the PTY of VTE */
+
+static void
+close_terminal (struct tilda_recorder_ *recorder)
+{
+    remove_source (&recorder->terminal_source);
+    remove_source (&recorder->output_source);
+
+    if (recorder->terminal_fd >= 0) {
+        close (recorder->terminal_fd);
+        recorder->terminal_fd = -1;
+    }
+}
+
+static void
+close_tee (struct tilda_recorder_ *recorder)
+{
+    close_terminal (recorder);
+
+    remove_source (&recorder->child_source);
+    remove_source (&recorder->input_source);
+
+    g_clear_object (&recorder->child_pty);
+
+    g_byte_array_set_size (recorder->output, 0);
+    g_byte_array_set_size (recorder->input, 0);
+    recorder->child_eof = FALSE;
+}
+
+static void
+watch_child (struct tilda_recorder_ *recorder)
+{
+    recorder->child_source = g_unix_fd_add (vte_pty_get_fd (recorder->child_pty),
+                                            G_IO_IN | G_IO_HUP | G_IO_ERR,
+                                            child_readable_cb, recorder);
+}
+
+static gboolean flush_output (struct tilda_recorder_ *recorder);
+
+static gboolean
+terminal_writable_cb (G_GNUC_UNUSED gint fd,
+                      G_GNUC_UNUSED GIOCondition condition,
+                      gpointer user_data)
+{
+    struct tilda_recorder_ *recorder = user_data;
+
+    recorder->output_source = 0;
+
+    /* VTE caught up, so we can read from the child again */
+    if (flush_output (recorder) && !recorder->child_eof && recorder->child_source == 0) {
+        watch_child (recorder);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Writes the pending output to VTE. Returns FALSE if VTE cannot take all
+ * of it right now, in which case the rest is written once it can. */
+static gboolean
+flush_output (struct tilda_recorder_ *recorder)
+{
+    while (recorder->output->len > 0 && recorder->terminal_fd >= 0)
+    {
+        gssize written = write (recorder->terminal_fd, recorder->output->data,
+                                recorder->output->len);
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            if (errno == EAGAIN) {
+                if (recorder->output_source == 0) {
+                    recorder->output_source = g_unix_fd_add (recorder->terminal_fd, G_IO_OUT,
+                                                             terminal_writable_cb, recorder);
+                }
+
+                return FALSE;
+            }
+
+            break;
+        }
+
+        g_byte_array_remove_range (recorder->output, 0, (guint) written);
+    }
+
+    g_byte_array_set_size (recorder->output, 0);
+
+    /* Closing our side of the PTY lets VTE see the end of the output */
+    if (recorder->child_eof) {
+        close_terminal (recorder);
+    }
+
+    return TRUE;
+}
+
+static gboolean
+child_readable_cb (gint fd,
+                   G_GNUC_UNUSED GIOCondition condition,
+                   gpointer user_data)
+{
+    /* Only used on the GTK thread */
+    static gchar buffer[TILDA_RECORDER_READ_SIZE];
+
+    struct tilda_recorder_ *recorder = user_data;
+    gssize length;
+
+    length = read (fd, buffer, sizeof (buffer));
+
+    if (length < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return G_SOURCE_CONTINUE;
+    }
+
+    /* Reading fails with EIO once the child and all its descendants
+     * closed the PTY. */
+    if (length <= 0) {
+        recorder->child_source = 0;
+        recorder->child_eof = TRUE;
+        flush_output (recorder);
+
+        return G_SOURCE_REMOVE;
+    }
+
+    if (recorder->recording != NULL) {
+        recording_push (recorder->recording, 'o', buffer, (gsize) length);
+    }
+
+    g_byte_array_append (recorder->output, (const guint8 *) buffer, (guint) length);
+
+    /* Stop reading from the child while VTE does not keep up, so that the
+     * child is slowed down just like without the tee. */
+    if (!flush_output (recorder)) {
+        recorder->child_source = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean flush_input (struct tilda_recorder_ *recorder);
+
+static gboolean
+child_writable_cb (G_GNUC_UNUSED gint fd,
+                   G_GNUC_UNUSED GIOCondition condition,
+                   gpointer user_data)
+{
+    struct tilda_recorder_ *recorder = user_data;
+
+    recorder->input_source = 0;
+    flush_input (recorder);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+flush_input (struct tilda_recorder_ *recorder)
+{
+    gint fd = vte_pty_get_fd (recorder->child_pty);
+
+    while (recorder->input->len > 0)
+    {
+        gssize written = write (fd, recorder->input->data, recorder->input->len);
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            if (errno == EAGAIN) {
+                if (recorder->input_source == 0) {
+                    recorder->input_source = g_unix_fd_add (fd, G_IO_OUT,
+                                                            child_writable_cb, recorder);
+                }
+
+                return FALSE;
+            }
+
+            break;
+        }
+
+        g_byte_array_remove_range (recorder->input, 0, (guint) written);
+    }
+
+    g_byte_array_set_size (recorder->input, 0);
+
+    return TRUE;
+}
+
+static gboolean
+terminal_readable_cb (gint fd,
+                      G_GNUC_UNUSED GIOCondition condition,
+                      gpointer user_data)
+{
+    struct tilda_recorder_ *recorder = user_data;
+    gchar buffer[4096];
+    gssize length;
+
+    length = read (fd, buffer, sizeof (buffer));
+
+    if (length < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return G_SOURCE_CONTINUE;
+    }
+
+    if (length <= 0) {
+        recorder->terminal_source = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    if (recorder->child_pty != NULL) {
+        g_byte_array_append (recorder->input, (const guint8 *) buffer, (guint) length);
+        flush_input (recorder);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+size_allocate_cb (GtkWidget *widget,
+                  G_GNUC_UNUSED GdkRectangle *allocation,
+                  gpointer user_data)
+{
+    struct tilda_recorder_ *recorder = user_data;
+    glong rows = vte_terminal_get_row_count (VTE_TERMINAL (widget));
+    glong columns = vte_terminal_get_column_count (VTE_TERMINAL (widget));
+
+    if (rows == recorder->rows && columns == recorder->columns) {
+        return;
+    }
+
+    recorder->rows = rows;
+    recorder->columns = columns;
+
+    /* VTE only resizes its own PTY, so forward the size to the child */
+    if (recorder->child_pty != NULL) {
+        vte_pty_set_size (recorder->child_pty, (gint) rows, (gint) columns, NULL);
+    }
+
+    if (recorder->recording != NULL) {
+        gchar *size = g_strdup_printf ("%ldx%ld", columns, rows);
+
+        recording_push (recorder->recording, 'r', size, strlen (size));
+        g_free (size);
+    }
+}
+
+/* Creates the PTY that is handed to VTE. We keep the slave side and
+ * put it into raw mode, since the line discipline of the child PTY
+ * already processed the data. */
+static VtePty *
+open_terminal_pty (gint *slave_fd, GError **error)
+{
+    struct termios attributes;
+    VtePty *pty;
+    gint master;
+    gint slave;
+
+    master = posix_openpt (O_RDWR | O_NOCTTY | O_CLOEXEC);
+
+    if (master < 0 || grantpt (master) != 0 || unlockpt (master) != 0) {
+        gint saved_errno = errno;
+
+        if (master >= 0) {
+            close (master);
+        }
+
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                     _("Unable to create a pseudo terminal: %s"), g_strerror (saved_errno));
+        return NULL;
+    }
+
+    slave = open (ptsname (master), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+
+    if (slave < 0) {
+        gint saved_errno = errno;
+
+        close (master);
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                     _("Unable to create a pseudo terminal: %s"), g_strerror (saved_errno));
+        return NULL;
+    }
+
+    if (tcgetattr (slave, &attributes) == 0) {
+        cfmakeraw (&attributes);
+        tcsetattr (slave, TCSANOW, &attributes);
+    }
+
+    pty = vte_pty_new_foreign_sync (master, NULL, error);
+
+    if (pty == NULL) {
+        close (master);
+        close (slave);
+        return NULL;
+    }
+
+    *slave_fd = slave;
+
+    return pty;
+}
+
+static void
+spawn_free (TildaRecorderSpawn *spawn)
+{
+    g_object_unref (spawn->cancellable);
+    g_clear_object (&spawn->terminal_pty);
+
+    if (spawn->terminal_fd >= 0) {
+        close (spawn->terminal_fd);
+    }
+
+    g_free (spawn);
+}
+
+static void
+reap_child_cb (GPid pid,
+               G_GNUC_UNUSED gint status,
+               G_GNUC_UNUSED gpointer user_data)
+{
+    g_spawn_close_pid (pid);
+}
+
+static void
+spawn_done_cb (GObject *source_object,
+               GAsyncResult *result,
+               gpointer user_data)
+{
+    TildaRecorderSpawn *spawn = user_data;
+    struct tilda_recorder_ *recorder;
+    VteTerminal *terminal;
+    GError *error = NULL;
+    GPid pid = -1;
+    gboolean success;
+
+    success = vte_pty_spawn_finish (VTE_PTY (source_object), result, &pid, &error);
+
+    /* The terminal was closed or spawned another child in the meantime */
+    if (g_cancellable_is_cancelled (spawn->cancellable)) {
+        if (success) {
+            kill (pid, SIGHUP);
+            g_child_watch_add (pid, reap_child_cb, NULL);
+        }
+
+        g_clear_error (&error);
+        spawn_free (spawn);
+        return;
+    }
+
+    recorder = spawn->recorder;
+    terminal = VTE_TERMINAL (recorder->tt->vte_term);
+
+    if (!success) {
+        spawn->callback (terminal, -1, error, spawn->user_data);
+        g_error_free (error);
+        spawn_free (spawn);
+        return;
+    }
+
+    recorder->child_pty = g_object_ref (VTE_PTY (source_object));
+    recorder->terminal_fd = spawn->terminal_fd;
+    spawn->terminal_fd = -1;
+
+    vte_terminal_set_pty (terminal, spawn->terminal_pty);
+    vte_terminal_watch_child (terminal, pid);
+
+    recorder->terminal_source = g_unix_fd_add (recorder->terminal_fd, G_IO_IN,
+                                               terminal_readable_cb, recorder);
+    watch_child (recorder);
+
+    spawn->callback (terminal, pid, NULL, spawn->user_data);
+    spawn_free (spawn);
+}
+
+gboolean
+tilda_recorder_is_enabled (void)
+{
+    return config_getbool ("enable_recording");
+}
+
+void
+tilda_recorder_spawn_async (tilda_term *tt,
+                            const gchar *working_directory,
+                            gchar **argv,
+                            gchar **envv,
+                            GSpawnFlags spawn_flags,
+                            gint timeout,
+                            VteTerminalSpawnAsyncCallback callback,
+                            gpointer user_data)
+{
+    DEBUG_FUNCTION ("tilda_recorder_spawn_async");
+    DEBUG_ASSERT (tt != NULL);
+
+    struct tilda_recorder_ *recorder = tt->recorder;
+    TildaRecorderSpawn *spawn;
+    VtePty *child_pty;
+    GError *error = NULL;
+
+    if (recorder == NULL) {
+        recorder = g_new0 (struct tilda_recorder_, 1);
+        recorder->tt = tt;
+        recorder->terminal_fd = -1;
+        recorder->output = g_byte_array_new ();
+        recorder->input = g_byte_array_new ();
+        recorder->size_allocate_handler = g_signal_connect_after (tt->vte_term, "size-allocate",
+                                                                  G_CALLBACK (size_allocate_cb),
+                                                                  recorder);
+        tt->recorder = recorder;
+    }
+
+    /* Forget the previous child of the terminal */
+    if (recorder->cancellable != NULL) {
+        g_cancellable_cancel (recorder->cancellable);
+        g_object_unref (recorder->cancellable);
+    }
+
+    recorder->cancellable = g_cancellable_new ();
+    close_tee (recorder);
+
+    spawn = g_new0 (TildaRecorderSpawn, 1);
+    spawn->recorder = recorder;
+    spawn->cancellable = g_object_ref (recorder->cancellable);
+    spawn->terminal_fd = -1;
+    spawn->callback = callback;
+    spawn->user_data = user_data;
+
+    spawn->terminal_pty = open_terminal_pty (&spawn->terminal_fd, &error);
+    child_pty = spawn->terminal_pty != NULL ? vte_pty_new_sync (VTE_PTY_DEFAULT, NULL, &error) : NULL;
+
+    if (child_pty == NULL) {
+        callback (VTE_TERMINAL (tt->vte_term), -1, error, user_data);
+        g_error_free (error);
+        spawn_free (spawn);
+        return;
+    }
+
+    recorder->rows = vte_terminal_get_row_count (VTE_TERMINAL (tt->vte_term));
+    recorder->columns = vte_terminal_get_column_count (VTE_TERMINAL (tt->vte_term));
+
+    vte_pty_set_size (child_pty, (gint) recorder->rows, (gint) recorder->columns, NULL);
+    vte_pty_set_utf8 (child_pty, TRUE, NULL);
+
+    vte_pty_spawn_async (child_pty, working_directory, argv, envv, spawn_flags,
+                         NULL, NULL, NULL, timeout, spawn->cancellable,
+                         spawn_done_cb, spawn);
+
+    g_object_unref (child_pty);
+}
+
+VtePty *
+tilda_recorder_get_child_pty (tilda_term *tt)
+{
+    DEBUG_ASSERT (tt != NULL);
+
+    if (tt->recorder != NULL && tt->recorder->child_pty != NULL) {
+        return tt->recorder->child_pty;
+    }
+
+    return vte_terminal_get_pty (VTE_TERMINAL (tt->vte_term));
+}
+
+gboolean
+tilda_recorder_can_record (tilda_term *tt)
+{
+    DEBUG_ASSERT (tt != NULL);
+
+    return tt->recorder != NULL && tt->recorder->child_pty != NULL;
+}
+
+gboolean
+tilda_recorder_start (tilda_term *tt, GError **error)
+{
+    DEBUG_FUNCTION ("tilda_recorder_start");
+    DEBUG_ASSERT (tt != NULL);
+
+    struct tilda_recorder_ *recorder = tt->recorder;
+    TildaRecording *recording;
+    GDateTime *now;
+    gchar *directory;
+    gchar *timestamp;
+    gchar *name;
+    gchar *path;
+    FILE *file;
+
+    if (!tilda_recorder_can_record (tt)) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                     _("The tab was not started with recording enabled"));
+        return FALSE;
+    }
+
+    if (recorder->recording != NULL) {
+        return TRUE;
+    }
+
+    directory = g_build_filename (g_get_user_data_dir (), "tilda", "recordings", NULL);
+
+    if (g_mkdir_with_parents (directory, 0700) != 0) {
+        gint saved_errno = errno;
+
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                     _("Unable to create the directory %s: %s"),
+                     directory, g_strerror (saved_errno));
+        g_free (directory);
+        return FALSE;
+    }
+
+    now = g_date_time_new_now_local ();
+    timestamp = g_date_time_format (now, "%Y%m%d-%H%M%S");
+    name = g_strdup_printf ("%s-tab%u.cast", timestamp, tt->id);
+    path = g_build_filename (directory, name, NULL);
+
+    file = g_fopen (path, "w");
+
+    if (file == NULL) {
+        gint saved_errno = errno;
+
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                     _("Unable to create the file %s: %s"), path, g_strerror (saved_errno));
+    } else {
+        fprintf (file, "{\"version\": 2, \"width\": %ld, \"height\": %ld, \"timestamp\": %" G_GINT64_FORMAT ", "
+                       "\"env\": {\"TERM\": \"xterm-256color\"}}\n",
+                 recorder->columns, recorder->rows, g_date_time_to_unix (now));
+    }
+
+    g_date_time_unref (now);
+    g_free (timestamp);
+    g_free (name);
+    g_free (directory);
+
+    if (file == NULL) {
+        g_free (path);
+        return FALSE;
+    }
+
+    recording = g_new0 (TildaRecording, 1);
+    g_mutex_init (&recording->mutex);
+    g_cond_init (&recording->cond);
+    recording->ring = g_malloc (TILDA_RECORDER_RING_SIZE);
+    recording->file = file;
+    recording->path = path;
+    recording->start_time = g_get_monotonic_time ();
+    recording->thread = g_thread_new ("tilda-recorder", recording_thread, recording);
+
+    recorder->recording = recording;
+
+    tilda_terminal_update_tooltip (tt);
+
+    return TRUE;
+}
+
+/* Waits until the writer thread wrote all events, then closes the file */
+static void
+recording_free (TildaRecording *recording)
+{
+    g_mutex_lock (&recording->mutex);
+    recording->quit = TRUE;
+    g_cond_signal (&recording->cond);
+    g_mutex_unlock (&recording->mutex);
+
+    g_thread_join (recording->thread);
+
+    if (recording->dropped > 0) {
+        g_printerr (_("The recording %s misses %" G_GUINT64_FORMAT " bytes of output, "
+                      "because they could not be written fast enough\n"),
+                    recording->path, recording->dropped);
+    }
+
+    fclose (recording->file);
+    g_mutex_clear (&recording->mutex);
+    g_cond_clear (&recording->cond);
+    g_free (recording->ring);
+    g_free (recording->path);
+    g_free (recording);
+}
+
+void
+tilda_recorder_stop (tilda_term *tt)
+{
+    DEBUG_FUNCTION ("tilda_recorder_stop");
+    DEBUG_ASSERT (tt != NULL);
+
+    TildaRecording *recording;
+
+    if (tt->recorder == NULL || tt->recorder->recording == NULL) {
+        return;
+    }
+
+    recording = tt->recorder->recording;
+    tt->recorder->recording = NULL;
+
+    recording_free (recording);
+
+    tilda_terminal_update_tooltip (tt);
+}
+
+const gchar *
+tilda_recorder_get_path (tilda_term *tt)
+{
+    DEBUG_ASSERT (tt != NULL);
+
+    if (tt->recorder == NULL || tt->recorder->recording == NULL) {
+        return NULL;
+    }
+
+    return tt->recorder->recording->path;
+}
+
+void
+tilda_recorder_free (tilda_term *tt)
+{
+    DEBUG_FUNCTION ("tilda_recorder_free");
+    DEBUG_ASSERT (tt != NULL);
+
+    struct tilda_recorder_ *recorder = tt->recorder;
+
+    if (recorder == NULL) {
+        return;
+    }
+
+    if (recorder->recording != NULL) {
+        recording_free (recorder->recording);
+    }
+
+    g_signal_handler_disconnect (tt->vte_term, recorder->size_allocate_handler);
+
+    if (recorder->cancellable != NULL) {
+        g_cancellable_cancel (recorder->cancellable);
+        g_object_unref (recorder->cancellable);
+    }
+
+    close_tee (recorder);
+
+    g_byte_array_unref (recorder->output);
+    g_byte_array_unref (recorder->input);
+    g_free (recorder);
+
+    tt->recorder = NULL;
+}
@@ -0,0 +1,101 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILDA_RECORDER_H
+#define TILDA_RECORDER_H
+
+#include "tilda_terminal.h"
+
+#include <glib.h>
+#include <vte/vte.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Records the output of terminals into asciicast v2 files.
+ *
+ * Normally VTE reads the output of the shell directly from the PTY. If the
+ * "enable_recording" option is set, the shell is spawned on a PTY that is
+ * owned by tilda instead, and tilda copies the data between this PTY and a
+ * second PTY that is handed to VTE. This tee allows to record the output of
+ * each tab.
+ *
+ * While a tab is recorded, its output is put into a bounded ring buffer
+ * together with a timestamp. A writer thread formats the asciicast events
+ * and writes them to the file. If the disk cannot keep up and the buffer is
+ * full, output is dropped from the recording rather than slowing down the
+ * terminal. Keyboard input is not recorded.
+ */
+
+/**
+ * Returns TRUE if new shells are spawned through the tee, so that they can
+ * be recorded.
+ */
+gboolean     tilda_recorder_is_enabled (void);
+
+/**
+ * Spawns a command in the terminal through the tee. This works like
+ * vte_terminal_spawn_async(), the callback is invoked once the command has
+ * been started or failed to start.
+ */
+void         tilda_recorder_spawn_async (tilda_term *tt,
+                                         const gchar *working_directory,
+                                         gchar **argv,
+                                         gchar **envv,
+                                         GSpawnFlags spawn_flags,
+                                         gint timeout,
+                                         VteTerminalSpawnAsyncCallback callback,
+                                         gpointer user_data);
+
+/**
+ * Returns the PTY that the command of the terminal runs on. This is the PTY
+ * of the tee if the command was spawned through it, and the PTY of the VTE
+ * terminal otherwise.
+ */
+VtePty      *tilda_recorder_get_child_pty (tilda_term *tt);
+
+/**
+ * Starts recording the terminal into a new file in the recordings
+ * directory. The terminal must have been spawned through the tee.
+ */
+gboolean     tilda_recorder_start (tilda_term *tt, GError **error);
+
+/**
+ * Stops the recording of the terminal and waits until all recorded output
+ * has been written.
+ */
+void         tilda_recorder_stop (tilda_term *tt);
+
+/**
+ * Returns the file the terminal is recorded to, or NULL if it is not being
+ * recorded.
+ */
+const gchar *tilda_recorder_get_path (tilda_term *tt);
+
+/**
+ * Returns TRUE if the terminal was spawned through the tee, so that it can
+ * be recorded.
+ */
+gboolean     tilda_recorder_can_record (tilda_term *tt);
+
+/**
+ * Stops the recording and closes the tee. Must be called before the
+ * terminal is freed.
+ */
+void         tilda_recorder_free (tilda_term *tt);
+
+G_END_DECLS
+
+#endif /* TILDA_RECORDER_H */
@@ -0,0 +1,203 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilda-regex-cache.h"
+
+#define PCRE2_CODE_UNIT_WIDTH 0
+#include <pcre2.h>
+
+#include <string.h>
+
+/* The number of patterns kept in the default cache */
+#define TILDA_REGEX_CACHE_DEFAULT_SIZE 32
+
+struct TildaRegexCache_
+{
+    guint capacity;
+
+    /* The entries, most recently used first */
+    GQueue *entries;
+
+    /* Maps the key of an entry to its link in entries */
+    GHashTable *links;
+};
+
+typedef struct
+{
+    gchar *key;
+
+    /* Both are compiled on first use */
+    VteRegex *vte_regex;
+    GRegex *regex;
+} TildaRegexCacheEntry;
+
+static void
+cache_entry_free (TildaRegexCacheEntry * entry)
+{
+    if (entry->vte_regex != NULL) {
+        vte_regex_unref (entry->vte_regex);
+    }
+
+    if (entry->regex != NULL) {
+        g_regex_unref (entry->regex);
+    }
+
+    g_free (entry->key);
+    g_free (entry);
+}
+
+TildaRegexCache *
+tilda_regex_cache_new (guint capacity)
+{
+    TildaRegexCache * cache = g_new0 (TildaRegexCache, 1);
+
+    cache->capacity = MAX (capacity, 1);
+    cache->entries = g_queue_new ();
+    cache->links = g_hash_table_new (g_str_hash, g_str_equal);
+
+    return cache;
+}
+
+void
+tilda_regex_cache_free (TildaRegexCache * cache)
+{
+    g_hash_table_destroy (cache->links);
+    g_queue_free_full (cache->entries, (GDestroyNotify) cache_entry_free);
+    g_free (cache);
+}
+
+TildaRegexCache *
+tilda_regex_cache_get_default (void)
+{
+    static TildaRegexCache * default_cache = NULL;
+
+    if (default_cache == NULL) {
+        default_cache = tilda_regex_cache_new (TILDA_REGEX_CACHE_DEFAULT_SIZE);
+    }
+
+    return default_cache;
+}
+
+/* Returns the entry for the arguments and marks it as the most recently
+ * used one, the least recently used entry is dropped if necessary. */
+static TildaRegexCacheEntry *
+lookup_entry (TildaRegexCache * cache,
+              const gchar * text,
+              gboolean is_regex,
+              gboolean match_case)
+{
+    TildaRegexCacheEntry * entry;
+    GList * link;
+    gchar * key;
+
+    key = g_strdup_printf ("%c%c%s", is_regex ? 'r' : 's', match_case ? 'c' : 'i', text);
+    link = g_hash_table_lookup (cache->links, key);
+
+    if (link != NULL) {
+        g_free (key);
+        g_queue_unlink (cache->entries, link);
+        g_queue_push_head_link (cache->entries, link);
+        return link->data;
+    }
+
+    if (g_queue_get_length (cache->entries) >= cache->capacity) {
+        entry = g_queue_pop_tail (cache->entries);
+        g_hash_table_remove (cache->links, entry->key);
+        cache_entry_free (entry);
+    }
+
+    entry = g_new0 (TildaRegexCacheEntry, 1);
+    entry->key = key;
+
+    g_queue_push_head (cache->entries, entry);
+    g_hash_table_insert (cache->links, entry->key, cache->entries->head);
+
+    return entry;
+}
+
+static gchar *
+get_pattern (const gchar * text, gboolean is_regex)
+{
+    return is_regex ? g_strdup (text) : g_regex_escape_string (text, -1);
+}
+
+VteRegex *
+tilda_regex_cache_get_vte_regex (TildaRegexCache * cache,
+                                 const gchar * text,
+                                 gboolean is_regex,
+                                 gboolean match_case,
+                                 GError ** error)
+{
+    TildaRegexCacheEntry * entry;
+    guint32 compile_flags;
+    gchar * pattern;
+
+    entry = lookup_entry (cache, text, is_regex, match_case);
+
+    if (entry->vte_regex == NULL) {
+        compile_flags = PCRE2_MULTILINE;
+
+        if (!match_case) {
+            compile_flags |= PCRE2_CASELESS;
+        }
+
+        pattern = get_pattern (text, is_regex);
+        entry->vte_regex = vte_regex_new_for_search (pattern, (gssize) strlen (pattern),
+                                                     compile_flags, error);
+        g_free (pattern);
+
+        if (entry->vte_regex == NULL) {
+            return NULL;
+        }
+
+        /* The JIT is only an optimization, the regex works without it */
+        vte_regex_jit (entry->vte_regex, PCRE2_JIT_COMPLETE, NULL);
+    }
+
+    return vte_regex_ref (entry->vte_regex);
+}
+
+GRegex *
+tilda_regex_cache_get_regex (TildaRegexCache * cache,
+                             const gchar * text,
+                             gboolean is_regex,
+                             gboolean match_case,
+                             GError ** error)
+{
+    TildaRegexCacheEntry * entry;
+    GRegexCompileFlags compile_flags;
+    gchar * pattern;
+
+    entry = lookup_entry (cache, text, is_regex, match_case);
+
+    if (entry->regex == NULL) {
+        /* G_REGEX_OPTIMIZE enables the JIT compiler */
+        compile_flags = G_REGEX_MULTILINE | G_REGEX_OPTIMIZE;
+
+        if (!match_case) {
+            compile_flags |= G_REGEX_CASELESS;
+        }
+
+        pattern = get_pattern (text, is_regex);
+        entry->regex = g_regex_new (pattern, compile_flags, 0, error);
+        g_free (pattern);
+
+        if (entry->regex == NULL) {
+            return NULL;
+        }
+    }
+
+    return g_regex_ref (entry->regex);
+}
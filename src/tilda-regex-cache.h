@@ -0,0 +1,86 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILDA_REGEX_CACHE_H
+#define TILDA_REGEX_CACHE_H
+
+#include <glib.h>
+#include <vte/vte.h>
+
+G_BEGIN_DECLS
+
+/**
+ * A least recently used cache of compiled search patterns.
+ *
+ * Searching while typing compiles the pattern for every key stroke, and
+ * the user often goes back to earlier patterns. The cache keeps the
+ * compiled and JIT compiled regexes of the most recently used patterns,
+ * keyed by the pattern text and the search options.
+ */
+typedef struct TildaRegexCache_ TildaRegexCache;
+
+TildaRegexCache *
+tilda_regex_cache_new (guint capacity);
+
+void
+tilda_regex_cache_free (TildaRegexCache * cache);
+
+/**
+ * tilda_regex_cache_get_default:
+ *
+ * Returns: (transfer none): The cache that is shared by the search bar and
+ * the output watchers. Must only be used from the GTK thread.
+ */
+TildaRegexCache *
+tilda_regex_cache_get_default (void);
+
+/**
+ * tilda_regex_cache_get_vte_regex:
+ * @cache: An instance of a TildaRegexCache.
+ * @text: The text entered by the user.
+ * @is_regex: Whether the text is a regular expression or a literal string.
+ * @match_case: Whether the search is case sensitive.
+ * @error: Return location for a compile error.
+ *
+ * Returns: (transfer full): A VteRegex for searching the terminal, or
+ * NULL if the pattern could not be compiled.
+ */
+VteRegex *
+tilda_regex_cache_get_vte_regex (TildaRegexCache * cache,
+                                 const gchar * text,
+                                 gboolean is_regex,
+                                 gboolean match_case,
+                                 GError ** error);
+
+/**
+ * tilda_regex_cache_get_regex:
+ *
+ * Like tilda_regex_cache_get_vte_regex() but returns a GRegex, which can
+ * be used to search text outside of a terminal. The same GRegex is
+ * returned for the same arguments as long as it stays in the cache.
+ *
+ * Returns: (transfer full): A GRegex, or NULL if the pattern could not
+ * be compiled.
+ */
+GRegex *
+tilda_regex_cache_get_regex (TildaRegexCache * cache,
+                             const gchar * text,
+                             gboolean is_regex,
+                             gboolean match_case,
+                             GError ** error);
+
+G_END_DECLS
+
+#endif /* TILDA_REGEX_CACHE_H */
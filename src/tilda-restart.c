@@ -0,0 +1,205 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilda-restart.h"
+
+#include "configsys.h"
+#include "debug.h"
+
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <string.h>
+#include <vte/vte.h>
+
+/* A command that exits within this many seconds after it was started
+ * counts as a failure. */
+#define TILDA_RESTART_MIN_UPTIME 10
+
+/* The delay before the first restart after a failure, and the maximum
+ * delay, in milliseconds. */
+#define TILDA_RESTART_INITIAL_DELAY 1000
+#define TILDA_RESTART_MAX_DELAY 60000
+
+/* The delay is randomized by up to this fraction in both directions */
+#define TILDA_RESTART_JITTER 0.2
+
+static void
+feed (tilda_term *tt, const gchar *text)
+{
+    vte_terminal_feed (VTE_TERMINAL (tt->vte_term), text, strlen (text));
+}
+
+static void
+restart (tilda_term *tt)
+{
+    tt->restart_source = 0;
+    tt->restart_deadline = 0;
+    tt->restart_count++;
+
+    feed (tt, "\r\n\r\n");
+
+    tilda_term_respawn (tt);
+    tilda_terminal_update_tooltip (tt);
+}
+
+static gboolean
+restart_tick_cb (gpointer user_data)
+{
+    tilda_term *tt = user_data;
+    gint64 remaining;
+    guint seconds;
+    gchar *message;
+
+    remaining = (tt->restart_deadline - g_get_monotonic_time ()) / 1000;
+
+    if (remaining <= 0) {
+        restart (tt);
+        return G_SOURCE_REMOVE;
+    }
+
+    /* Overwrite the previous status line */
+    seconds = (guint) ((remaining + 999) / 1000);
+    message = g_strdup_printf (ngettext ("Restarting in %u second",
+                                         "Restarting in %u seconds",
+                                         seconds),
+                               seconds);
+    feed (tt, "\r");
+    feed (tt, message);
+    feed (tt, "\033[K");
+    g_free (message);
+
+    /* Wake up again when the shown number of seconds changes */
+    tt->restart_source = g_timeout_add ((guint) (remaining - (seconds - 1) * 1000),
+                                        restart_tick_cb, tt);
+
+    return G_SOURCE_REMOVE;
+}
+
+static guint
+get_delay (guint failures)
+{
+    gdouble delay = TILDA_RESTART_INITIAL_DELAY;
+
+    for (guint i = 1; i < failures && delay < TILDA_RESTART_MAX_DELAY; i++) {
+        delay *= 2;
+    }
+
+    delay = MIN (delay, TILDA_RESTART_MAX_DELAY);
+    delay *= g_random_double_range (1.0 - TILDA_RESTART_JITTER, 1.0 + TILDA_RESTART_JITTER);
+
+    return (guint) delay;
+}
+
+void
+tilda_restart_command_started (tilda_term *tt)
+{
+    DEBUG_FUNCTION ("tilda_restart_command_started");
+    DEBUG_ASSERT (tt != NULL);
+
+    tt->restart_started_time = g_get_monotonic_time ();
+}
+
+void
+tilda_restart_command_exited (tilda_term *tt, gint status)
+{
+    DEBUG_FUNCTION ("tilda_restart_command_exited");
+    DEBUG_ASSERT (tt != NULL);
+
+    gint64 now = g_get_monotonic_time ();
+    gint64 window = (gint64) config_getint ("restart_failure_window") * G_USEC_PER_SEC;
+    gint max_failures = config_getint ("restart_max_failures");
+
+    tilda_restart_forget (tt);
+
+    tt->restart_last_status = status;
+
+    /* A command that ran for a while is healthy and is restarted right away */
+    if (now - tt->restart_started_time >= TILDA_RESTART_MIN_UPTIME * G_USEC_PER_SEC) {
+        tt->restart_failures = 0;
+        restart (tt);
+        return;
+    }
+
+    tt->restart_failures++;
+
+    if (now - tt->restart_window_start > window) {
+        tt->restart_window_start = now;
+        tt->restart_window_failures = 0;
+    }
+
+    tt->restart_window_failures++;
+
+    if (max_failures > 0 && tt->restart_window_failures >= (guint) max_failures) {
+        gchar *message;
+
+        tt->restart_gave_up = TRUE;
+
+        message = g_strdup_printf (ngettext ("The command failed %u time within %d seconds "
+                                             "and is not restarted anymore. "
+                                             "Press Enter to restart it.",
+                                             "The command failed %u times within %d seconds "
+                                             "and is not restarted anymore. "
+                                             "Press Enter to restart it.",
+                                             tt->restart_window_failures),
+                                   tt->restart_window_failures,
+                                   config_getint ("restart_failure_window"));
+        feed (tt, "\r\n\r\n");
+        feed (tt, message);
+        feed (tt, "\r\n");
+        g_free (message);
+
+        tilda_terminal_update_tooltip (tt);
+        return;
+    }
+
+    feed (tt, "\r\n\r\n");
+
+    tt->restart_deadline = now + (gint64) get_delay (tt->restart_failures) * 1000;
+    restart_tick_cb (tt);
+}
+
+gboolean
+tilda_restart_now (tilda_term *tt)
+{
+    DEBUG_FUNCTION ("tilda_restart_now");
+    DEBUG_ASSERT (tt != NULL);
+
+    if (!tt->restart_gave_up && tt->restart_source == 0) {
+        return FALSE;
+    }
+
+    tilda_restart_forget (tt);
+
+    /* The user asked for it, so start counting failures from scratch */
+    tt->restart_gave_up = FALSE;
+    tt->restart_failures = 0;
+    tt->restart_window_start = 0;
+    tt->restart_window_failures = 0;
+
+    restart (tt);
+
+    return TRUE;
+}
+
+void
+tilda_restart_forget (tilda_term *tt)
+{
+    if (tt->restart_source != 0) {
+        g_source_remove (tt->restart_source);
+        tt->restart_source = 0;
+    }
+
+    tt->restart_deadline = 0;
+}
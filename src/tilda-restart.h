@@ -0,0 +1,62 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILDA_RESTART_H
+#define TILDA_RESTART_H
+
+#include "tilda_terminal.h"
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Supervises the restart of the command of a terminal when the
+ * "command_exit" option is set to restart the command.
+ *
+ * A command that exits shortly after it was started counts as a failure.
+ * Each consecutive failure doubles the delay before the next restart, and
+ * the delay is randomized a little so that several failing tabs do not
+ * restart in lockstep. The remaining time is shown in the terminal. If
+ * the command fails "restart_max_failures" times within
+ * "restart_failure_window" seconds it is not restarted anymore, until the
+ * user presses Enter in the terminal.
+ */
+
+/**
+ * Records that the command of the terminal was started.
+ */
+void tilda_restart_command_started (tilda_term *tt);
+
+/**
+ * Handles the exit of the command of the terminal and schedules its
+ * restart.
+ */
+void tilda_restart_command_exited (tilda_term *tt, gint status);
+
+/**
+ * Restarts the command immediately if a restart is pending or if the
+ * supervisor gave up on it. Returns TRUE if the command was restarted.
+ */
+gboolean tilda_restart_now (tilda_term *tt);
+
+/**
+ * Cancels a pending restart. Must be called before the terminal is freed.
+ */
+void tilda_restart_forget (tilda_term *tt);
+
+G_END_DECLS
+
+#endif /* TILDA_RESTART_H */
@@ -0,0 +1,406 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilda-scrollback.h"
+
+#include "debug.h"
+#include "tilda_window.h"
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <gtk/gtk.h>
+#include <vte/vte.h>
+
+/* The number of bytes handed to the output stream at once, between two
+ * updates of the progress */
+#define TILDA_SCROLLBACK_CHUNK_SIZE (64 * 1024)
+
+/* The interval of progress updates in milliseconds */
+#define TILDA_SCROLLBACK_PROGRESS_INTERVAL 100
+
+/* Saves that complete within this many milliseconds show no progress dialog */
+#define TILDA_SCROLLBACK_DIALOG_DELAY 500
+
+typedef struct
+{
+    GFile *file;
+    gboolean compress;
+    GBytes *bytes;
+
+    /* The number of bytes written by the worker thread so far */
+    GMutex mutex;
+    gsize written;
+
+    GFileProgressCallback progress_callback;
+    gpointer progress_data;
+} TildaScrollbackSaveJob;
+
+static void
+save_job_free (TildaScrollbackSaveJob *job)
+{
+    g_object_unref (job->file);
+    g_bytes_unref (job->bytes);
+    g_mutex_clear (&job->mutex);
+    g_free (job);
+}
+
+static gboolean
+save_write (TildaScrollbackSaveJob *job,
+            GCancellable *cancellable,
+            GError **error)
+{
+    GFileOutputStream *file_stream;
+    GZlibCompressor *compressor = NULL;
+    GOutputStream *stream;
+    const gchar *data;
+    gsize size;
+    gsize offset = 0;
+    gboolean success = TRUE;
+
+    file_stream = g_file_replace (job->file, NULL, FALSE,
+                                  G_FILE_CREATE_PRIVATE | G_FILE_CREATE_REPLACE_DESTINATION,
+                                  cancellable, error);
+
+    if (file_stream == NULL) {
+        return FALSE;
+    }
+
+    if (job->compress) {
+        compressor = g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1);
+        stream = g_converter_output_stream_new (G_OUTPUT_STREAM (file_stream),
+                                                G_CONVERTER (compressor));
+    } else {
+        stream = g_object_ref (G_OUTPUT_STREAM (file_stream));
+    }
+
+    data = g_bytes_get_data (job->bytes, &size);
+
+    while (success && offset < size)
+    {
+        gsize length = MIN (size - offset, TILDA_SCROLLBACK_CHUNK_SIZE);
+
+        success = g_output_stream_write_all (stream, data + offset, length,
+                                             NULL, cancellable, error);
+        offset += length;
+
+        g_mutex_lock (&job->mutex);
+        job->written = offset;
+        g_mutex_unlock (&job->mutex);
+    }
+
+    if (success) {
+        success = g_output_stream_close (stream, cancellable, error);
+    } else {
+        /* Closing the file with a cancelled cancellable discards the
+         * partially written file and keeps an existing file intact. */
+        GCancellable *abort = g_cancellable_new ();
+
+        g_cancellable_cancel (abort);
+        g_output_stream_close (G_OUTPUT_STREAM (file_stream), abort, NULL);
+        g_object_unref (abort);
+    }
+
+    g_object_unref (stream);
+    g_clear_object (&compressor);
+    g_object_unref (file_stream);
+
+    return success;
+}
+
+static void
+save_thread (GTask *task,
+             G_GNUC_UNUSED gpointer source_object,
+             gpointer task_data,
+             GCancellable *cancellable)
+{
+    TildaScrollbackSaveJob *job = task_data;
+    GError *error = NULL;
+
+    if (!save_write (job, cancellable, &error)) {
+        g_task_return_error (task, error);
+        return;
+    }
+
+    g_task_return_boolean (task, TRUE);
+}
+
+static gboolean
+save_progress_cb (gpointer user_data)
+{
+    GTask *task = user_data;
+    TildaScrollbackSaveJob *job = g_task_get_task_data (task);
+    gsize written;
+
+    if (g_task_get_completed (task)) {
+        return G_SOURCE_REMOVE;
+    }
+
+    g_mutex_lock (&job->mutex);
+    written = job->written;
+    g_mutex_unlock (&job->mutex);
+
+    job->progress_callback ((goffset) written,
+                            (goffset) g_bytes_get_size (job->bytes),
+                            job->progress_data);
+
+    return G_SOURCE_CONTINUE;
+}
+
+void
+tilda_scrollback_save_async (tilda_term *tt,
+                             const gchar *path,
+                             gboolean compress,
+                             GCancellable *cancellable,
+                             GFileProgressCallback progress_callback,
+                             gpointer progress_data,
+                             GAsyncReadyCallback callback,
+                             gpointer user_data)
+{
+    DEBUG_FUNCTION ("tilda_scrollback_save_async");
+    DEBUG_ASSERT (tt != NULL);
+    DEBUG_ASSERT (path != NULL);
+
+    TildaScrollbackSaveJob *job;
+    GOutputStream *stream;
+    GError *error = NULL;
+    GTask *task;
+
+    task = g_task_new (NULL, cancellable, callback, user_data);
+    g_task_set_source_tag (task, tilda_scrollback_save_async);
+
+    /* The snapshot has to be taken on the GTK thread, since VTE is not
+     * thread safe. Writing into memory is fast, the slow part is left to
+     * the worker thread. */
+    stream = g_memory_output_stream_new_resizable ();
+
+    if (!vte_terminal_write_contents_sync (VTE_TERMINAL (tt->vte_term), stream,
+                                           VTE_WRITE_DEFAULT, cancellable, &error)
+        || !g_output_stream_close (stream, cancellable, &error))
+    {
+        g_task_return_error (task, error);
+        g_object_unref (stream);
+        g_object_unref (task);
+        return;
+    }
+
+    job = g_new0 (TildaScrollbackSaveJob, 1);
+    job->file = g_file_new_for_path (path);
+    job->compress = compress;
+    job->bytes = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (stream));
+    job->progress_callback = progress_callback;
+    job->progress_data = progress_data;
+    g_mutex_init (&job->mutex);
+
+    g_object_unref (stream);
+
+    g_task_set_task_data (task, job, (GDestroyNotify) save_job_free);
+
+    if (progress_callback != NULL) {
+        g_timeout_add_full (G_PRIORITY_DEFAULT, TILDA_SCROLLBACK_PROGRESS_INTERVAL,
+                            save_progress_cb, g_object_ref (task), g_object_unref);
+    }
+
+    g_task_run_in_thread (task, save_thread);
+    g_object_unref (task);
+}
+
+gboolean
+tilda_scrollback_save_finish (GAsyncResult *result,
+                              guint64 *bytes_saved,
+                              GError **error)
+{
+    DEBUG_FUNCTION ("tilda_scrollback_save_finish");
+    DEBUG_ASSERT (g_task_is_valid (result, NULL));
+
+    TildaScrollbackSaveJob *job;
+
+    if (!g_task_propagate_boolean (G_TASK (result), error)) {
+        return FALSE;
+    }
+
+    job = g_task_get_task_data (G_TASK (result));
+
+    if (bytes_saved != NULL) {
+        *bytes_saved = g_bytes_get_size (job->bytes);
+    }
+
+    return TRUE;
+}
+
+/* The state of a save that was started from the user interface */
+typedef struct
+{
+    GCancellable *cancellable;
+    GtkWindow *parent;
+    GtkWidget *dialog;
+    GtkWidget *progress;
+    guint dialog_source;
+} TildaScrollbackSaveDialog;
+
+static void
+progress_dialog_response_cb (G_GNUC_UNUSED GtkDialog *dialog,
+                             G_GNUC_UNUSED gint response_id,
+                             TildaScrollbackSaveDialog *state)
+{
+    g_cancellable_cancel (state->cancellable);
+}
+
+static gboolean
+show_progress_dialog_cb (gpointer user_data)
+{
+    TildaScrollbackSaveDialog *state = user_data;
+    GtkWidget *content;
+
+    state->dialog_source = 0;
+
+    state->dialog = gtk_dialog_new_with_buttons (_("Saving Scrollback"), state->parent,
+                                                 GTK_DIALOG_DESTROY_WITH_PARENT,
+                                                 _("_Cancel"), GTK_RESPONSE_CANCEL,
+                                                 NULL);
+    g_object_add_weak_pointer (G_OBJECT (state->dialog), (gpointer *) &state->dialog);
+
+    state->progress = gtk_progress_bar_new ();
+    gtk_progress_bar_set_show_text (GTK_PROGRESS_BAR (state->progress), TRUE);
+    gtk_widget_set_margin_start (state->progress, 12);
+    gtk_widget_set_margin_end (state->progress, 12);
+    gtk_widget_set_margin_top (state->progress, 12);
+    gtk_widget_set_margin_bottom (state->progress, 12);
+
+    content = gtk_dialog_get_content_area (GTK_DIALOG (state->dialog));
+    gtk_container_add (GTK_CONTAINER (content), state->progress);
+
+    g_signal_connect (state->dialog, "response",
+                      G_CALLBACK (progress_dialog_response_cb), state);
+
+    gtk_window_set_keep_above (GTK_WINDOW (state->dialog), TRUE);
+    gtk_widget_show_all (state->dialog);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+save_progress_dialog_cb (goffset current_num_bytes,
+                         goffset total_num_bytes,
+                         gpointer user_data)
+{
+    TildaScrollbackSaveDialog *state = user_data;
+    gchar *current;
+    gchar *total;
+    gchar *text;
+
+    if (state->dialog == NULL || total_num_bytes <= 0) {
+        return;
+    }
+
+    current = g_format_size ((guint64) current_num_bytes);
+    total = g_format_size ((guint64) total_num_bytes);
+    text = g_strdup_printf (_("Saved %s of %s"), current, total);
+
+    gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (state->progress),
+                                   (gdouble) current_num_bytes / (gdouble) total_num_bytes);
+    gtk_progress_bar_set_text (GTK_PROGRESS_BAR (state->progress), text);
+
+    g_free (current);
+    g_free (total);
+    g_free (text);
+}
+
+static void
+save_dialog_done_cb (G_GNUC_UNUSED GObject *source_object,
+                     GAsyncResult *result,
+                     gpointer user_data)
+{
+    TildaScrollbackSaveDialog *state = user_data;
+    GError *error = NULL;
+
+    if (!tilda_scrollback_save_finish (result, NULL, &error)) {
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            g_printerr (_("Unable to save the scrollback: %s\n"), error->message);
+        }
+
+        g_error_free (error);
+    }
+
+    if (state->dialog_source != 0) {
+        g_source_remove (state->dialog_source);
+    }
+
+    if (state->dialog != NULL) {
+        g_object_remove_weak_pointer (G_OBJECT (state->dialog), (gpointer *) &state->dialog);
+        gtk_widget_destroy (state->dialog);
+    }
+
+    g_object_unref (state->cancellable);
+    g_free (state);
+}
+
+void
+tilda_scrollback_save_with_dialog (tilda_term *tt)
+{
+    DEBUG_FUNCTION ("tilda_scrollback_save_with_dialog");
+    DEBUG_ASSERT (tt != NULL);
+
+    TildaScrollbackSaveDialog *state;
+    GtkWidget *chooser;
+    GDateTime *now;
+    gchar *name;
+    gchar *path = NULL;
+
+    chooser = gtk_file_chooser_dialog_new (_("Save Scrollback"),
+                                           GTK_WINDOW (tt->tw->window),
+                                           GTK_FILE_CHOOSER_ACTION_SAVE,
+                                           _("_Cancel"), GTK_RESPONSE_CANCEL,
+                                           _("_Save"), GTK_RESPONSE_ACCEPT,
+                                           NULL);
+
+    gtk_file_chooser_set_do_overwrite_confirmation (GTK_FILE_CHOOSER (chooser), TRUE);
+
+    now = g_date_time_new_now_local ();
+    name = g_date_time_format (now, "tilda-scrollback-%Y%m%d-%H%M%S.txt");
+    gtk_file_chooser_set_current_name (GTK_FILE_CHOOSER (chooser), name);
+    g_date_time_unref (now);
+    g_free (name);
+
+    /* Keep tilda from hiding while the dialog has the focus */
+    tt->tw->disable_auto_hide = TRUE;
+
+    gtk_window_set_keep_above (GTK_WINDOW (chooser), TRUE);
+
+    if (gtk_dialog_run (GTK_DIALOG (chooser)) == GTK_RESPONSE_ACCEPT) {
+        path = gtk_file_chooser_get_filename (GTK_FILE_CHOOSER (chooser));
+    }
+
+    gtk_widget_destroy (chooser);
+
+    tt->tw->disable_auto_hide = FALSE;
+
+    if (path == NULL) {
+        return;
+    }
+
+    state = g_new0 (TildaScrollbackSaveDialog, 1);
+    state->cancellable = g_cancellable_new ();
+    state->parent = GTK_WINDOW (tt->tw->window);
+    state->dialog_source = g_timeout_add (TILDA_SCROLLBACK_DIALOG_DELAY,
+                                          show_progress_dialog_cb, state);
+
+    tilda_scrollback_save_async (tt, path, g_str_has_suffix (path, ".gz"),
+                                 state->cancellable,
+                                 save_progress_dialog_cb, state,
+                                 save_dialog_done_cb, state);
+
+    g_free (path);
+}
@@ -0,0 +1,69 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILDA_SCROLLBACK_H
+#define TILDA_SCROLLBACK_H
+
+#include "tilda_terminal.h"
+
+#include <gio/gio.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Saves the scrollback of a terminal to a file.
+ *
+ * The text of the terminal is copied into memory on the GTK thread, which
+ * is fast even for long histories. Compressing and writing it to the file
+ * then happens in a worker thread.
+ */
+
+/**
+ * Saves the scrollback of the terminal to path, compressed with gzip if
+ * compress is TRUE. The callback is invoked on the GTK thread once the
+ * file was written, the cancellable may be used to abort the save.
+ *
+ * If progress_callback is not NULL, it is called periodically on the GTK
+ * thread with the number of bytes of text written so far and the total,
+ * but never after the save has completed.
+ */
+void     tilda_scrollback_save_async (tilda_term *tt,
+                                      const gchar *path,
+                                      gboolean compress,
+                                      GCancellable *cancellable,
+                                      GFileProgressCallback progress_callback,
+                                      gpointer progress_data,
+                                      GAsyncReadyCallback callback,
+                                      gpointer user_data);
+
+/**
+ * Finishes a save started with tilda_scrollback_save_async(). On success
+ * the number of bytes of text that were saved is stored in bytes_saved.
+ */
+gboolean tilda_scrollback_save_finish (GAsyncResult *result,
+                                       guint64 *bytes_saved,
+                                       GError **error);
+
+/**
+ * Asks the user for a file name and saves the scrollback of the terminal
+ * to it. Files ending in ".gz" are compressed. A progress dialog is shown
+ * if the save takes a while.
+ */
+void     tilda_scrollback_save_with_dialog (tilda_term *tt);
+
+G_END_DECLS
+
+#endif /* TILDA_SCROLLBACK_H */
@@ -0,0 +1,551 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilda-search-all.h"
+
+#include "debug.h"
+#include "tilda-search-box.h"
+#include "tilda_terminal.h"
+
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <gtk/gtk.h>
+#include <string.h>
+#include <vte/vte.h>
+
+/* The maximum number of matches that are shown in the results list */
+#define TILDA_SEARCH_ALL_MAX_RESULTS 1000
+
+/* How often the results list is updated while searching, in ms */
+#define TILDA_SEARCH_ALL_UPDATE_INTERVAL 50
+
+/* The maximum number of matches that are added to the list per update */
+#define TILDA_SEARCH_ALL_BATCH_SIZE 100
+
+/* The number of characters shown before and after a match */
+#define TILDA_SEARCH_ALL_CONTEXT 40
+
+struct tilda_search_all_
+{
+    tilda_window *tw;
+
+    /* Searches the snapshots of the tabs, one job per tab */
+    GThreadPool *pool;
+
+    /* Incremented for every search. Workers and results that belong to
+     * an older generation are stale and are discarded. */
+    gint generation;
+
+    /* The number of matches found by the workers in this generation */
+    gint found;
+
+    GRegex *regex;
+
+    /* The ids of the tabs that still have to be snapshotted */
+    GQueue *pending_tabs;
+    guint snapshot_source;
+
+    /* TildaSearchAllResult items passed from the workers to the GTK thread */
+    GAsyncQueue *results;
+    guint update_source;
+
+    guint tabs_total;
+    guint tabs_done;
+    guint matches;
+};
+
+typedef struct
+{
+    struct tilda_search_all_ *search;
+    gint generation;
+    GRegex *regex;
+
+    guint tab_id;
+    gchar *title;
+
+    /* The text of the tab as written by vte_terminal_write_contents_sync */
+    GBytes *text;
+
+    /* The number of columns and the first row of the terminal at the
+     * time of the snapshot, used to map lines of the text to rows. */
+    glong columns;
+    glong first_row;
+} TildaSearchAllJob;
+
+typedef struct
+{
+    gint generation;
+    guint tab_id;
+    glong row;
+
+    /* The text of the list entry, or NULL if this marks that the
+     * search of the tab is complete. */
+    gchar *markup;
+} TildaSearchAllResult;
+
+static void
+search_job_free (TildaSearchAllJob *job)
+{
+    g_regex_unref (job->regex);
+    g_free (job->title);
+    g_bytes_unref (job->text);
+    g_free (job);
+}
+
+static void
+search_result_free (TildaSearchAllResult *result)
+{
+    g_free (result->markup);
+    g_free (result);
+}
+
+static gboolean
+is_stale (TildaSearchAllJob *job)
+{
+    return g_atomic_int_get (&job->search->generation) != job->generation;
+}
+
+static void
+push_result (TildaSearchAllJob *job, glong row, gchar *markup)
+{
+    TildaSearchAllResult *result = g_new0 (TildaSearchAllResult, 1);
+
+    result->generation = job->generation;
+    result->tab_id = job->tab_id;
+    result->row = row;
+    result->markup = markup;
+
+    g_async_queue_push (job->search->results, result);
+}
+
+static glong
+char_width (gunichar c)
+{
+    if (g_unichar_iszerowidth (c)) {
+        return 0;
+    }
+
+    return g_unichar_iswide (c) ? 2 : 1;
+}
+
+static glong
+text_width (const gchar *start, const gchar *end)
+{
+    glong width = 0;
+
+    for (const gchar *p = start; p < end; p = g_utf8_next_char (p)) {
+        width += char_width (g_utf8_get_char (p));
+    }
+
+    return width;
+}
+
+/* Counts the rows that the lines between start and end occupy in the
+ * terminal. The snapshot contains one line per logical line, lines that
+ * are wider than the terminal wrap into several rows. */
+static glong
+count_rows (const gchar *start, const gchar *end, glong columns)
+{
+    glong rows = 0;
+    const gchar *line = start;
+    const gchar *newline;
+
+    while (line < end && (newline = memchr (line, '\n', (gsize) (end - line))) != NULL) {
+        rows += MAX (1, (text_width (line, newline) + columns - 1) / columns);
+        line = newline + 1;
+    }
+
+    return rows;
+}
+
+static gchar *
+format_match (TildaSearchAllJob *job,
+              glong line_number,
+              const gchar *line, const gchar *line_end,
+              const gchar *match, const gchar *match_end)
+{
+    const gchar *start = match;
+    const gchar *end;
+    gchar *before;
+    gchar *hit;
+    gchar *after;
+    gchar *location;
+    gchar *markup;
+
+    match_end = MIN (MAX (match_end, match), line_end);
+    end = match_end;
+
+    for (gint i = 0; i < TILDA_SEARCH_ALL_CONTEXT && start > line; i++) {
+        start = g_utf8_prev_char (start);
+    }
+
+    for (gint i = 0; i < TILDA_SEARCH_ALL_CONTEXT && end < line_end; i++) {
+        end = g_utf8_next_char (end);
+    }
+
+    before = g_markup_escape_text (start, match - start);
+    hit = g_markup_escape_text (match, match_end - match);
+    after = g_markup_escape_text (match_end, end - match_end);
+
+    location = g_markup_printf_escaped ("<i>%s:%ld:</i> ", job->title, line_number);
+    markup = g_strdup_printf ("%s%s%s<b>%s</b>%s%s", location,
+                              start > line ? "..." : "",
+                              before, hit, after,
+                              end < line_end ? "..." : "");
+
+    g_free (location);
+    g_free (before);
+    g_free (hit);
+    g_free (after);
+
+    return markup;
+}
+
+static void
+search_tab (TildaSearchAllJob *job, G_GNUC_UNUSED gpointer user_data)
+{
+    GMatchInfo *match_info = NULL;
+    const gchar *text;
+    gsize length;
+
+    /* The offset and row of the line up to which rows were counted */
+    gsize counted = 0;
+    glong row = job->first_row;
+
+    /* Only the first match of each line is reported */
+    gsize next_line = 0;
+
+    glong line_number = 0;
+
+    if (is_stale (job)) {
+        search_job_free (job);
+        return;
+    }
+
+    text = g_bytes_get_data (job->text, &length);
+
+    if (text == NULL) {
+        push_result (job, 0, NULL);
+        search_job_free (job);
+        return;
+    }
+
+    g_regex_match_full (job->regex, text, (gssize) length, 0, 0, &match_info, NULL);
+
+    while (g_match_info_matches (match_info) && !is_stale (job))
+    {
+        gint start;
+        gint end;
+
+        g_match_info_fetch_pos (match_info, 0, &start, &end);
+
+        if ((gsize) start >= next_line) {
+            const gchar *line = text + start;
+            const gchar *line_end;
+
+            while (line > text + counted && line[-1] != '\n') {
+                line--;
+            }
+
+            line_end = memchr (text + start, '\n', length - (gsize) start);
+
+            if (line_end == NULL) {
+                line_end = text + length;
+            }
+
+            for (const gchar *p = text + counted; p < line; p++) {
+                line_number += *p == '\n';
+            }
+
+            row += count_rows (text + counted, line, job->columns);
+            counted = (gsize) (line - text);
+            next_line = (gsize) (line_end - text) + 1;
+
+            push_result (job,
+                         row + text_width (line, text + start) / job->columns,
+                         format_match (job, line_number + 1,
+                                       line, line_end, text + start, text + end));
+
+            if (g_atomic_int_add (&job->search->found, 1) + 1 >= TILDA_SEARCH_ALL_MAX_RESULTS) {
+                break;
+            }
+        }
+
+        g_match_info_next (match_info, NULL);
+    }
+
+    g_match_info_free (match_info);
+
+    push_result (job, 0, NULL);
+    search_job_free (job);
+}
+
+static tilda_term *
+find_term (tilda_window *tw, guint tab_id)
+{
+    for (GList *item = tw->terms; item != NULL; item = item->next)
+    {
+        if (TILDA_TERM (item->data)->id == tab_id) {
+            return item->data;
+        }
+    }
+
+    return NULL;
+}
+
+static gboolean
+snapshot_next_tab_cb (gpointer user_data)
+{
+    struct tilda_search_all_ *search = user_data;
+    TildaSearchAllJob *job;
+    GOutputStream *stream;
+    GtkAdjustment *adjustment;
+    GtkWidget *label;
+    tilda_term *tt;
+
+    if (g_queue_is_empty (search->pending_tabs)) {
+        search->snapshot_source = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    tt = find_term (search->tw, GPOINTER_TO_UINT (g_queue_pop_head (search->pending_tabs)));
+
+    if (tt == NULL) {
+        search->tabs_done++;
+        return G_SOURCE_CONTINUE;
+    }
+
+    /* VTE is not thread safe, so the text is copied here. Only one tab is
+     * copied per main loop iteration to keep the window responsive. */
+    stream = g_memory_output_stream_new_resizable ();
+
+    if (!vte_terminal_write_contents_sync (VTE_TERMINAL (tt->vte_term), stream,
+                                           VTE_WRITE_DEFAULT, NULL, NULL)
+        || !g_output_stream_close (stream, NULL, NULL))
+    {
+        g_object_unref (stream);
+        search->tabs_done++;
+        return G_SOURCE_CONTINUE;
+    }
+
+    adjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (tt->vte_term));
+    label = gtk_notebook_get_tab_label (GTK_NOTEBOOK (search->tw->notebook), tt->hbox);
+
+    job = g_new0 (TildaSearchAllJob, 1);
+    job->search = search;
+    job->generation = search->generation;
+    job->regex = g_regex_ref (search->regex);
+    job->tab_id = tt->id;
+    job->title = g_strdup (GTK_IS_LABEL (label) ? gtk_label_get_text (GTK_LABEL (label)) : "");
+    job->text = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (stream));
+    job->columns = MAX (1, vte_terminal_get_column_count (VTE_TERMINAL (tt->vte_term)));
+    job->first_row = (glong) gtk_adjustment_get_lower (adjustment);
+
+    g_object_unref (stream);
+
+    g_thread_pool_push (search->pool, job, NULL);
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+update_status (struct tilda_search_all_ *search)
+{
+    TildaSearchBox *box = TILDA_SEARCH_BOX (search->tw->search);
+    gchar *status;
+
+    if (search->tabs_done < search->tabs_total) {
+        status = g_strdup_printf (_("Searching %u of %u tabs..."),
+                                  search->tabs_done + 1, search->tabs_total);
+    } else if (search->matches >= TILDA_SEARCH_ALL_MAX_RESULTS) {
+        status = g_strdup_printf (_("Showing the first %u matches"), search->matches);
+    } else if (search->matches == 0) {
+        status = g_strdup (_("Search term not found in any tab."));
+    } else {
+        status = g_strdup_printf (ngettext ("%u match", "%u matches", search->matches),
+                                  search->matches);
+    }
+
+    tilda_search_box_set_status (box, status);
+    g_free (status);
+}
+
+static gboolean
+update_results_cb (gpointer user_data)
+{
+    struct tilda_search_all_ *search = user_data;
+    TildaSearchBox *box = TILDA_SEARCH_BOX (search->tw->search);
+    TildaSearchAllResult *result;
+    gint added = 0;
+
+    while (added < TILDA_SEARCH_ALL_BATCH_SIZE
+           && (result = g_async_queue_try_pop (search->results)) != NULL)
+    {
+        if (result->generation != search->generation) {
+            /* A result of a cancelled search */
+        } else if (result->markup == NULL) {
+            search->tabs_done++;
+        } else if (search->matches < TILDA_SEARCH_ALL_MAX_RESULTS) {
+            tilda_search_box_add_result (box, result->tab_id, result->row, result->markup);
+            search->matches++;
+            added++;
+        }
+
+        search_result_free (result);
+    }
+
+    update_status (search);
+
+    if (search->tabs_done >= search->tabs_total && g_async_queue_length (search->results) <= 0) {
+        search->update_source = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+void
+tilda_search_all_start (tilda_window *tw, GRegex *regex)
+{
+    DEBUG_FUNCTION ("tilda_search_all_start");
+    DEBUG_ASSERT (tw != NULL);
+    DEBUG_ASSERT (regex != NULL);
+
+    struct tilda_search_all_ *search;
+
+    if (tw->search_all == NULL) {
+        search = g_new0 (struct tilda_search_all_, 1);
+        search->tw = tw;
+        search->pool = g_thread_pool_new ((GFunc) search_tab, NULL,
+                                          (gint) g_get_num_processors (), FALSE, NULL);
+        search->pending_tabs = g_queue_new ();
+        search->results = g_async_queue_new_full ((GDestroyNotify) search_result_free);
+
+        tw->search_all = search;
+    }
+
+    tilda_search_all_cancel (tw);
+
+    search = tw->search_all;
+    search->regex = g_regex_ref (regex);
+    search->tabs_total = 0;
+    search->tabs_done = 0;
+    search->matches = 0;
+    g_atomic_int_set (&search->found, 0);
+
+    for (GList *item = tw->terms; item != NULL; item = item->next)
+    {
+        g_queue_push_tail (search->pending_tabs, GUINT_TO_POINTER (TILDA_TERM (item->data)->id));
+        search->tabs_total++;
+    }
+
+    tilda_search_box_clear_results (TILDA_SEARCH_BOX (tw->search));
+    update_status (search);
+
+    search->snapshot_source = g_idle_add (snapshot_next_tab_cb, search);
+    search->update_source = g_timeout_add (TILDA_SEARCH_ALL_UPDATE_INTERVAL,
+                                           update_results_cb, search);
+}
+
+void
+tilda_search_all_cancel (tilda_window *tw)
+{
+    DEBUG_FUNCTION ("tilda_search_all_cancel");
+    DEBUG_ASSERT (tw != NULL);
+
+    struct tilda_search_all_ *search = tw->search_all;
+    TildaSearchAllResult *result;
+
+    if (search == NULL) {
+        return;
+    }
+
+    /* Running workers notice the new generation and stop early */
+    g_atomic_int_inc (&search->generation);
+
+    if (search->snapshot_source) {
+        g_source_remove (search->snapshot_source);
+        search->snapshot_source = 0;
+    }
+
+    if (search->update_source) {
+        g_source_remove (search->update_source);
+        search->update_source = 0;
+    }
+
+    g_queue_clear (search->pending_tabs);
+
+    while ((result = g_async_queue_try_pop (search->results)) != NULL) {
+        search_result_free (result);
+    }
+
+    if (search->regex != NULL) {
+        g_regex_unref (search->regex);
+        search->regex = NULL;
+    }
+}
+
+void
+tilda_search_all_show_result (tilda_window *tw, guint tab_id, glong row)
+{
+    DEBUG_FUNCTION ("tilda_search_all_show_result");
+    DEBUG_ASSERT (tw != NULL);
+
+    GtkAdjustment *adjustment;
+    tilda_term *tt;
+    gdouble value;
+
+    tt = find_term (tw, tab_id);
+
+    if (tt == NULL) {
+        return;
+    }
+
+    gtk_notebook_set_current_page (GTK_NOTEBOOK (tw->notebook),
+                                   gtk_notebook_page_num (GTK_NOTEBOOK (tw->notebook), tt->hbox));
+
+    /* Rows that scrolled out of the history since the search are gone,
+     * in that case we show the oldest row that still exists. */
+    adjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (tt->vte_term));
+    value = CLAMP ((gdouble) row,
+                   gtk_adjustment_get_lower (adjustment),
+                   gtk_adjustment_get_upper (adjustment) - gtk_adjustment_get_page_size (adjustment));
+
+    gtk_adjustment_set_value (adjustment, value);
+}
+
+void
+tilda_search_all_free (tilda_window *tw)
+{
+    DEBUG_FUNCTION ("tilda_search_all_free");
+    DEBUG_ASSERT (tw != NULL);
+
+    struct tilda_search_all_ *search = tw->search_all;
+
+    if (search == NULL) {
+        return;
+    }
+
+    tilda_search_all_cancel (tw);
+
+    /* Queued jobs are stale now and return immediately */
+    g_thread_pool_free (search->pool, FALSE, TRUE);
+
+    g_queue_free (search->pending_tabs);
+    g_async_queue_unref (search->results);
+    g_free (search);
+
+    tw->search_all = NULL;
+}
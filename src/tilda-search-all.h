@@ -0,0 +1,58 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILDA_SEARCH_ALL_H
+#define TILDA_SEARCH_ALL_H
+
+#include "tilda_window.h"
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Searches the scrollback of all tabs of a window.
+ *
+ * The text of each tab is copied on the GTK thread, one tab per main loop
+ * iteration, and the copies are searched on a thread pool. The matches are
+ * streamed into the results list of the search box in small batches, so
+ * that the window stays responsive even with many tabs and long histories.
+ */
+
+/**
+ * Starts searching all tabs for regex, cancelling a previous search.
+ */
+void tilda_search_all_start (tilda_window *tw, GRegex *regex);
+
+/**
+ * Cancels the running search. Matches that were already found stay in the
+ * results list.
+ */
+void tilda_search_all_cancel (tilda_window *tw);
+
+/**
+ * Scrolls the tab with the id tab_id to row and makes it the current tab.
+ * Does nothing if the tab was closed in the meantime.
+ */
+void tilda_search_all_show_result (tilda_window *tw, guint tab_id, glong row);
+
+/**
+ * Cancels the running search and waits for the worker threads.
+ */
+void tilda_search_all_free (tilda_window *tw);
+
+G_END_DECLS
+
+#endif /* TILDA_SEARCH_ALL_H */
@@ -18,8 +18,7 @@
 #include "tilda-search-box.h"
 #include "tilda-enum-types.h"
 
-#define PCRE2_CODE_UNIT_WIDTH 0
-#include <pcre2.h>
+#include "tilda-regex-cache.h"
 
 #define GRESOURCE "/org/tilda/"
 
@@ -33,9 +32,21 @@ struct _TildaSearchBox
   GtkWidget            *button_prev;
   GtkWidget            *check_match_case;
   GtkWidget            *check_regex;
+  GtkWidget            *check_all_tabs;
+  GtkWidget            *status_label;
+  GtkWidget            *results_window;
+  GtkWidget            *results_list;
 
   TildaSearchDirection  last_direction;
   gboolean              last_search_successful;
+
+  /* The tick callback that searches for the text as it is typed, so that
+   * the search runs at most once per frame. */
+  guint                 incremental_search_id;
+
+  /* TRUE while the search is refined by typing. The refinements search
+   * from the position where the incremental search started. */
+  gboolean              anchored;
 };
 
 enum
@@ -43,6 +54,10 @@ enum
   SIGNAL_SEARCH,
   SIGNAL_SEARCH_GREGEX,
   SIGNAL_FOCUS_OUT,
+  SIGNAL_SEARCH_ALL_TABS,
+  SIGNAL_RESULT_ACTIVATED,
+  SIGNAL_COUNT_MATCHES,
+  SIGNAL_REWIND,
 
   LAST_SIGNAL
 };
@@ -51,72 +66,116 @@ static guint signals[LAST_SIGNAL] = { 0 };
 
 G_DEFINE_TYPE (TildaSearchBox, tilda_search_box, GTK_TYPE_BOX)
 
+/* The location of a match in the results list */
+typedef struct
+{
+  guint tab_id;
+  glong row;
+} TildaSearchResult;
+
 static void
-search_vte_regex (TildaSearchBox       *search,
-                  TildaSearchDirection  direction)
+show_error (TildaSearchBox *search,
+            const gchar    *message)
+{
+  GtkLabel *label = GTK_LABEL (search->label);
+  gtk_label_set_text (label, message);
+  gtk_widget_set_visible (search->label, TRUE);
+}
+
+static void
+stop_counting (TildaSearchBox *box)
+{
+  g_signal_emit (box, signals[SIGNAL_COUNT_MATCHES], 0,
+                 NULL, box->last_direction);
+}
+
+static const gchar *
+get_text (TildaSearchBox *search)
+{
+  return gtk_entry_get_text (GTK_ENTRY (search->entry));
+}
+
+static void
+get_search_options (TildaSearchBox *search,
+                    gboolean       *is_regex,
+                    gboolean       *match_case)
 {
-  GtkEntry *entry;
-  GtkEntryBuffer *buffer;
   GtkToggleButton *toggle_button;
 
-  guint32 compile_flags;
-  gboolean wrap_on_search;
+  toggle_button = GTK_TOGGLE_BUTTON (search->check_regex);
+  *is_regex = gtk_toggle_button_get_active (toggle_button);
+  toggle_button = GTK_TOGGLE_BUTTON (search->check_match_case);
+  *match_case = gtk_toggle_button_get_active (toggle_button);
+}
+
+static VteRegex *
+get_vte_regex (TildaSearchBox *search)
+{
   gboolean is_regex;
   gboolean match_case;
-  const gchar *text;
-  gchar *pattern;
-  size_t pattern_length;
-  gboolean search_result;
-
   GError *error;
   VteRegex *regex;
 
-  compile_flags = 0;
-  wrap_on_search = FALSE;
-  toggle_button = GTK_TOGGLE_BUTTON (search->check_regex);
-  is_regex = gtk_toggle_button_get_active (toggle_button);
-  entry = GTK_ENTRY (search->entry);
-  buffer = GTK_ENTRY_BUFFER (gtk_entry_get_buffer (entry));
-  text = gtk_entry_buffer_get_text (buffer);
+  get_search_options (search, &is_regex, &match_case);
 
-  if (!search->last_search_successful)
-    wrap_on_search = TRUE;
+  error = NULL;
 
-  if (is_regex)
+  regex = tilda_regex_cache_get_vte_regex (tilda_regex_cache_get_default (), get_text (search),
+                                           is_regex, match_case, &error);
+
+  if (error)
     {
-      compile_flags |= PCRE2_MULTILINE;
-      pattern = g_strdup (text);
+      show_error (search, error->message);
+      g_error_free (error);
     }
-  else
-    pattern = g_regex_escape_string (text, -1);
-
-  pattern_length = strlen (pattern);
 
-  toggle_button = GTK_TOGGLE_BUTTON (search->check_match_case);
-  match_case = gtk_toggle_button_get_active (toggle_button);
+  return regex;
+}
 
-  if (!match_case)
-  {
-    compile_flags |= PCRE2_CASELESS;
-  }
+static GRegex *
+get_regex (TildaSearchBox *search)
+{
+  gboolean is_regex;
+  gboolean match_case;
+  GError *error;
+  GRegex *regex;
 
-  compile_flags |= PCRE2_MULTILINE;
+  get_search_options (search, &is_regex, &match_case);
 
   error = NULL;
 
-  regex = vte_regex_new_for_search (pattern, pattern_length, compile_flags, &error);
-
-  g_free (pattern);
+  regex = tilda_regex_cache_get_regex (tilda_regex_cache_get_default (), get_text (search),
+                                       is_regex, match_case, &error);
 
   if (error)
     {
-      GtkLabel *label = GTK_LABEL (search->label);
-      gtk_label_set_text (label, error->message);
-      gtk_widget_set_visible (search->label, TRUE);
+      show_error (search, error->message);
       g_error_free (error);
-      return;
     }
 
+  return regex;
+}
+
+static void
+search_vte_regex (TildaSearchBox       *search,
+                  TildaSearchDirection  direction)
+{
+  gboolean wrap_on_search;
+  gboolean search_result;
+
+  VteRegex *regex;
+  GRegex *count_regex;
+
+  wrap_on_search = FALSE;
+
+  if (!search->last_search_successful)
+    wrap_on_search = TRUE;
+
+  regex = get_vte_regex (search);
+
+  if (regex == NULL)
+    return;
+
   g_signal_emit (search, signals[SIGNAL_SEARCH], 0,
                  regex, direction, wrap_on_search, &search_result);
 
@@ -126,12 +185,49 @@ search_vte_regex (TildaSearchBox       *search,
   search->last_search_successful = search_result;
 
   vte_regex_unref (regex);
+
+  count_regex = get_regex (search);
+
+  if (count_regex == NULL)
+    return;
+
+  g_signal_emit (search, signals[SIGNAL_COUNT_MATCHES], 0,
+                 count_regex, direction);
+
+  g_regex_unref (count_regex);
+}
+
+static void
+search_all_tabs (TildaSearchBox *search)
+{
+  GRegex *regex;
+
+  if (get_text (search)[0] == '\0')
+    return;
+
+  regex = get_regex (search);
+
+  if (regex == NULL)
+    return;
+
+  gtk_widget_hide (search->label);
+
+  g_signal_emit (search, signals[SIGNAL_SEARCH_ALL_TABS], 0, regex);
+
+  g_regex_unref (regex);
 }
 
 static void
 search (TildaSearchBox       *search,
         TildaSearchDirection  direction)
 {
+  GtkToggleButton *toggle_button;
+
+  toggle_button = GTK_TOGGLE_BUTTON (search->check_all_tabs);
+
+  if (gtk_toggle_button_get_active (toggle_button))
+    search_all_tabs (search);
+  else
     search_vte_regex (search, direction);
 }
 
@@ -145,6 +241,7 @@ entry_key_press_cb (TildaSearchBox *box,
   event_key = (GdkEventKey*) event;
 
   if (event_key->keyval == GDK_KEY_Return) {
+    box->anchored = FALSE;
     search (box, box->last_direction);
     return GDK_EVENT_STOP;
   }
@@ -154,6 +251,8 @@ entry_key_press_cb (TildaSearchBox *box,
     {
       if (gtk_widget_has_focus (box->entry))
         {
+          box->anchored = FALSE;
+          stop_counting (box);
           g_signal_emit (box, signals[SIGNAL_FOCUS_OUT], 0);
           gtk_widget_set_visible (GTK_WIDGET (box), FALSE);
 
@@ -164,6 +263,38 @@ entry_key_press_cb (TildaSearchBox *box,
   return GDK_EVENT_PROPAGATE;
 }
 
+static gboolean
+incremental_search_cb (GtkWidget     *widget,
+                       GdkFrameClock *frame_clock,
+                       gpointer       user_data)
+{
+  TildaSearchBox *box = TILDA_SEARCH_BOX (user_data);
+  GtkToggleButton *toggle_button;
+
+  box->incremental_search_id = 0;
+
+  /* Searching all tabs is too expensive to do on every key stroke */
+  toggle_button = GTK_TOGGLE_BUTTON (box->check_all_tabs);
+
+  if (gtk_toggle_button_get_active (toggle_button))
+    return G_SOURCE_REMOVE;
+
+  if (get_text (box)[0] == '\0')
+    {
+      stop_counting (box);
+      return G_SOURCE_REMOVE;
+    }
+
+  /* Searching from the current match would skip the match that is
+   * already selected if it matches the refined text as well. */
+  g_signal_emit (box, signals[SIGNAL_REWIND], 0, !box->anchored);
+  box->anchored = TRUE;
+
+  search (box, box->last_direction);
+
+  return G_SOURCE_REMOVE;
+}
+
 static gboolean
 entry_changed_cb (TildaSearchBox *box,
                   GtkEditable *editable)
@@ -171,6 +302,12 @@ entry_changed_cb (TildaSearchBox *box,
   gtk_widget_hide (box->label);
   box->last_search_successful = TRUE;
 
+  /* Several changes within one frame result in a single search */
+  if (box->incremental_search_id == 0)
+    box->incremental_search_id = gtk_widget_add_tick_callback (box->entry,
+                                                               incremental_search_cb,
+                                                               box, NULL);
+
   return GDK_EVENT_STOP;
 }
 
@@ -179,6 +316,7 @@ button_next_cb (TildaSearchBox *box,
                 GtkWidget      *widget)
 {
   /* The default is to search forward */
+  box->anchored = FALSE;
   search (box, SEARCH_FORWARD);
 }
 
@@ -186,9 +324,94 @@ static void
 button_prev_cb (TildaSearchBox *box,
                 GtkWidget      *widget)
 {
+  box->anchored = FALSE;
   search (box, SEARCH_BACKWARD);
 }
 
+static void
+check_all_tabs_toggled_cb (TildaSearchBox  *box,
+                           GtkToggleButton *toggle_button)
+{
+  if (gtk_toggle_button_get_active (toggle_button))
+    {
+      stop_counting (box);
+      return;
+    }
+
+  /* Leaving the all tabs mode cancels a running search */
+  g_signal_emit (box, signals[SIGNAL_SEARCH_ALL_TABS], 0, NULL);
+
+  tilda_search_box_clear_results (box);
+}
+
+static void
+results_list_row_activated_cb (TildaSearchBox *box,
+                               GtkListBoxRow  *row,
+                               GtkListBox     *list_box)
+{
+  TildaSearchResult *result;
+
+  result = g_object_get_data (G_OBJECT (row), "tilda-search-result");
+
+  g_signal_emit (box, signals[SIGNAL_RESULT_ACTIVATED], 0,
+                 result->tab_id, result->row);
+}
+
+void
+tilda_search_box_clear_results (TildaSearchBox *box)
+{
+  GList *children;
+  GList *item;
+
+  children = gtk_container_get_children (GTK_CONTAINER (box->results_list));
+
+  for (item = children; item != NULL; item = item->next)
+    gtk_widget_destroy (GTK_WIDGET (item->data));
+
+  g_list_free (children);
+
+  gtk_widget_set_visible (box->results_window, FALSE);
+  gtk_widget_set_visible (box->status_label, FALSE);
+}
+
+void
+tilda_search_box_add_result (TildaSearchBox *box,
+                             guint           tab_id,
+                             glong           row,
+                             const gchar    *markup)
+{
+  TildaSearchResult *result;
+  GtkWidget *list_row;
+  GtkWidget *label;
+
+  result = g_new (TildaSearchResult, 1);
+  result->tab_id = tab_id;
+  result->row = row;
+
+  label = gtk_label_new (NULL);
+  gtk_label_set_markup (GTK_LABEL (label), markup);
+  gtk_label_set_ellipsize (GTK_LABEL (label), PANGO_ELLIPSIZE_END);
+  gtk_widget_set_halign (label, GTK_ALIGN_START);
+
+  list_row = gtk_list_box_row_new ();
+  gtk_container_add (GTK_CONTAINER (list_row), label);
+  g_object_set_data_full (G_OBJECT (list_row), "tilda-search-result",
+                          result, g_free);
+
+  gtk_widget_show_all (list_row);
+  gtk_list_box_insert (GTK_LIST_BOX (box->results_list), list_row, -1);
+
+  gtk_widget_set_visible (box->results_window, TRUE);
+}
+
+void
+tilda_search_box_set_status (TildaSearchBox *box,
+                             const gchar    *status)
+{
+  gtk_label_set_text (GTK_LABEL (box->status_label), status);
+  gtk_widget_set_visible (box->status_label, status != NULL);
+}
+
 void
 tilda_search_box_toggle (TildaSearchBox *box)
 {
@@ -197,7 +420,11 @@ tilda_search_box_toggle (TildaSearchBox *box)
   if (visible)
     gtk_widget_grab_focus (box->entry);
   else
-    g_signal_emit (box, signals[SIGNAL_FOCUS_OUT], 0);
+    {
+      box->anchored = FALSE;
+      stop_counting (box);
+      g_signal_emit (box, signals[SIGNAL_FOCUS_OUT], 0);
+    }
 
   gtk_widget_set_visible(GTK_WIDGET (box), visible);
 }
@@ -273,6 +500,72 @@ tilda_search_box_class_init (TildaSearchBoxClass *box_class)
     g_signal_new ("focus-out", TILDA_TYPE_SEARCH_BOX, G_SIGNAL_RUN_LAST, 0,
                   NULL, NULL, NULL, G_TYPE_NONE, 0);
 
+  /**
+   * TildaSearchBox::search-all-tabs:
+   * @widget: the widget that received the signal
+   * @regex: the regular expression entered by the user, or %NULL
+   *
+   * This signal is emitted when the user searches with the "All Tabs"
+   * option enabled. The handler should search the scrollback of all tabs
+   * and add the matches with tilda_search_box_add_result().
+   *
+   * If @regex is %NULL, the user left the all tabs mode and a running
+   * search should be cancelled.
+   */
+  signals[SIGNAL_SEARCH_ALL_TABS] =
+    g_signal_new ("search-all-tabs", TILDA_TYPE_SEARCH_BOX, G_SIGNAL_RUN_LAST, 0,
+                  NULL, NULL, NULL, G_TYPE_NONE,
+                  1, G_TYPE_REGEX);
+
+  /**
+   * TildaSearchBox::result-activated:
+   * @widget: the widget that received the signal
+   * @tab_id: the id of the tab that contains the match
+   * @row: the row of the match in the terminal
+   *
+   * This signal is emitted when the user activates one of the matches
+   * in the results list.
+   */
+  signals[SIGNAL_RESULT_ACTIVATED] =
+    g_signal_new ("result-activated", TILDA_TYPE_SEARCH_BOX, G_SIGNAL_RUN_LAST, 0,
+                  NULL, NULL, NULL, G_TYPE_NONE,
+                  2, G_TYPE_UINT, G_TYPE_LONG);
+
+  /**
+   * TildaSearchBox::count-matches:
+   * @widget: the widget that received the signal
+   * @regex: the regular expression of the search, or %NULL
+   * @direction: the direction of the search
+   *
+   * This signal is emitted after each search in the current terminal, so
+   * that the handler can count the matches and show the count with
+   * tilda_search_box_set_status(). The @regex matches the same text as
+   * the #VteRegex passed to the ::search signal.
+   *
+   * If @regex is %NULL, the search was ended and the count should be
+   * hidden.
+   */
+  signals[SIGNAL_COUNT_MATCHES] =
+    g_signal_new ("count-matches", TILDA_TYPE_SEARCH_BOX, G_SIGNAL_RUN_LAST, 0,
+                  NULL, NULL, NULL, G_TYPE_NONE,
+                  2, G_TYPE_REGEX, TILDA_TYPE_SEARCH_DIRECTION);
+
+  /**
+   * TildaSearchBox::rewind:
+   * @widget: the widget that received the signal
+   * @anchor: %TRUE if the incremental search starts here
+   *
+   * This signal is emitted before each search while the user types. If
+   * @anchor is %TRUE, the handler should remember the current position in
+   * the terminal as the anchor of the incremental search. In any case it
+   * should return to the anchor and clear the selection, so that the
+   * following search starts from the anchor.
+   */
+  signals[SIGNAL_REWIND] =
+    g_signal_new ("rewind", TILDA_TYPE_SEARCH_BOX, G_SIGNAL_RUN_LAST, 0,
+                  NULL, NULL, NULL, G_TYPE_NONE,
+                  1, G_TYPE_BOOLEAN);
+
   resource_name = GRESOURCE "tilda-search-box.ui";
   gtk_widget_class_set_template_from_resource (widget_class, resource_name);
 
@@ -288,6 +581,14 @@ tilda_search_box_class_init (TildaSearchBoxClass *box_class)
                                         check_match_case);
   gtk_widget_class_bind_template_child (widget_class, TildaSearchBox,
                                         check_regex);
+  gtk_widget_class_bind_template_child (widget_class, TildaSearchBox,
+                                        check_all_tabs);
+  gtk_widget_class_bind_template_child (widget_class, TildaSearchBox,
+                                        status_label);
+  gtk_widget_class_bind_template_child (widget_class, TildaSearchBox,
+                                        results_window);
+  gtk_widget_class_bind_template_child (widget_class, TildaSearchBox,
+                                        results_list);
 }
 
 static void
@@ -315,6 +616,10 @@ tilda_search_box_init (TildaSearchBox *box)
                             G_CALLBACK (button_next_cb), search_box);
   g_signal_connect_swapped (G_OBJECT (search_box->button_prev), "clicked",
                             G_CALLBACK (button_prev_cb), search_box);
+  g_signal_connect_swapped (G_OBJECT (search_box->check_all_tabs), "toggled",
+                            G_CALLBACK (check_all_tabs_toggled_cb), search_box);
+  g_signal_connect_swapped (G_OBJECT (search_box->results_list), "row-activated",
+                            G_CALLBACK (results_list_row_activated_cb), search_box);
 }
 
 GtkWidget*
@@ -45,6 +45,29 @@ GtkWidget *tilda_search_box_new    (void);
  */
 void       tilda_search_box_toggle (TildaSearchBox *box);
 
+/**
+ * Removes all matches from the results list of the all tabs search and
+ * hides the list.
+ */
+void       tilda_search_box_clear_results (TildaSearchBox *box);
+
+/**
+ * Appends a match of the all tabs search to the results list. The markup
+ * is shown in the list, tab_id and row are passed to the ::result-activated
+ * signal when the user activates the match.
+ */
+void       tilda_search_box_add_result (TildaSearchBox *box,
+                                        guint           tab_id,
+                                        glong           row,
+                                        const gchar    *markup);
+
+/**
+ * Shows a status message such as the number of matches below the search
+ * entry, or hides it if status is NULL.
+ */
+void       tilda_search_box_set_status (TildaSearchBox *box,
+                                        const gchar    *status);
+
 G_END_DECLS
 
 #endif
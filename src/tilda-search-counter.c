@@ -0,0 +1,454 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilda-search-counter.h"
+
+#include "debug.h"
+#include "tilda_terminal.h"
+
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <gtk/gtk.h>
+#include <string.h>
+#include <vte/vte.h>
+
+/* The time that may be spent counting per frame, in microseconds */
+#define TILDA_SEARCH_COUNTER_BUDGET 4000
+
+/* The number of rows that are read from the terminal at once */
+#define TILDA_SEARCH_COUNTER_CHUNK 200
+
+/* The number of rows after a chunk that are read as well, so that matches
+ * which start in the chunk and end after it are found */
+#define TILDA_SEARCH_COUNTER_OVERLAP 8
+
+typedef struct
+{
+    glong start_row;
+    glong end_row;
+    /* The hash of the matched text, to compare it with the selection */
+    guint hash;
+} Match;
+
+struct tilda_search_counter_
+{
+    guint tab_id;
+    GRegex *regex;
+
+    /* The rows and columns of the terminal at the start of the count */
+    glong first_row;
+    glong end_row;
+    glong columns;
+
+    /* The next row to read, the count is complete once it reaches end_row */
+    glong next_row;
+
+    /* Where the last counted match ended. Matches in the next chunk that
+     * start before it are parts of that match and are not counted. */
+    glong match_end_row;
+    glong match_end_column;
+
+    /* The matches found so far, in ascending order */
+    GArray *matches;
+
+    /* The direction of the last search and the index of the match that was
+     * selected after it, or -1 */
+    TildaSearchDirection direction;
+    gint current;
+
+    guint tick_id;
+};
+
+static tilda_term *
+find_term (tilda_window *tw, guint tab_id)
+{
+    for (GList *item = tw->terms; item != NULL; item = item->next)
+    {
+        if (TILDA_TERM (item->data)->id == tab_id) {
+            return item->data;
+        }
+    }
+
+    return NULL;
+}
+
+/* Moves row and column from position up to target as the text is laid out
+ * in the terminal: rows are separated by newlines unless they are wrapped,
+ * which happens when a row is full. */
+static void
+advance (struct tilda_search_counter_ *counter,
+         const gchar **position,
+         const gchar *target,
+         glong *row,
+         glong *column)
+{
+    const gchar *p;
+
+    for (p = *position; p < target; p = g_utf8_next_char (p))
+    {
+        gunichar c = g_utf8_get_char (p);
+        glong width;
+
+        if (c == '\n') {
+            (*row)++;
+            *column = 0;
+            continue;
+        }
+
+        if (g_unichar_iszerowidth (c)) {
+            continue;
+        }
+
+        width = g_unichar_iswide (c) ? 2 : 1;
+
+        if (*column + width > counter->columns) {
+            (*row)++;
+            *column = 0;
+        }
+
+        *column += width;
+    }
+
+    *position = p;
+}
+
+static guint
+hash_text (const gchar *text, gsize length)
+{
+    guint hash = 5381;
+
+    for (gsize i = 0; i < length; i++) {
+        hash = hash * 33 + (guchar) text[i];
+    }
+
+    return hash;
+}
+
+/* Counts the matches that start in the next block of rows */
+static void
+count_chunk (struct tilda_search_counter_ *counter, tilda_term *tt)
+{
+    GMatchInfo *match_info = NULL;
+    glong chunk_end_row;
+    glong text_end_row;
+    gchar *text;
+
+    /* The position up to which the text was laid out and its row and column */
+    const gchar *position;
+    glong row;
+    glong column = 0;
+
+    chunk_end_row = MIN (counter->next_row + TILDA_SEARCH_COUNTER_CHUNK, counter->end_row);
+    text_end_row = MIN (chunk_end_row + TILDA_SEARCH_COUNTER_OVERLAP, counter->end_row);
+    text = tilda_terminal_get_rows_text (tt, counter->next_row, text_end_row);
+
+    row = counter->next_row;
+    counter->next_row = chunk_end_row;
+
+    if (text == NULL) {
+        return;
+    }
+
+    position = text;
+
+    g_regex_match (counter->regex, text, 0, &match_info);
+
+    while (g_match_info_matches (match_info))
+    {
+        Match match;
+        gint start;
+        gint end;
+
+        g_match_info_fetch_pos (match_info, 0, &start, &end);
+
+        advance (counter, &position, text + start, &row, &column);
+
+        /* Matches that start after the chunk are counted with the next one */
+        if (row >= chunk_end_row) {
+            break;
+        }
+
+        /* The rest of a match that was counted with the previous chunk */
+        if (row < counter->match_end_row
+            || (row == counter->match_end_row && column < counter->match_end_column))
+        {
+            g_match_info_next (match_info, NULL);
+            continue;
+        }
+
+        match.start_row = row;
+        match.hash = hash_text (text + start, (gsize) (end - start));
+
+        advance (counter, &position, text + end, &row, &column);
+
+        /* A match that ends with a newline ends in the row before */
+        match.end_row = column == 0 && row > match.start_row ? row - 1 : row;
+
+        counter->match_end_row = row;
+        counter->match_end_column = column;
+
+        g_array_append_val (counter->matches, match);
+
+        g_match_info_next (match_info, NULL);
+    }
+
+    g_match_info_free (match_info);
+    g_free (text);
+}
+
+/* Returns the index of the first match that starts at or after row */
+static guint
+find_match (struct tilda_search_counter_ *counter, glong row)
+{
+    guint low = 0;
+    guint high = counter->matches->len;
+
+    while (low < high)
+    {
+        guint middle = low + (high - low) / 2;
+
+        if (g_array_index (counter->matches, Match, middle).start_row < row) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+/* Returns the index of the match that VTE selected, or -1. VTE selects
+ * the match that it found and scrolls it into view, so the selected match
+ * is one of the matches in the viewport whose text is the selected text.
+ * If several of them have that text, the search moved from the previous
+ * match to the next one in its direction, or wrapped around. */
+static gint
+find_selected_match (struct tilda_search_counter_ *counter, tilda_term *tt)
+{
+    VteTerminal *terminal = VTE_TERMINAL (tt->vte_term);
+    GtkAdjustment *adjustment;
+    gboolean compare_text = FALSE;
+    guint hash = 0;
+    glong top;
+    glong bottom;
+    guint first;
+    gint first_candidate = -1;
+    gint last_candidate = -1;
+    gint next_candidate = -1;
+    gint previous_candidate = -1;
+
+    if (!vte_terminal_get_has_selection (terminal)) {
+        return -1;
+    }
+
+#if VTE_CHECK_VERSION (0, 70, 0)
+    gchar *selection = vte_terminal_get_text_selected (terminal, VTE_FORMAT_TEXT);
+
+    if (selection != NULL) {
+        hash = hash_text (selection, strlen (selection));
+        compare_text = TRUE;
+        g_free (selection);
+    }
+#endif
+
+    adjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (tt->vte_term));
+    top = (glong) gtk_adjustment_get_value (adjustment);
+    bottom = top + (glong) gtk_adjustment_get_page_size (adjustment);
+
+    /* Matches may start above the viewport and end in it */
+    first = find_match (counter, top);
+
+    while (first > 0 && g_array_index (counter->matches, Match, first - 1).end_row >= top) {
+        first--;
+    }
+
+    for (guint i = first; i < counter->matches->len; i++)
+    {
+        Match *match = &g_array_index (counter->matches, Match, i);
+
+        if (match->start_row >= bottom) {
+            break;
+        }
+
+        if (compare_text && match->hash != hash) {
+            continue;
+        }
+
+        if (first_candidate < 0) {
+            first_candidate = (gint) i;
+        }
+
+        last_candidate = (gint) i;
+
+        if ((gint) i < counter->current) {
+            previous_candidate = (gint) i;
+        } else if ((gint) i > counter->current && next_candidate < 0) {
+            next_candidate = (gint) i;
+        }
+    }
+
+    if (counter->direction == SEARCH_FORWARD) {
+        return next_candidate >= 0 ? next_candidate : first_candidate;
+    }
+
+    return previous_candidate >= 0 ? previous_candidate : last_candidate;
+}
+
+static void
+show_count (tilda_window *tw, tilda_term *tt)
+{
+    struct tilda_search_counter_ *counter = tw->search_counter;
+    guint n_matches = counter->matches->len;
+    gchar *status;
+
+    if (counter->next_row < counter->end_row) {
+        status = g_strdup_printf (_("Counting matches: %u so far"), n_matches);
+    } else if (n_matches == 0) {
+        status = g_strdup (_("No matches"));
+    } else {
+        counter->current = find_selected_match (counter, tt);
+
+        if (counter->current >= 0) {
+            status = g_strdup_printf (_("%u of %u"), (guint) counter->current + 1, n_matches);
+        } else {
+            status = g_strdup_printf (ngettext ("%u match", "%u matches", n_matches),
+                                      n_matches);
+        }
+    }
+
+    tilda_search_box_set_status (TILDA_SEARCH_BOX (tw->search), status);
+    g_free (status);
+}
+
+static gboolean
+count_matches_cb (G_GNUC_UNUSED GtkWidget *widget,
+                  G_GNUC_UNUSED GdkFrameClock *frame_clock,
+                  gpointer user_data)
+{
+    tilda_window *tw = user_data;
+    struct tilda_search_counter_ *counter = tw->search_counter;
+    gint64 deadline;
+    tilda_term *tt;
+
+    tt = find_term (tw, counter->tab_id);
+
+    if (tt == NULL) {
+        counter->tick_id = 0;
+        tilda_search_counter_stop (tw);
+        return G_SOURCE_REMOVE;
+    }
+
+    deadline = g_get_monotonic_time () + TILDA_SEARCH_COUNTER_BUDGET;
+
+    while (counter->next_row < counter->end_row && g_get_monotonic_time () < deadline) {
+        count_chunk (counter, tt);
+    }
+
+    show_count (tw, tt);
+
+    if (counter->next_row < counter->end_row) {
+        return G_SOURCE_CONTINUE;
+    }
+
+    counter->tick_id = 0;
+
+    return G_SOURCE_REMOVE;
+}
+
+void
+tilda_search_counter_update (tilda_window *tw,
+                             GRegex *regex,
+                             TildaSearchDirection direction)
+{
+    DEBUG_FUNCTION ("tilda_search_counter_update");
+    DEBUG_ASSERT (tw != NULL);
+    DEBUG_ASSERT (regex != NULL);
+
+    struct tilda_search_counter_ *counter = tw->search_counter;
+    GtkAdjustment *adjustment;
+    tilda_term *tt;
+    glong first_row;
+    glong end_row;
+    glong columns;
+    gint page;
+
+    page = gtk_notebook_get_current_page (GTK_NOTEBOOK (tw->notebook));
+    tt = page >= 0 ? g_list_nth_data (tw->terms, (guint) page) : NULL;
+
+    if (tt == NULL) {
+        return;
+    }
+
+    adjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (tt->vte_term));
+    first_row = (glong) gtk_adjustment_get_lower (adjustment);
+    end_row = (glong) gtk_adjustment_get_upper (adjustment);
+    columns = vte_terminal_get_column_count (VTE_TERMINAL (tt->vte_term));
+
+    /* The cache of the search box returns the same regex for the same
+     * search, so the matches only need to be counted again if the
+     * terminal changed. */
+    if (counter == NULL || counter->tab_id != tt->id || counter->regex != regex
+        || counter->first_row != first_row || counter->end_row != end_row
+        || counter->columns != columns)
+    {
+        tilda_search_counter_stop (tw);
+
+        counter = g_new0 (struct tilda_search_counter_, 1);
+        counter->tab_id = tt->id;
+        counter->regex = g_regex_ref (regex);
+        counter->first_row = first_row;
+        counter->end_row = end_row;
+        counter->columns = columns;
+        counter->next_row = first_row;
+        counter->match_end_row = first_row;
+        counter->matches = g_array_new (FALSE, FALSE, sizeof (Match));
+        counter->current = -1;
+
+        tw->search_counter = counter;
+    }
+
+    counter->direction = direction;
+
+    /* The terminal scrolls to the match only after this returns, so the
+     * count and the selected match are shown in the next frame. */
+    if (counter->tick_id == 0) {
+        counter->tick_id = gtk_widget_add_tick_callback (tw->search, count_matches_cb, tw, NULL);
+    }
+}
+
+void
+tilda_search_counter_stop (tilda_window *tw)
+{
+    DEBUG_FUNCTION ("tilda_search_counter_stop");
+    DEBUG_ASSERT (tw != NULL);
+
+    struct tilda_search_counter_ *counter = tw->search_counter;
+
+    if (counter == NULL) {
+        return;
+    }
+
+    if (counter->tick_id) {
+        gtk_widget_remove_tick_callback (tw->search, counter->tick_id);
+    }
+
+    tilda_search_box_set_status (TILDA_SEARCH_BOX (tw->search), NULL);
+
+    g_regex_unref (counter->regex);
+    g_array_free (counter->matches, TRUE);
+    g_free (counter);
+
+    tw->search_counter = NULL;
+}
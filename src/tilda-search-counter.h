@@ -0,0 +1,51 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILDA_SEARCH_COUNTER_H
+#define TILDA_SEARCH_COUNTER_H
+
+#include "tilda_window.h"
+#include "tilda-search-box.h"
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Counts the matches of the search in the current terminal and shows
+ * "3 of 127" in the search box.
+ *
+ * The text of the terminal is read in small blocks of rows from a frame
+ * clock tick callback. Each frame only gets a small time budget, so long
+ * histories are counted over several frames and never block the window.
+ */
+
+/**
+ * Counts the matches of regex in the current tab. If the same regex was
+ * already counted in this tab and the terminal did not change since, only
+ * the position of the current match is updated.
+ */
+void tilda_search_counter_update (tilda_window *tw,
+                                  GRegex *regex,
+                                  TildaSearchDirection direction);
+
+/**
+ * Stops counting and hides the count.
+ */
+void tilda_search_counter_stop (tilda_window *tw);
+
+G_END_DECLS
+
+#endif /* TILDA_SEARCH_COUNTER_H */
@@ -0,0 +1,505 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilda-search-highlight.h"
+
+#include "debug.h"
+#include "tilda_terminal.h"
+
+#include <glib.h>
+#include <gtk/gtk.h>
+#include <math.h>
+#include <string.h>
+#include <vte/vte.h>
+
+/* The color that is drawn over the matches */
+#define TILDA_SEARCH_HIGHLIGHT_RED   1.0
+#define TILDA_SEARCH_HIGHLIGHT_GREEN 0.85
+#define TILDA_SEARCH_HIGHLIGHT_BLUE  0.0
+#define TILDA_SEARCH_HIGHLIGHT_ALPHA 0.35
+
+struct tilda_search_highlight_
+{
+    tilda_window *tw;
+    GRegex *regex;
+
+    /* The terminal that is highlighted, NULL if none */
+    GtkWidget *terminal;
+    GtkAdjustment *adjustment;
+
+    gulong contents_changed_id;
+    gulong value_changed_id;
+    gulong draw_id;
+    gulong destroy_id;
+    gulong switch_page_id;
+
+    /* Updates the matches once per frame after the terminal changed */
+    guint tick_id;
+
+    /* Maps the row numbers of the visible rows to TildaHighlightRow */
+    GHashTable *rows;
+
+    /* The rows that were visible at the last update */
+    gint64 top;
+    gint64 bottom;
+
+    /* TRUE if the text of the terminal changed since the last update */
+    gboolean contents_changed;
+};
+
+typedef struct
+{
+    gint64 row;
+    gchar *text;
+
+    /* Pairs of start and end columns of the matches in the row */
+    GArray *columns;
+} TildaHighlightRow;
+
+static void
+highlight_row_free (TildaHighlightRow *row)
+{
+    g_free (row->text);
+    g_array_free (row->columns, TRUE);
+    g_free (row);
+}
+
+static GHashTable *
+new_row_table (void)
+{
+    return g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                  NULL, (GDestroyNotify) highlight_row_free);
+}
+
+static glong
+text_width (const gchar *start, const gchar *end)
+{
+    glong width = 0;
+
+    for (const gchar *p = start; p < end; p = g_utf8_next_char (p)) {
+        gunichar c = g_utf8_get_char (p);
+
+        if (!g_unichar_iszerowidth (c)) {
+            width += g_unichar_iswide (c) ? 2 : 1;
+        }
+    }
+
+    return width;
+}
+
+static TildaHighlightRow *
+match_row (GRegex *regex, gint64 row_number, gchar *text)
+{
+    TildaHighlightRow *row;
+    GMatchInfo *match_info = NULL;
+    const gchar *counted;
+    glong column = 0;
+
+    row = g_new0 (TildaHighlightRow, 1);
+    row->row = row_number;
+    row->text = text;
+    row->columns = g_array_new (FALSE, FALSE, sizeof (glong));
+
+    counted = text;
+
+    g_regex_match (regex, text, 0, &match_info);
+
+    while (g_match_info_matches (match_info))
+    {
+        gint start;
+        gint end;
+        glong end_column;
+
+        g_match_info_fetch_pos (match_info, 0, &start, &end);
+
+        if (end > start) {
+            column += text_width (counted, text + start);
+            end_column = column + text_width (text + start, text + end);
+            counted = text + end;
+
+            g_array_append_val (row->columns, column);
+            g_array_append_val (row->columns, end_column);
+
+            column = end_column;
+        }
+
+        g_match_info_next (match_info, NULL);
+    }
+
+    g_match_info_free (match_info);
+
+    return row;
+}
+
+/* Adds the row with the given text to rows. The matches of the row are
+ * taken over from the last update if its text did not change. */
+static void
+add_row (struct tilda_search_highlight_ *highlight,
+         GHashTable *rows,
+         gint64 row_number,
+         gchar *text)
+{
+    TildaHighlightRow *row;
+
+    row = g_hash_table_lookup (highlight->rows, &row_number);
+
+    if (row != NULL && strcmp (row->text, text) == 0) {
+        g_hash_table_steal (highlight->rows, &row_number);
+        g_free (text);
+    } else {
+        row = match_row (highlight->regex, row_number, text);
+    }
+
+    g_hash_table_insert (rows, &row->row, row);
+}
+
+/* Reads the rows from start_row up to end_row at once and splits the text
+ * into rows the way the terminal lays it out: rows are separated by
+ * newlines unless they are wrapped, which happens when a row is full. */
+static void
+read_rows (struct tilda_search_highlight_ *highlight,
+           tilda_term *tt,
+           GHashTable *rows,
+           gint64 start_row,
+           gint64 end_row)
+{
+    glong columns = vte_terminal_get_column_count (VTE_TERMINAL (tt->vte_term));
+    gint64 row_number = start_row;
+    const gchar *row_start;
+    glong column = 0;
+    gchar *text;
+
+    if (start_row >= end_row) {
+        return;
+    }
+
+    text = tilda_terminal_get_rows_text (tt, (glong) start_row, (glong) end_row);
+
+    if (text == NULL) {
+        return;
+    }
+
+    row_start = text;
+
+    for (const gchar *p = text; ; p = g_utf8_next_char (p))
+    {
+        gunichar c = g_utf8_get_char (p);
+        gboolean row_end = c == '\0' || c == '\n';
+        glong width = 0;
+
+        if (!row_end && !g_unichar_iszerowidth (c)) {
+            width = g_unichar_iswide (c) ? 2 : 1;
+            row_end = column + width > columns;
+        }
+
+        if (row_end) {
+            add_row (highlight, rows, row_number, g_strndup (row_start, p - row_start));
+
+            row_number++;
+            column = 0;
+
+            if (c == '\0' || row_number >= end_row) {
+                break;
+            }
+
+            row_start = c == '\n' ? p + 1 : p;
+        }
+
+        column += width;
+    }
+
+    g_free (text);
+}
+
+/* Searches the rows that became visible or changed since the last update.
+ * The matches of all other visible rows are taken over, rows that are no
+ * longer visible are dropped. */
+static void
+update_rows (struct tilda_search_highlight_ *highlight)
+{
+    GHashTable *rows;
+    gint64 top;
+    gint64 bottom;
+    tilda_term *tt = NULL;
+
+    for (GList *item = highlight->tw->terms; item != NULL; item = item->next) {
+        if (TILDA_TERM (item->data)->vte_term == highlight->terminal) {
+            tt = item->data;
+        }
+    }
+
+    if (tt == NULL) {
+        return;
+    }
+
+    top = (gint64) floor (gtk_adjustment_get_value (highlight->adjustment));
+    bottom = (gint64) ceil (gtk_adjustment_get_value (highlight->adjustment)
+                            + gtk_adjustment_get_page_size (highlight->adjustment));
+    bottom = MIN (bottom, (gint64) gtk_adjustment_get_upper (highlight->adjustment));
+
+    rows = new_row_table ();
+
+    if (highlight->contents_changed) {
+        /* The terminal does not tell which rows changed, so all visible
+         * rows are read again. Only rows with a new text are searched. */
+        read_rows (highlight, tt, rows, top, bottom);
+    } else {
+        /* The terminal was only scrolled, so just the rows that became
+         * visible are read. */
+        for (gint64 row_number = MAX (top, highlight->top);
+             row_number < MIN (bottom, highlight->bottom);
+             row_number++)
+        {
+            TildaHighlightRow *row = g_hash_table_lookup (highlight->rows, &row_number);
+
+            if (row != NULL) {
+                g_hash_table_steal (highlight->rows, &row_number);
+                g_hash_table_insert (rows, &row->row, row);
+            }
+        }
+
+        read_rows (highlight, tt, rows, top, MIN (bottom, highlight->top));
+        read_rows (highlight, tt, rows, MAX (top, highlight->bottom), bottom);
+    }
+
+    g_hash_table_destroy (highlight->rows);
+    highlight->rows = rows;
+    highlight->top = top;
+    highlight->bottom = bottom;
+    highlight->contents_changed = FALSE;
+}
+
+static gboolean
+update_rows_cb (GtkWidget *widget,
+                G_GNUC_UNUSED GdkFrameClock *frame_clock,
+                gpointer user_data)
+{
+    struct tilda_search_highlight_ *highlight = user_data;
+
+    highlight->tick_id = 0;
+
+    update_rows (highlight);
+    gtk_widget_queue_draw (widget);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+queue_update (struct tilda_search_highlight_ *highlight)
+{
+    if (highlight->tick_id == 0) {
+        highlight->tick_id = gtk_widget_add_tick_callback (highlight->terminal,
+                                                           update_rows_cb,
+                                                           highlight, NULL);
+    }
+}
+
+static gboolean
+draw_cb (GtkWidget *widget,
+         cairo_t *cr,
+         struct tilda_search_highlight_ *highlight)
+{
+    VteTerminal *terminal = VTE_TERMINAL (widget);
+    GtkStyleContext *context;
+    GtkBorder padding;
+    GHashTableIter iter;
+    TildaHighlightRow *row;
+    gdouble char_width;
+    gdouble char_height;
+    gdouble value;
+
+    context = gtk_widget_get_style_context (widget);
+    gtk_style_context_get_padding (context, gtk_widget_get_state_flags (widget), &padding);
+
+    char_width = (gdouble) vte_terminal_get_char_width (terminal);
+    char_height = (gdouble) vte_terminal_get_char_height (terminal);
+    value = gtk_adjustment_get_value (highlight->adjustment);
+
+    cairo_save (cr);
+    cairo_set_source_rgba (cr,
+                           TILDA_SEARCH_HIGHLIGHT_RED,
+                           TILDA_SEARCH_HIGHLIGHT_GREEN,
+                           TILDA_SEARCH_HIGHLIGHT_BLUE,
+                           TILDA_SEARCH_HIGHLIGHT_ALPHA);
+
+    g_hash_table_iter_init (&iter, highlight->rows);
+
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &row))
+    {
+        gdouble y = padding.top + ((gdouble) row->row - value) * char_height;
+
+        for (guint i = 0; i + 1 < row->columns->len; i += 2)
+        {
+            glong start = g_array_index (row->columns, glong, i);
+            glong end = g_array_index (row->columns, glong, i + 1);
+
+            cairo_rectangle (cr, padding.left + start * char_width, y,
+                             (end - start) * char_width, char_height);
+        }
+    }
+
+    cairo_fill (cr);
+    cairo_restore (cr);
+
+    return GDK_EVENT_PROPAGATE;
+}
+
+static void detach (struct tilda_search_highlight_ *highlight);
+
+static void
+terminal_destroy_cb (G_GNUC_UNUSED GtkWidget *widget,
+                     struct tilda_search_highlight_ *highlight)
+{
+    detach (highlight);
+}
+
+static void
+contents_changed_cb (G_GNUC_UNUSED VteTerminal *terminal,
+                     struct tilda_search_highlight_ *highlight)
+{
+    highlight->contents_changed = TRUE;
+    queue_update (highlight);
+}
+
+static void
+value_changed_cb (G_GNUC_UNUSED GtkAdjustment *adjustment,
+                  struct tilda_search_highlight_ *highlight)
+{
+    queue_update (highlight);
+}
+
+static void
+detach (struct tilda_search_highlight_ *highlight)
+{
+    if (highlight->terminal == NULL) {
+        return;
+    }
+
+    if (highlight->tick_id) {
+        gtk_widget_remove_tick_callback (highlight->terminal, highlight->tick_id);
+        highlight->tick_id = 0;
+    }
+
+    g_signal_handler_disconnect (highlight->terminal, highlight->contents_changed_id);
+    g_signal_handler_disconnect (highlight->terminal, highlight->draw_id);
+    g_signal_handler_disconnect (highlight->terminal, highlight->destroy_id);
+    g_signal_handler_disconnect (highlight->adjustment, highlight->value_changed_id);
+
+    gtk_widget_queue_draw (highlight->terminal);
+
+    g_object_unref (highlight->adjustment);
+
+    highlight->terminal = NULL;
+    highlight->adjustment = NULL;
+
+    g_hash_table_remove_all (highlight->rows);
+}
+
+static void
+attach (struct tilda_search_highlight_ *highlight, tilda_term *tt)
+{
+    GtkWidget *terminal = tt->vte_term;
+
+    highlight->terminal = terminal;
+    highlight->adjustment = g_object_ref (gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (terminal)));
+
+    highlight->contents_changed_id = g_signal_connect (terminal, "contents-changed",
+                                                       G_CALLBACK (contents_changed_cb), highlight);
+    highlight->draw_id = g_signal_connect_after (terminal, "draw",
+                                                 G_CALLBACK (draw_cb), highlight);
+    highlight->destroy_id = g_signal_connect (terminal, "destroy",
+                                              G_CALLBACK (terminal_destroy_cb), highlight);
+    highlight->value_changed_id = g_signal_connect (highlight->adjustment, "value-changed",
+                                                    G_CALLBACK (value_changed_cb), highlight);
+
+    highlight->contents_changed = TRUE;
+    queue_update (highlight);
+}
+
+static void
+switch_page_cb (G_GNUC_UNUSED GtkNotebook *notebook,
+                G_GNUC_UNUSED GtkWidget *page,
+                guint page_num,
+                struct tilda_search_highlight_ *highlight)
+{
+    tilda_term *tt = g_list_nth_data (highlight->tw->terms, page_num);
+
+    detach (highlight);
+
+    if (tt != NULL) {
+        attach (highlight, tt);
+    }
+}
+
+void
+tilda_search_highlight_set_regex (tilda_window *tw, GRegex *regex)
+{
+    DEBUG_FUNCTION ("tilda_search_highlight_set_regex");
+    DEBUG_ASSERT (tw != NULL);
+
+    struct tilda_search_highlight_ *highlight = tw->search_highlight;
+    tilda_term *tt;
+    gint page;
+
+    if (regex == NULL) {
+        tilda_search_highlight_free (tw);
+        return;
+    }
+
+    if (highlight != NULL && highlight->regex == regex) {
+        return;
+    }
+
+    tilda_search_highlight_free (tw);
+
+    highlight = g_new0 (struct tilda_search_highlight_, 1);
+    highlight->tw = tw;
+    highlight->regex = g_regex_ref (regex);
+    highlight->rows = new_row_table ();
+    highlight->switch_page_id = g_signal_connect_after (tw->notebook, "switch-page",
+                                                        G_CALLBACK (switch_page_cb), highlight);
+
+    tw->search_highlight = highlight;
+
+    page = gtk_notebook_get_current_page (GTK_NOTEBOOK (tw->notebook));
+    tt = page >= 0 ? g_list_nth_data (tw->terms, (guint) page) : NULL;
+
+    if (tt != NULL) {
+        attach (highlight, tt);
+    }
+}
+
+void
+tilda_search_highlight_free (tilda_window *tw)
+{
+    DEBUG_FUNCTION ("tilda_search_highlight_free");
+    DEBUG_ASSERT (tw != NULL);
+
+    struct tilda_search_highlight_ *highlight = tw->search_highlight;
+
+    if (highlight == NULL) {
+        return;
+    }
+
+    detach (highlight);
+
+    g_signal_handler_disconnect (tw->notebook, highlight->switch_page_id);
+
+    g_regex_unref (highlight->regex);
+    g_hash_table_destroy (highlight->rows);
+    g_free (highlight);
+
+    tw->search_highlight = NULL;
+}
@@ -0,0 +1,49 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILDA_SEARCH_HIGHLIGHT_H
+#define TILDA_SEARCH_HIGHLIGHT_H
+
+#include "tilda_window.h"
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Highlights all matches of the search in the visible rows of the current
+ * terminal, in addition to the current match which the terminal selects.
+ *
+ * Only the visible rows are searched. They are read from the terminal at
+ * once and the matches of each row are kept until the text of the row
+ * changes. Scrolling only reads the rows that became visible, new output
+ * only searches the rows that changed. The cost depends on the size of the
+ * window, not on the length of the history.
+ */
+
+/**
+ * Highlights the matches of regex in the current tab and in the tabs that
+ * become current later on. Pass NULL to remove the highlights.
+ */
+void tilda_search_highlight_set_regex (tilda_window *tw, GRegex *regex);
+
+/**
+ * Removes the highlights and frees the highlighter.
+ */
+void tilda_search_highlight_free (tilda_window *tw);
+
+G_END_DECLS
+
+#endif /* TILDA_SEARCH_HIGHLIGHT_H */
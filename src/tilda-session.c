@@ -0,0 +1,816 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilda-session.h"
+
+#include "configsys.h"
+#include "debug.h"
+
+#include <errno.h>
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <vte/vte.h>
+
+/* Must be increased whenever the layout of the index changes. */
+#define TILDA_SESSION_VERSION 1
+
+/* The tabs are stored as (title, working directory, command, scrollback file) */
+#define TILDA_SESSION_TABS_TYPE "a(smsmss)"
+
+/* (version, generation, active tab, tabs) */
+#define TILDA_SESSION_INDEX_TYPE "(uuu" TILDA_SESSION_TABS_TYPE ")"
+
+#define TILDA_SESSION_INDEX_FILE "index"
+#define TILDA_SESSION_SCROLLBACK_PREFIX "scrollback_"
+
+/* Changes to the set of tabs are written after this many seconds. */
+#define TILDA_SESSION_SAVE_DELAY 2
+
+/* Changes to the content of a terminal are less important and are
+ * written less often, since writing them requires a scrollback snapshot. */
+#define TILDA_SESSION_SCROLLBACK_SAVE_DELAY 30
+
+struct tilda_session_
+{
+    gchar *directory;
+
+    /* Scrollback files are named after the generation and the id of their
+     * tab. The generation is increased on each restore such that files of
+     * the previous session are never overwritten while still needed. */
+    guint generation;
+
+    gboolean save_scrollback;
+
+    guint save_source;
+    gint64 save_due_time;
+
+    /* Terminals whose scrollback is currently being loaded */
+    GHashTable *loading;
+};
+
+typedef struct
+{
+    guint64 serial;
+    gchar *directory;
+    GBytes *index;
+
+    /* Maps file names to the scrollback that needs to be written */
+    GHashTable *scrollbacks;
+
+    /* Set of scrollback file names which are referenced by the index */
+    GHashTable *referenced;
+} TildaSessionSaveJob;
+
+typedef struct
+{
+    tilda_window *tw;
+    tilda_term *tt;
+    GtkWidget *vte_term;
+} TildaSessionLoad;
+
+/* Serializes all writes to the session directory. Snapshots are taken on the
+ * main thread in increasing order of their serial, and an older snapshot must
+ * never overwrite a newer one. */
+static GMutex write_mutex;
+static guint64 last_written_serial = 0;
+static guint64 next_serial = 1;
+
+static void
+session_save_job_free (TildaSessionSaveJob *job)
+{
+    g_free (job->directory);
+    g_bytes_unref (job->index);
+    g_hash_table_destroy (job->scrollbacks);
+    g_hash_table_destroy (job->referenced);
+    g_free (job);
+}
+
+static gboolean
+session_write_compressed (const gchar *path,
+                          GBytes *bytes,
+                          GError **error)
+{
+    GFile *file;
+    GFileOutputStream *file_stream;
+    GZlibCompressor *compressor;
+    GOutputStream *stream;
+    const gchar *data;
+    gsize size;
+    gboolean success;
+
+    file = g_file_new_for_path (path);
+    file_stream = g_file_replace (file, NULL, FALSE,
+                                  G_FILE_CREATE_PRIVATE | G_FILE_CREATE_REPLACE_DESTINATION,
+                                  NULL, error);
+    g_object_unref (file);
+
+    if (file_stream == NULL) {
+        return FALSE;
+    }
+
+    compressor = g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1);
+    stream = g_converter_output_stream_new (G_OUTPUT_STREAM (file_stream),
+                                            G_CONVERTER (compressor));
+
+    data = g_bytes_get_data (bytes, &size);
+
+    success = g_output_stream_write_all (stream, data, size, NULL, NULL, error)
+              && g_output_stream_close (stream, NULL, error);
+
+    g_object_unref (stream);
+    g_object_unref (compressor);
+    g_object_unref (file_stream);
+
+    return success;
+}
+
+static GBytes *
+session_read_compressed (const gchar *path,
+                         GError **error)
+{
+    GFile *file;
+    GFileInputStream *file_stream;
+    GZlibDecompressor *decompressor;
+    GInputStream *stream;
+    GOutputStream *memory;
+    GBytes *bytes = NULL;
+
+    file = g_file_new_for_path (path);
+    file_stream = g_file_read (file, NULL, error);
+    g_object_unref (file);
+
+    if (file_stream == NULL) {
+        return NULL;
+    }
+
+    decompressor = g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP);
+    stream = g_converter_input_stream_new (G_INPUT_STREAM (file_stream),
+                                           G_CONVERTER (decompressor));
+    memory = g_memory_output_stream_new_resizable ();
+
+    if (g_output_stream_splice (memory, stream,
+                                G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE |
+                                G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                                NULL, error) >= 0)
+    {
+        bytes = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (memory));
+    }
+
+    g_object_unref (memory);
+    g_object_unref (stream);
+    g_object_unref (decompressor);
+    g_object_unref (file_stream);
+
+    return bytes;
+}
+
+/* Removes all scrollback files which are no longer referenced by the index. */
+static void
+session_remove_unreferenced_files (TildaSessionSaveJob *job)
+{
+    GDir *dir;
+    const gchar *name;
+
+    dir = g_dir_open (job->directory, 0, NULL);
+
+    if (dir == NULL) {
+        return;
+    }
+
+    while ((name = g_dir_read_name (dir)) != NULL)
+    {
+        if (!g_str_has_prefix (name, TILDA_SESSION_SCROLLBACK_PREFIX)
+            || g_hash_table_contains (job->referenced, name))
+        {
+            continue;
+        }
+
+        gchar *path = g_build_filename (job->directory, name, NULL);
+        g_unlink (path);
+        g_free (path);
+    }
+
+    g_dir_close (dir);
+}
+
+/* Writes the session snapshot to disk, this is called from a worker thread,
+ * or from the main thread when tilda is shutting down. */
+static gboolean
+session_write (TildaSessionSaveJob *job,
+               GError **error)
+{
+    GHashTableIter iter;
+    gpointer name;
+    gpointer bytes;
+    gboolean success = TRUE;
+
+    g_mutex_lock (&write_mutex);
+
+    if (job->serial < last_written_serial) {
+        /* A newer snapshot has already been written */
+        g_mutex_unlock (&write_mutex);
+        return TRUE;
+    }
+
+    if (g_mkdir_with_parents (job->directory, S_IRWXU) == -1) {
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                     "%s: %s", job->directory, g_strerror (errno));
+        g_mutex_unlock (&write_mutex);
+        return FALSE;
+    }
+
+    /* The scrollback files are written first, such that the index never
+     * references a file that does not exist yet. */
+    g_hash_table_iter_init (&iter, job->scrollbacks);
+    while (g_hash_table_iter_next (&iter, &name, &bytes))
+    {
+        GError *scrollback_error = NULL;
+        gchar *path = g_build_filename (job->directory, name, NULL);
+
+        if (!session_write_compressed (path, bytes, &scrollback_error)) {
+            g_printerr (_("Unable to save the scrollback of a tab: %s\n"),
+                        scrollback_error->message);
+            g_error_free (scrollback_error);
+        }
+
+        g_free (path);
+    }
+
+    gchar *index_path = g_build_filename (job->directory, TILDA_SESSION_INDEX_FILE, NULL);
+    gsize size;
+    const gchar *data = g_bytes_get_data (job->index, &size);
+
+    success = g_file_set_contents (index_path, data, size, error);
+
+    g_free (index_path);
+
+    if (success) {
+        session_remove_unreferenced_files (job);
+        last_written_serial = job->serial;
+    }
+
+    g_mutex_unlock (&write_mutex);
+
+    return success;
+}
+
+static void
+session_save_thread (GTask *task,
+                     G_GNUC_UNUSED gpointer source_object,
+                     gpointer task_data,
+                     G_GNUC_UNUSED GCancellable *cancellable)
+{
+    GError *error = NULL;
+
+    if (!session_write (task_data, &error)) {
+        g_task_return_error (task, error);
+        return;
+    }
+
+    g_task_return_boolean (task, TRUE);
+}
+
+static void
+session_save_done_cb (G_GNUC_UNUSED GObject *source_object,
+                      GAsyncResult *result,
+                      G_GNUC_UNUSED gpointer user_data)
+{
+    GError *error = NULL;
+
+    if (!g_task_propagate_boolean (G_TASK (result), &error)) {
+        g_printerr (_("Unable to save the session: %s\n"), error->message);
+        g_error_free (error);
+    }
+}
+
+static GBytes *
+session_snapshot_scrollback (tilda_term *tt)
+{
+    GOutputStream *stream;
+    GError *error = NULL;
+    GBytes *bytes = NULL;
+
+    stream = g_memory_output_stream_new_resizable ();
+
+    if (vte_terminal_write_contents_sync (VTE_TERMINAL (tt->vte_term), stream,
+                                          VTE_WRITE_DEFAULT, NULL, &error)
+        && g_output_stream_close (stream, NULL, &error))
+    {
+        bytes = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (stream));
+    } else {
+        g_printerr (_("Unable to save the scrollback of a tab: %s\n"), error->message);
+        g_error_free (error);
+    }
+
+    g_object_unref (stream);
+
+    return bytes;
+}
+
+/* Takes a snapshot of the scrollback of the terminal if it changed since the
+ * last save. Terminals that have not been spawned yet, or did not change,
+ * keep referencing their existing scrollback file. */
+static void
+session_update_scrollback (struct tilda_session_ *session,
+                           tilda_term *tt,
+                           TildaSessionSaveJob *job)
+{
+    GBytes *bytes;
+
+    if (!session->save_scrollback) {
+        g_clear_pointer (&tt->session_scrollback_file, g_free);
+        return;
+    }
+
+    if (tt->spawn_deferred || !tt->session_dirty) {
+        return;
+    }
+
+    bytes = session_snapshot_scrollback (tt);
+
+    if (bytes == NULL) {
+        return;
+    }
+
+    g_free (tt->session_scrollback_file);
+    tt->session_scrollback_file = g_strdup_printf (TILDA_SESSION_SCROLLBACK_PREFIX "%u_%u.gz",
+                                                   session->generation, tt->id);
+
+    g_hash_table_replace (job->scrollbacks, g_strdup (tt->session_scrollback_file), bytes);
+
+    tt->session_dirty = FALSE;
+}
+
+static TildaSessionSaveJob *
+session_create_save_job (tilda_window *tw)
+{
+    struct tilda_session_ *session = tw->session;
+    TildaSessionSaveJob *job;
+    GVariantBuilder tabs;
+    GVariant *index;
+    gint active;
+
+    job = g_new0 (TildaSessionSaveJob, 1);
+    job->serial = next_serial++;
+    job->directory = g_strdup (session->directory);
+    job->scrollbacks = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              g_free, (GDestroyNotify) g_bytes_unref);
+    job->referenced = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    g_variant_builder_init (&tabs, G_VARIANT_TYPE (TILDA_SESSION_TABS_TYPE));
+
+    for (GList *item = tw->terms; item != NULL; item = item->next)
+    {
+        tilda_term *tt = item->data;
+        GtkWidget *label;
+        const gchar *title = "";
+        const gchar *scrollback_file = "";
+        gchar *working_dir;
+
+        label = gtk_notebook_get_tab_label (GTK_NOTEBOOK (tw->notebook), tt->hbox);
+
+        if (label != NULL) {
+            title = gtk_label_get_text (GTK_LABEL (label));
+        }
+
+        working_dir = tilda_term_get_cwd (tt);
+
+        session_update_scrollback (session, tt, job);
+
+        if (tt->session_scrollback_file != NULL) {
+            scrollback_file = tt->session_scrollback_file;
+            g_hash_table_add (job->referenced, g_strdup (scrollback_file));
+        }
+
+        g_variant_builder_add (&tabs, "(smsmss)",
+                               title, working_dir, tt->command, scrollback_file);
+
+        g_free (working_dir);
+    }
+
+    active = gtk_notebook_get_current_page (GTK_NOTEBOOK (tw->notebook));
+
+    index = g_variant_new ("(uuu@" TILDA_SESSION_TABS_TYPE ")",
+                           TILDA_SESSION_VERSION,
+                           session->generation,
+                           (guint32) MAX (active, 0),
+                           g_variant_builder_end (&tabs));
+
+    g_variant_ref_sink (index);
+    job->index = g_variant_get_data_as_bytes (index);
+    g_variant_unref (index);
+
+    return job;
+}
+
+static gboolean
+session_save_timeout_cb (gpointer user_data)
+{
+    tilda_window *tw = TILDA_WINDOW (user_data);
+    TildaSessionSaveJob *job;
+    GTask *task;
+
+    tw->session->save_source = 0;
+
+    job = session_create_save_job (tw);
+
+    task = g_task_new (NULL, NULL, session_save_done_cb, NULL);
+    g_task_set_task_data (task, job, (GDestroyNotify) session_save_job_free);
+    g_task_run_in_thread (task, session_save_thread);
+    g_object_unref (task);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+session_schedule_save (tilda_window *tw, guint delay)
+{
+    struct tilda_session_ *session = tw->session;
+    gint64 due_time;
+
+    due_time = g_get_monotonic_time () + delay * G_USEC_PER_SEC;
+
+    if (session->save_source != 0) {
+        /* A save is already scheduled, only reschedule it if it is
+         * further in the future than the new request. */
+        if (session->save_due_time <= due_time) {
+            return;
+        }
+
+        g_source_remove (session->save_source);
+    }
+
+    session->save_due_time = due_time;
+    session->save_source = g_timeout_add_seconds (delay, session_save_timeout_cb, tw);
+}
+
+void
+tilda_session_mark_dirty (tilda_window *tw)
+{
+    if (tw->session == NULL) {
+        return;
+    }
+
+    session_schedule_save (tw, TILDA_SESSION_SAVE_DELAY);
+}
+
+void
+tilda_session_mark_term_dirty (tilda_term *tt)
+{
+    tilda_window *tw = tt->tw;
+
+    if (tw->session == NULL || !tw->session->save_scrollback) {
+        return;
+    }
+
+    tt->session_dirty = TRUE;
+
+    session_schedule_save (tw, TILDA_SESSION_SCROLLBACK_SAVE_DELAY);
+}
+
+void
+tilda_session_save_now (tilda_window *tw)
+{
+    DEBUG_FUNCTION ("tilda_session_save_now");
+    DEBUG_ASSERT (tw != NULL);
+
+    TildaSessionSaveJob *job;
+    GError *error = NULL;
+
+    if (tw->session == NULL) {
+        return;
+    }
+
+    if (tw->session->save_source != 0) {
+        g_source_remove (tw->session->save_source);
+        tw->session->save_source = 0;
+    }
+
+    job = session_create_save_job (tw);
+
+    if (!session_write (job, &error)) {
+        g_printerr (_("Unable to save the session: %s\n"), error->message);
+        g_error_free (error);
+    }
+
+    session_save_job_free (job);
+}
+
+/* Converts the saved text into a form that can be fed into a terminal. */
+static GBytes *
+session_prepare_scrollback (GBytes *bytes)
+{
+    const gchar *data;
+    gsize size;
+    GString *text;
+
+    data = g_bytes_get_data (bytes, &size);
+
+    /* The saved text contains the empty rows below the cursor */
+    while (size > 0 && g_ascii_isspace (data[size - 1])) {
+        size--;
+    }
+
+    text = g_string_sized_new (size + size / 16 + 2);
+
+    for (gsize i = 0; i < size; i++)
+    {
+        if (data[i] == '\n') {
+            g_string_append_c (text, '\r');
+        }
+
+        g_string_append_c (text, data[i]);
+    }
+
+    if (text->len > 0) {
+        g_string_append (text, "\r\n");
+    }
+
+    return g_string_free_to_bytes (text);
+}
+
+static void
+session_load_thread (GTask *task,
+                     G_GNUC_UNUSED gpointer source_object,
+                     gpointer task_data,
+                     G_GNUC_UNUSED GCancellable *cancellable)
+{
+    const gchar *path = task_data;
+    GError *error = NULL;
+    GBytes *bytes;
+
+    bytes = session_read_compressed (path, &error);
+
+    if (bytes == NULL) {
+        g_task_return_error (task, error);
+        return;
+    }
+
+    g_task_return_pointer (task,
+                           session_prepare_scrollback (bytes),
+                           (GDestroyNotify) g_bytes_unref);
+
+    g_bytes_unref (bytes);
+}
+
+static void
+session_load_done_cb (G_GNUC_UNUSED GObject *source_object,
+                      GAsyncResult *result,
+                      gpointer user_data)
+{
+    TildaSessionLoad *load = user_data;
+    tilda_window *tw = load->tw;
+    tilda_term *tt = load->tt;
+    GError *error = NULL;
+    GBytes *bytes;
+
+    bytes = g_task_propagate_pointer (G_TASK (result), &error);
+
+    if (tw->session != NULL) {
+        g_hash_table_remove (tw->session->loading, tt);
+    }
+
+    /* The tab may have been closed while its scrollback was loading */
+    if (g_list_find (tw->terms, tt) == NULL || tt->vte_term != load->vte_term) {
+        goto out;
+    }
+
+    if (bytes != NULL) {
+        gsize size;
+        const gchar *data = g_bytes_get_data (bytes, &size);
+
+        vte_terminal_feed (VTE_TERMINAL (tt->vte_term), data, size);
+    } else if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND)) {
+        g_printerr (_("Unable to restore the scrollback of a tab: %s\n"), error->message);
+    }
+
+    tilda_term_spawn_deferred (tt);
+
+out:
+    g_clear_error (&error);
+
+    if (bytes != NULL) {
+        g_bytes_unref (bytes);
+    }
+
+    g_object_unref (load->vte_term);
+    g_free (load);
+}
+
+void
+tilda_session_materialize_tab (tilda_window *tw, tilda_term *tt)
+{
+    DEBUG_FUNCTION ("tilda_session_materialize_tab");
+    DEBUG_ASSERT (tw != NULL);
+
+    struct tilda_session_ *session = tw->session;
+    TildaSessionLoad *load;
+    GTask *task;
+
+    if (tt == NULL || !tt->spawn_deferred) {
+        return;
+    }
+
+    if (session == NULL || tt->session_scrollback_file == NULL) {
+        tilda_term_spawn_deferred (tt);
+        return;
+    }
+
+    if (g_hash_table_contains (session->loading, tt)) {
+        return;
+    }
+
+    g_hash_table_add (session->loading, tt);
+
+    /* The shell is spawned once the scrollback has been fed into the
+     * terminal, such that the prompt appears below the old output. */
+    load = g_new0 (TildaSessionLoad, 1);
+    load->tw = tw;
+    load->tt = tt;
+    load->vte_term = g_object_ref (tt->vte_term);
+
+    task = g_task_new (NULL, NULL, session_load_done_cb, load);
+    g_task_set_task_data (task,
+                          g_build_filename (session->directory, tt->session_scrollback_file, NULL),
+                          g_free);
+    g_task_run_in_thread (task, session_load_thread);
+    g_object_unref (task);
+}
+
+static gboolean
+session_is_valid_scrollback_file (const gchar *name)
+{
+    return g_str_has_prefix (name, TILDA_SESSION_SCROLLBACK_PREFIX)
+           && strchr (name, G_DIR_SEPARATOR) == NULL;
+}
+
+gboolean
+tilda_session_restore (tilda_window *tw)
+{
+    DEBUG_FUNCTION ("tilda_session_restore");
+    DEBUG_ASSERT (tw != NULL);
+
+    struct tilda_session_ *session = tw->session;
+    GError *error = NULL;
+    gchar *path;
+    gchar *contents;
+    gsize length;
+    GVariant *index;
+    GVariantIter *tabs;
+    guint32 version;
+    guint32 generation;
+    guint32 active;
+    const gchar *title;
+    const gchar *working_dir;
+    const gchar *command;
+    const gchar *scrollback_file;
+    gint restored = 0;
+
+    if (session == NULL) {
+        return FALSE;
+    }
+
+    path = g_build_filename (session->directory, TILDA_SESSION_INDEX_FILE, NULL);
+
+    if (!g_file_get_contents (path, &contents, &length, &error))
+    {
+        if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+            g_printerr (_("Unable to restore the session: %s\n"), error->message);
+        }
+
+        g_error_free (error);
+        g_free (path);
+        return FALSE;
+    }
+
+    g_free (path);
+
+    index = g_variant_new_from_data (G_VARIANT_TYPE (TILDA_SESSION_INDEX_TYPE),
+                                     contents, length, FALSE, g_free, contents);
+    g_variant_ref_sink (index);
+
+    g_variant_get_child (index, 0, "u", &version);
+
+    if (version != TILDA_SESSION_VERSION) {
+        g_debug ("Ignoring session with unsupported version %u", version);
+        g_variant_unref (index);
+        return FALSE;
+    }
+
+    g_variant_get (index, "(uuu" TILDA_SESSION_TABS_TYPE ")",
+                   &version, &generation, &active, &tabs);
+
+    session->generation = generation + 1;
+
+    /* All tabs are created right away, but their shells are only spawned
+     * when they are shown for the first time. */
+    while (g_variant_iter_next (tabs, "(&sm&sm&s&s)",
+                                &title, &working_dir, &command, &scrollback_file))
+    {
+        tilda_term *tt;
+        GtkWidget *label;
+
+        tt = tilda_window_add_tab_full (tw, restored, working_dir, command, TRUE);
+
+        if (tt == NULL) {
+            break;
+        }
+
+        label = gtk_notebook_get_tab_label (GTK_NOTEBOOK (tw->notebook), tt->hbox);
+
+        if (*title != '\0') {
+            gtk_label_set_text (GTK_LABEL (label), title);
+        }
+
+        if (session->save_scrollback && session_is_valid_scrollback_file (scrollback_file)) {
+            tt->session_scrollback_file = g_strdup (scrollback_file);
+        }
+
+        restored++;
+    }
+
+    g_variant_iter_free (tabs);
+    g_variant_unref (index);
+
+    if (restored == 0) {
+        return FALSE;
+    }
+
+    active = MIN (active, (guint32) restored - 1);
+
+    gtk_notebook_set_current_page (GTK_NOTEBOOK (tw->notebook), active);
+
+    tilda_term *active_tt = g_list_nth_data (tw->terms, active);
+
+    tilda_session_materialize_tab (tw, active_tt);
+    gtk_widget_grab_focus (active_tt->vte_term);
+
+    return TRUE;
+}
+
+void
+tilda_session_init (tilda_window *tw)
+{
+    DEBUG_FUNCTION ("tilda_session_init");
+    DEBUG_ASSERT (tw != NULL);
+
+    struct tilda_session_ *session;
+    gchar *name;
+
+    if (!config_getbool ("restore_session")) {
+        tw->session = NULL;
+        return;
+    }
+
+    session = g_new0 (struct tilda_session_, 1);
+
+    name = g_strdup_printf ("session_%d", tw->instance);
+    session->directory = g_build_filename (g_get_user_cache_dir (),
+                                           "tilda", "sessions", name, NULL);
+    g_free (name);
+
+    session->generation = 1;
+    session->save_scrollback = config_getbool ("session_save_scrollback");
+    session->loading = g_hash_table_new (NULL, NULL);
+
+    tw->session = session;
+}
+
+void
+tilda_session_free (tilda_window *tw)
+{
+    DEBUG_FUNCTION ("tilda_session_free");
+    DEBUG_ASSERT (tw != NULL);
+
+    struct tilda_session_ *session = tw->session;
+
+    if (session == NULL) {
+        return;
+    }
+
+    if (session->save_source != 0) {
+        g_source_remove (session->save_source);
+    }
+
+    g_hash_table_destroy (session->loading);
+    g_free (session->directory);
+    g_free (session);
+
+    tw->session = NULL;
+}
@@ -0,0 +1,91 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILDA_SESSION_H
+#define TILDA_SESSION_H
+
+#include "tilda_window.h"
+#include "tilda_terminal.h"
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * The session subsystem remembers the tabs of a tilda window (their order,
+ * titles, working directories, custom commands and optionally their
+ * scrollback) across restarts. It is only active if the "restore_session"
+ * option is enabled.
+ *
+ * A session is stored per instance in the cache directory:
+ *
+ *     ~/.cache/tilda/sessions/session_<instance>/index
+ *     ~/.cache/tilda/sessions/session_<instance>/scrollback_<id>.gz
+ *
+ * The index is a serialized GVariant, scrollback is stored as gzip
+ * compressed text in one file per tab. Only tabs whose content changed
+ * since the last save get their scrollback rewritten. All file I/O and
+ * compression happens on a worker thread.
+ */
+
+/**
+ * Sets up the session state of the tilda window. Must be called once
+ * the notebook of the window has been created and before any tab is added.
+ */
+void     tilda_session_init (tilda_window *tw);
+
+/**
+ * Restores the tabs from the last saved session. Only the active tab is
+ * materialized (i.e. its shell is spawned and its scrollback is loaded),
+ * all other tabs are materialized when they are switched to for the first
+ * time.
+ *
+ * @return TRUE if at least one tab was restored, FALSE otherwise.
+ */
+gboolean tilda_session_restore (tilda_window *tw);
+
+/**
+ * Spawns the shell of a restored tab and feeds its saved scrollback into
+ * the terminal if this has not happened yet. Does nothing for tabs that
+ * are already materialized.
+ */
+void     tilda_session_materialize_tab (tilda_window *tw, tilda_term *tt);
+
+/**
+ * Notifies the session that the set of tabs or one of their properties
+ * changed. Saving is coalesced, so this is cheap to call often.
+ */
+void     tilda_session_mark_dirty (tilda_window *tw);
+
+/**
+ * Notifies the session that the content of a terminal changed, such that
+ * its scrollback needs to be written again on the next save.
+ */
+void     tilda_session_mark_term_dirty (tilda_term *tt);
+
+/**
+ * Writes the current session to disk and waits until the write has
+ * completed. This is used when tilda is shutting down.
+ */
+void     tilda_session_save_now (tilda_window *tw);
+
+/**
+ * Releases the session state of the tilda window.
+ */
+void     tilda_session_free (tilda_window *tw);
+
+G_END_DECLS
+
+#endif /* TILDA_SESSION_H */
@@ -0,0 +1,186 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilda-startup-profile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_PHASES 32
+
+/* How long the report waits for the first prompt */
+#define FIRST_PROMPT_TIMEOUT 10
+
+typedef struct
+{
+    const gchar *name;
+    gint64 start;
+    gint64 duration;
+} Phase;
+
+static Phase phases[MAX_PHASES];
+static guint n_phases;
+static gint64 main_time;
+static gboolean print_report;
+static gboolean first_prompt_seen;
+static gboolean report_pending;
+static guint report_source;
+
+void
+tilda_startup_profile_init (void)
+{
+    main_time = g_get_monotonic_time ();
+}
+
+void
+tilda_startup_profile_phase (const gchar *name, gint64 start_time)
+{
+    if (n_phases == MAX_PHASES) {
+        return;
+    }
+
+    phases[n_phases].name = name;
+    phases[n_phases].start = start_time - main_time;
+    phases[n_phases].duration = g_get_monotonic_time () - start_time;
+    n_phases++;
+}
+
+/* Child phases are recorded before their parent, but have a later start */
+static int
+compare_phases (const void *a, const void *b)
+{
+    const Phase *phase_a = a;
+    const Phase *phase_b = b;
+
+    if (phase_a->start != phase_b->start) {
+        return phase_a->start < phase_b->start ? -1 : 1;
+    }
+
+    /* The parent of a phase that starts at the same time comes first */
+    return phase_b->duration < phase_a->duration ? -1 : phase_b->duration > phase_a->duration;
+}
+
+static void
+emit_report (void)
+{
+    gboolean print = print_report;
+    gint64 total = 0;
+
+    report_pending = FALSE;
+
+    if (report_source) {
+        g_source_remove (report_source);
+        report_source = 0;
+    }
+
+    qsort (phases, n_phases, sizeof (Phase), compare_phases);
+
+    /* The startup ends with the phase that ended last */
+    for (guint i = 0; i < n_phases; i++) {
+        total = MAX (total, phases[i].start + phases[i].duration);
+    }
+
+    if (print) {
+        printf ("%-36s %10s %10s\n", "Startup phase", "start ms", "took ms");
+    }
+
+    for (guint i = 0; i < n_phases; i++)
+    {
+        Phase *phase = &phases[i];
+        gchar *start = g_strdup_printf ("%" G_GINT64_FORMAT, phase->start);
+        gchar *duration = g_strdup_printf ("%" G_GINT64_FORMAT, phase->duration);
+
+        g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_INFO,
+                          "TILDA_STARTUP_PHASE", phase->name,
+                          "TILDA_STARTUP_PHASE_START_USEC", start,
+                          "TILDA_STARTUP_PHASE_USEC", duration,
+                          "MESSAGE", "Startup phase %s took %.3f ms",
+                          phase->name, phase->duration / 1000.0);
+
+        g_free (start);
+        g_free (duration);
+
+        if (print) {
+            const gchar *child = strrchr (phase->name, '/');
+
+            /* Indent child phases below their parent */
+            printf ("%s%-*s %10.3f %10.3f\n",
+                    child ? "  " : "",
+                    child ? 34 : 36,
+                    child ? child + 1 : phase->name,
+                    phase->start / 1000.0,
+                    phase->duration / 1000.0);
+        }
+    }
+
+    gchar *total_usec = g_strdup_printf ("%" G_GINT64_FORMAT, total);
+
+    g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_INFO,
+                      "TILDA_STARTUP_PHASE", "total",
+                      "TILDA_STARTUP_PHASE_START_USEC", "0",
+                      "TILDA_STARTUP_PHASE_USEC", total_usec,
+                      "MESSAGE", "Startup took %.3f ms", total / 1000.0);
+
+    g_free (total_usec);
+
+    if (print) {
+        printf ("%-36s %10s %10.3f\n", "total", "", total / 1000.0);
+        fflush (stdout);
+    }
+}
+
+static gboolean
+report_timeout_cb (G_GNUC_UNUSED gpointer user_data)
+{
+    report_source = 0;
+    emit_report ();
+
+    return G_SOURCE_REMOVE;
+}
+
+void
+tilda_startup_profile_set_print (gboolean print)
+{
+    print_report = print;
+}
+
+void
+tilda_startup_profile_first_prompt (void)
+{
+    if (first_prompt_seen) {
+        return;
+    }
+
+    first_prompt_seen = TRUE;
+    tilda_startup_profile_phase ("first-prompt", main_time);
+
+    if (report_pending) {
+        emit_report ();
+    }
+}
+
+void
+tilda_startup_profile_report (void)
+{
+    if (first_prompt_seen) {
+        emit_report ();
+        return;
+    }
+
+    /* A shell that prints no prompt must not hold back the report forever */
+    report_pending = TRUE;
+    report_source = g_timeout_add_seconds (FIRST_PROMPT_TIMEOUT, report_timeout_cb, NULL);
+}
@@ -0,0 +1,64 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILDA_STARTUP_PROFILE_H
+#define TILDA_STARTUP_PROFILE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Records the duration of the phases of the startup of tilda. The start of
+ * a phase is taken with g_get_monotonic_time() and passed to
+ * tilda_startup_profile_phase() when the phase has finished. Phases with a
+ * name of the form "parent/child" are part of the phase "parent".
+ */
+
+/**
+ * Remembers the time at which main() was entered.
+ */
+void tilda_startup_profile_init (void);
+
+/**
+ * If print is TRUE, tilda_startup_profile_report() prints the phases and
+ * the total startup time to stdout.
+ */
+void tilda_startup_profile_set_print (gboolean print);
+
+/**
+ * Records a phase that started at start_time and ends now. The name must be
+ * a static string.
+ */
+void tilda_startup_profile_phase (const gchar *name, gint64 start_time);
+
+/**
+ * Records the phase "first-prompt" from the start of main() until now,
+ * must be called when a shell first produced output. Only the first call
+ * has an effect.
+ */
+void tilda_startup_profile_first_prompt (void);
+
+/**
+ * Emits each recorded phase as a structured log message with the fields
+ * TILDA_STARTUP_PHASE, TILDA_STARTUP_PHASE_START_USEC and
+ * TILDA_STARTUP_PHASE_USEC at the info level, once the first prompt was
+ * recorded or a timeout expired.
+ */
+void tilda_startup_profile_report (void);
+
+G_END_DECLS
+
+#endif /* TILDA_STARTUP_PROFILE_H */
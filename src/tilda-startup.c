@@ -0,0 +1,185 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilda-startup.h"
+
+#include "debug.h"
+#include "tilda-startup-profile.h"
+
+#include <gtk/gtk.h>
+
+typedef struct
+{
+    TildaStartupPriority priority;
+    /* Orders tasks of the same priority by the time they were added */
+    guint sequence;
+    const gchar *name;
+    TildaStartupFunc func;
+} Task;
+
+static gboolean run_next_task_cb (gpointer user_data);
+
+static gint
+compare_tasks (gconstpointer a, gconstpointer b)
+{
+    const Task *task_a = a;
+    const Task *task_b = b;
+
+    if (task_a->priority != task_b->priority) {
+        return (gint) task_a->priority - (gint) task_b->priority;
+    }
+
+    return task_a->sequence < task_b->sequence ? -1 : 1;
+}
+
+void
+tilda_startup_add (tilda_window *tw,
+                   TildaStartupPriority priority,
+                   const gchar *name,
+                   TildaStartupFunc func)
+{
+    DEBUG_FUNCTION ("tilda_startup_add");
+    DEBUG_ASSERT (tw != NULL);
+    DEBUG_ASSERT (func != NULL);
+
+    static guint next_sequence;
+    Task *task = g_new (Task, 1);
+
+    task->priority = priority;
+    task->sequence = next_sequence++;
+    task->name = name;
+    task->func = func;
+
+    /* Tasks with the same priority keep the order in which they were added,
+     * e.g. the key binder must be initialized before the key is bound */
+    tw->startup_tasks = g_list_insert_sorted (tw->startup_tasks, task, compare_tasks);
+}
+
+/* Runs the first task, returns FALSE if there are no more tasks */
+static gboolean
+run_next_task (tilda_window *tw)
+{
+    Task *task;
+    gint64 start_time;
+
+    if (tw->startup_tasks == NULL) {
+        return FALSE;
+    }
+
+    task = tw->startup_tasks->data;
+    tw->startup_tasks = g_list_delete_link (tw->startup_tasks, tw->startup_tasks);
+
+    start_time = g_get_monotonic_time ();
+    task->func (tw);
+    tilda_startup_profile_phase (task->name, start_time);
+
+    g_free (task);
+
+    return tw->startup_tasks != NULL;
+}
+
+static void
+startup_completed (tilda_window *tw)
+{
+    if (tw->startup_source) {
+        g_source_remove (tw->startup_source);
+        tw->startup_source = 0;
+    }
+
+    if (tw->startup_paint_handler) {
+        g_signal_handler_disconnect (gtk_widget_get_frame_clock (tw->window),
+                                     tw->startup_paint_handler);
+        tw->startup_paint_handler = 0;
+    }
+
+    if (tw->startup_deferred_time != 0) {
+        tilda_startup_profile_phase ("deferred", tw->startup_deferred_time);
+        tw->startup_deferred_time = 0;
+
+        tilda_startup_profile_report ();
+    }
+}
+
+static gboolean
+run_next_task_cb (gpointer user_data)
+{
+    tilda_window *tw = user_data;
+
+    if (run_next_task (tw)) {
+        return G_SOURCE_CONTINUE;
+    }
+
+    tw->startup_source = 0;
+    startup_completed (tw);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+after_paint_cb (GdkFrameClock *frame_clock, tilda_window *tw)
+{
+    g_signal_handler_disconnect (frame_clock, tw->startup_paint_handler);
+    tw->startup_paint_handler = 0;
+
+    /* Input events have a higher priority than the tasks, so the window
+     * stays responsive while they run. */
+    tw->startup_source = g_idle_add (run_next_task_cb, tw);
+}
+
+void
+tilda_startup_run (tilda_window *tw)
+{
+    DEBUG_FUNCTION ("tilda_startup_run");
+    DEBUG_ASSERT (tw != NULL);
+
+    GdkFrameClock *frame_clock = gtk_widget_get_frame_clock (tw->window);
+
+    tw->startup_deferred_time = g_get_monotonic_time ();
+
+    if (gtk_widget_get_visible (tw->window) && frame_clock != NULL) {
+        tw->startup_paint_handler = g_signal_connect (frame_clock, "after-paint",
+                                                      G_CALLBACK (after_paint_cb), tw);
+    } else {
+        tw->startup_source = g_idle_add (run_next_task_cb, tw);
+    }
+}
+
+void
+tilda_startup_finish (tilda_window *tw)
+{
+    DEBUG_FUNCTION ("tilda_startup_finish");
+    DEBUG_ASSERT (tw != NULL);
+
+    if (tw->startup_tasks == NULL) {
+        return;
+    }
+
+    while (run_next_task (tw));
+
+    startup_completed (tw);
+}
+
+void
+tilda_startup_free (tilda_window *tw)
+{
+    DEBUG_FUNCTION ("tilda_startup_free");
+    DEBUG_ASSERT (tw != NULL);
+
+    g_list_free_full (tw->startup_tasks, g_free);
+    tw->startup_tasks = NULL;
+    tw->startup_deferred_time = 0;
+
+    startup_completed (tw);
+}
@@ -0,0 +1,78 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILDA_STARTUP_H
+#define TILDA_STARTUP_H
+
+#include "tilda_window.h"
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Initialization that is not needed to show the window with a running
+ * shell is added as a task and runs from idle callbacks once the window
+ * has painted its first frame, one task per callback in the order of the
+ * priorities below.
+ *
+ * Anything that depends on a task, such as a key press that may be an
+ * accelerator or opening the context menu or the wizard, must call
+ * tilda_startup_finish() first, which runs the remaining tasks at once.
+ */
+
+typedef enum {
+    /* The keyboard accelerators of the window */
+    TILDA_STARTUP_ACCELERATORS,
+    /* The style.css file of the user */
+    TILDA_STARTUP_STYLE,
+    /* The match regexes of the terminals */
+    TILDA_STARTUP_MATCHES,
+    /* The global key binding that pulls the window */
+    TILDA_STARTUP_KEYBINDING,
+    /* The D-Bus name and the control socket */
+    TILDA_STARTUP_DBUS
+} TildaStartupPriority;
+
+typedef void (*TildaStartupFunc) (tilda_window *tw);
+
+/**
+ * Adds a task that runs func. The name must be a static string, it is used
+ * for the phase of the task in the startup profile.
+ */
+void tilda_startup_add (tilda_window *tw,
+                        TildaStartupPriority priority,
+                        const gchar *name,
+                        TildaStartupFunc func);
+
+/**
+ * Starts to run the tasks after the next frame of the window, or at once
+ * if the window is not shown. Must be called after the first pull.
+ */
+void tilda_startup_run (tilda_window *tw);
+
+/**
+ * Runs all remaining tasks now.
+ */
+void tilda_startup_finish (tilda_window *tw);
+
+/**
+ * Drops the remaining tasks without running them.
+ */
+void tilda_startup_free (tilda_window *tw);
+
+G_END_DECLS
+
+#endif /* TILDA_STARTUP_H */
@@ -0,0 +1,55 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L /* feature test macro for execl */
+
+/*
+ * tilda-toggle [instance_id]
+ *
+ * Toggles a running tilda instance like "tilda -T", but is a separate
+ * program that only links libc. Loading and initializing the GTK, GLib and
+ * VTE libraries of tilda takes far longer than the toggle itself, which
+ * matters when the command is bound to a hotkey. If the instance has no
+ * control socket, "tilda -T" is run instead, which toggles it over D-Bus.
+ */
+
+#include "tilda-control-client.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+int main (int argc, char *argv[])
+{
+    char option[32];
+    int instance;
+
+    if (argc > 2 || tilda_control_client_parse_instance (argc > 1 ? argv[1] : NULL, &instance) < 0) {
+        fprintf (stderr, "Usage: %s [instance_id]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (tilda_control_client_send (instance, TILDA_CONTROL_TOGGLE) == 0) {
+        return EXIT_SUCCESS;
+    }
+
+    snprintf (option, sizeof (option), "--toggle-window=%d", instance);
+    execl (BINDIR "/tilda", "tilda", option, (char *) NULL);
+
+    fprintf (stderr, "Could not run %s: ", BINDIR "/tilda");
+    perror (NULL);
+
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,383 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE /* feature test macro for clock_gettime and syscall */
+
+#include "tilda-trace.h"
+
+#include <gio/gio.h>
+#include <glib-unix.h>
+#include <glib/gi18n.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct
+{
+    gint64 time;
+    const gchar *name;
+    gchar phase;
+} TraceEvent;
+
+/* The ring buffer of a thread. Only the thread itself writes events and
+ * advances head, the trace is read by the main thread once tracing was
+ * stopped and writing is FALSE. The events from start up to head belong to
+ * the current trace. exited is set when the thread exited while tracing
+ * was active, the buffer is freed once the trace was written. */
+typedef struct
+{
+    glong tid;
+    guint head;
+    guint start;
+    gboolean writing;
+    gboolean exited;
+    TraceEvent events[TILDA_TRACE_BUFFER_EVENTS];
+} TraceBuffer;
+
+G_STATIC_ASSERT ((TILDA_TRACE_BUFFER_EVENTS & (TILDA_TRACE_BUFFER_EVENTS - 1)) == 0);
+
+gint tilda_trace_active;
+
+static void release_buffer (gpointer data);
+
+/* thread_buffer is the fast path, thread_buffer_key only releases the
+ * buffer when the thread exits */
+static __thread TraceBuffer *thread_buffer;
+static GPrivate thread_buffer_key = G_PRIVATE_INIT (release_buffer);
+
+/* The buffers of all running threads, and of the threads that exited
+ * during the current trace */
+static GMutex buffers_mutex;
+static GSList *buffers;
+
+static gint64 trace_start_time;
+
+static gint64
+now_nsec (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+
+    return (gint64) ts.tv_sec * G_GINT64_CONSTANT (1000000000) + ts.tv_nsec;
+}
+
+static TraceBuffer *
+create_buffer (void)
+{
+    TraceBuffer *buffer = g_new0 (TraceBuffer, 1);
+
+    g_mutex_lock (&buffers_mutex);
+
+#ifdef SYS_gettid
+    buffer->tid = syscall (SYS_gettid);
+#else
+    static glong next_tid = 1;
+    buffer->tid = next_tid++;
+#endif
+    buffers = g_slist_prepend (buffers, buffer);
+
+    g_mutex_unlock (&buffers_mutex);
+
+    g_private_set (&thread_buffer_key, buffer);
+
+    return buffer;
+}
+
+static void
+release_buffer (gpointer data)
+{
+    TraceBuffer *buffer = data;
+
+    thread_buffer = NULL;
+
+    g_mutex_lock (&buffers_mutex);
+
+    /* The events of the thread are still part of the current trace */
+    if (tilda_trace_is_active ()) {
+        buffer->exited = TRUE;
+    } else {
+        buffers = g_slist_remove (buffers, buffer);
+        g_free (buffer);
+    }
+
+    g_mutex_unlock (&buffers_mutex);
+}
+
+void
+tilda_trace_record (const gchar *name, gchar phase)
+{
+    TraceBuffer *buffer = thread_buffer;
+    TraceEvent *event;
+    guint head;
+
+    if (!__atomic_load_n (&tilda_trace_active, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    if (G_UNLIKELY (buffer == NULL)) {
+        buffer = thread_buffer = create_buffer ();
+    }
+
+    /* Pairs with tilda_trace_stop(): either it sees that this thread is
+     * writing and waits for it, or this thread sees that tracing stopped.
+     * Both need sequentially consistent ordering. */
+    __atomic_store_n (&buffer->writing, TRUE, __ATOMIC_SEQ_CST);
+
+    if (!__atomic_load_n (&tilda_trace_active, __ATOMIC_SEQ_CST)) {
+        __atomic_store_n (&buffer->writing, FALSE, __ATOMIC_RELEASE);
+        return;
+    }
+
+    head = buffer->head;
+    event = &buffer->events[head % TILDA_TRACE_BUFFER_EVENTS];
+    event->time = now_nsec ();
+    event->name = name;
+    event->phase = phase;
+
+    __atomic_store_n (&buffer->head, head + 1, __ATOMIC_RELAXED);
+
+    /* Publishes the event to the thread that writes the trace */
+    __atomic_store_n (&buffer->writing, FALSE, __ATOMIC_RELEASE);
+}
+
+void
+tilda_trace_start (void)
+{
+    if (tilda_trace_is_active ()) {
+        return;
+    }
+
+    g_mutex_lock (&buffers_mutex);
+
+    for (GSList *item = buffers; item != NULL; item = item->next) {
+        TraceBuffer *buffer = item->data;
+
+        buffer->start = __atomic_load_n (&buffer->head, __ATOMIC_RELAXED);
+    }
+
+    g_mutex_unlock (&buffers_mutex);
+
+    trace_start_time = now_nsec ();
+
+    __atomic_store_n (&tilda_trace_active, TRUE, __ATOMIC_RELEASE);
+}
+
+gboolean
+tilda_trace_is_active (void)
+{
+    return __atomic_load_n (&tilda_trace_active, __ATOMIC_ACQUIRE);
+}
+
+static void
+append_json_string (GString *json, const gchar *text)
+{
+    g_string_append_c (json, '"');
+
+    for (const gchar *c = text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            g_string_append_printf (json, "\\%c", *c);
+        } else if ((guchar) *c < 0x20) {
+            g_string_append_printf (json, "\\u%04x", (guint) *c);
+        } else {
+            g_string_append_c (json, *c);
+        }
+    }
+
+    g_string_append_c (json, '"');
+}
+
+/* Adds the name of the thread as metadata, if it is still running */
+static void
+append_thread_name (GString *json, glong tid)
+{
+    gchar *path = g_strdup_printf ("/proc/self/task/%ld/comm", tid);
+    gchar *name;
+
+    if (g_file_get_contents (path, &name, NULL, NULL)) {
+        g_string_append_printf (json,
+                                "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+                                "\"tid\":%ld,\"args\":{\"name\":",
+                                (gint) getpid (), tid);
+        append_json_string (json, g_strchomp (name));
+        g_string_append (json, "}},\n");
+        g_free (name);
+    }
+
+    g_free (path);
+}
+
+/* Waits until the thread of buffer finished the event it was recording
+ * when tracing was stopped. It cannot record more events afterwards. */
+static void
+wait_for_writer (TraceBuffer *buffer)
+{
+    while (__atomic_load_n (&buffer->writing, __ATOMIC_ACQUIRE)) {
+        g_thread_yield ();
+    }
+}
+
+static guint
+append_events (GString *json, TraceBuffer *buffer)
+{
+    guint head = buffer->head;
+    guint first = buffer->start;
+
+    if (head - first > TILDA_TRACE_BUFFER_EVENTS) {
+        first = head - TILDA_TRACE_BUFFER_EVENTS;
+    }
+
+    append_thread_name (json, buffer->tid);
+
+    for (guint i = first; i != head; i++) {
+        TraceEvent *event = &buffer->events[i % TILDA_TRACE_BUFFER_EVENTS];
+        gint64 time = event->time - trace_start_time;
+
+        g_string_append (json, "{\"name\":");
+        append_json_string (json, event->name);
+        g_string_append_printf (json,
+                                ",\"ph\":\"%c\",\"ts\":%" G_GINT64_FORMAT ".%03d,"
+                                "\"pid\":%d,\"tid\":%ld%s},\n",
+                                event->phase, time / 1000, (gint) (time % 1000),
+                                (gint) getpid (), buffer->tid,
+                                event->phase == 'i' ? ",\"s\":\"t\"" : "");
+    }
+
+    return head - first;
+}
+
+static gboolean
+is_file_name (const gchar *name)
+{
+    return name[0] != '\0' && strchr (name, G_DIR_SEPARATOR) == NULL
+        && strcmp (name, ".") != 0 && strcmp (name, "..") != 0;
+}
+
+gboolean
+tilda_trace_stop (const gchar *name, gchar **path, guint *n_events, GError **error)
+{
+    GString *json;
+    gchar *directory;
+    gchar *file;
+    gboolean written;
+    guint count = 0;
+
+    if (name != NULL && !is_file_name (name)) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_FILENAME,
+                     "The name of the trace must be a file name without a directory");
+        return FALSE;
+    }
+
+    if (!tilda_trace_is_active ()) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Tracing is not active");
+        return FALSE;
+    }
+
+    __atomic_store_n (&tilda_trace_active, FALSE, __ATOMIC_SEQ_CST);
+
+    json = g_string_new ("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    g_mutex_lock (&buffers_mutex);
+
+    for (GSList *item = buffers; item != NULL; item = item->next) {
+        wait_for_writer (item->data);
+        count += append_events (json, item->data);
+    }
+
+    /* The threads of these buffers exited while tracing was active */
+    for (GSList *item = buffers, *next; item != NULL; item = next) {
+        TraceBuffer *buffer = item->data;
+
+        next = item->next;
+
+        if (buffer->exited) {
+            buffers = g_slist_delete_link (buffers, item);
+            g_free (buffer);
+        }
+    }
+
+    g_mutex_unlock (&buffers_mutex);
+
+    /* Replace the separator after the last event */
+    if (json->str[json->len - 2] == ',') {
+        g_string_truncate (json, json->len - 2);
+    }
+
+    g_string_append (json, "\n]}\n");
+
+    if (name == NULL) {
+        GDateTime *now = g_date_time_new_now_local ();
+
+        file = g_date_time_format (now, "trace-%Y%m%d-%H%M%S.json");
+        g_date_time_unref (now);
+    } else {
+        file = g_strdup (name);
+    }
+
+    directory = g_build_filename (g_get_user_cache_dir (), "tilda", "traces", NULL);
+
+    /* If this fails, so does writing the trace and the error is returned */
+    g_mkdir_with_parents (directory, S_IRWXU);
+
+    *path = g_build_filename (directory, file, NULL);
+    written = g_file_set_contents (*path, json->str, (gssize) json->len, error);
+
+    if (!written) {
+        g_clear_pointer (path, g_free);
+    }
+
+    g_free (directory);
+    g_free (file);
+    g_string_free (json, TRUE);
+
+    if (written && n_events != NULL) {
+        *n_events = count;
+    }
+
+    return written;
+}
+
+static gboolean
+toggle_trace_cb (G_GNUC_UNUSED gpointer user_data)
+{
+    GError *error = NULL;
+    gchar *path;
+    guint n_events;
+
+    if (!tilda_trace_is_active ()) {
+        tilda_trace_start ();
+        g_print (_("Tracing started, send SIGUSR2 again to write the trace\n"));
+        return G_SOURCE_CONTINUE;
+    }
+
+    if (tilda_trace_stop (NULL, &path, &n_events, &error)) {
+        g_print (_("Wrote %u trace events to %s\n"), n_events, path);
+        g_free (path);
+    } else {
+        g_printerr (_("Could not write the trace: %s\n"), error->message);
+        g_error_free (error);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+void
+tilda_trace_init (void)
+{
+    g_unix_signal_add (SIGUSR2, toggle_trace_cb, NULL);
+}
@@ -0,0 +1,121 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILDA_TRACE_H
+#define TILDA_TRACE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Tracepoints that record the begin and the end of spans and instant events
+ * with a timestamp, so that the session of a user can be profiled without
+ * rebuilding tilda. Tracing is off by default and is switched on and off
+ * at runtime with SIGUSR2 or with the StartTrace and StopTrace D-Bus methods.
+ * A disabled tracepoint costs a relaxed load and a branch.
+ *
+ * Each thread records into its own ring buffer without locking. The buffer
+ * keeps the last TILDA_TRACE_BUFFER_EVENTS events of the thread, older
+ * events are overwritten. It is freed when the thread exits, or once the
+ * trace was written if tracing was active at that time. The trace is written in the Chrome trace event
+ * format, which can be opened with Perfetto, chrome://tracing or speedscope.
+ *
+ * DEBUG_FUNCTION() in debug.h is a span from the tracepoint until the end of
+ * the enclosing block.
+ */
+
+#define TILDA_TRACE_BUFFER_EVENTS 16384
+
+/* Do not use directly, this is only public for the inline functions below */
+extern gint tilda_trace_active;
+
+void tilda_trace_record (const gchar *name, gchar phase);
+
+static inline const gchar *
+tilda_trace_scope_begin (const gchar *name)
+{
+    if (G_LIKELY (!__atomic_load_n (&tilda_trace_active, __ATOMIC_RELAXED))) {
+        return NULL;
+    }
+
+    tilda_trace_record (name, 'B');
+
+    return name;
+}
+
+static inline void
+tilda_trace_scope_end (const gchar **name)
+{
+    if (G_UNLIKELY (*name != NULL)) {
+        tilda_trace_record (*name, 'E');
+    }
+}
+
+static inline void
+tilda_trace_instant (const gchar *name)
+{
+    if (G_UNLIKELY (__atomic_load_n (&tilda_trace_active, __ATOMIC_RELAXED))) {
+        tilda_trace_record (name, 'i');
+    }
+}
+
+/**
+ * Records a span with the given name from this point until the end of the
+ * enclosing block. The name must be a string that is never freed, usually a
+ * string literal or __func__. The end of a span is only recorded if its
+ * begin was recorded.
+ */
+#define TILDA_TRACE_SCOPE(NAME) \
+    G_GNUC_UNUSED __attribute__ ((cleanup (tilda_trace_scope_end))) \
+    const gchar *G_PASTE (tilda_trace_scope_, __LINE__) = tilda_trace_scope_begin (NAME)
+
+/**
+ * Records an event without a duration. The name must never be freed.
+ */
+#define TILDA_TRACE_INSTANT(NAME) tilda_trace_instant (NAME)
+
+/**
+ * Installs the SIGUSR2 handler that starts tracing and stops it again and
+ * writes the trace to a new file in ~/.cache/tilda/traces/.
+ */
+void tilda_trace_init (void);
+
+/**
+ * Discards all events that were recorded so far and starts tracing.
+ * Does nothing if tracing is already active.
+ */
+void tilda_trace_start (void);
+
+gboolean tilda_trace_is_active (void);
+
+/**
+ * Stops tracing and writes the recorded events to the file name in
+ * ~/.cache/tilda/traces/. If name is NULL, the file is named after the
+ * current date and time. The path of the file is stored in path and must
+ * be freed with g_free(), the number of events that were written is stored
+ * in n_events.
+ *
+ * Returns: FALSE and sets error if name is not a plain file name, tracing
+ * was not active or the file could not be written.
+ */
+gboolean tilda_trace_stop (const gchar *name,
+                           gchar **path,
+                           guint *n_events,
+                           GError **error);
+
+G_END_DECLS
+
+#endif /* TILDA_TRACE_H */
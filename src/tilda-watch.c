@@ -0,0 +1,606 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilda-watch.h"
+
+#include "configsys.h"
+#include "debug.h"
+#include "key_grabber.h"
+#include "tilda-regex-cache.h"
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <gtk/gtk.h>
+#include <string.h>
+#include <vte/vte.h>
+
+/* Output within this interval is scanned at once, in ms */
+#define TILDA_WATCH_INTERVAL 100
+
+/* The time a tab may spend scanning per interval, in microseconds */
+#define TILDA_WATCH_BUDGET 2000
+
+/* The number of rows that are read from the terminal at once */
+#define TILDA_WATCH_CHUNK 100
+
+/* The maximum length of the last line of a chunk that is scanned again
+ * with the next chunk, in bytes */
+#define TILDA_WATCH_TAIL_LENGTH 4096
+
+/* How long the tab label is highlighted if the tab is already shown, in ms */
+#define TILDA_WATCH_FLASH_DURATION 1000
+
+/* The maximum length of the matched line in notifications */
+#define TILDA_WATCH_NOTIFICATION_LENGTH 200
+
+#define TILDA_WATCH_STYLE_CLASS "alert"
+
+typedef struct
+{
+    guint id;
+    GRegex *regex;
+    guint actions;
+} TildaWatchRule;
+
+struct tilda_watch_
+{
+    /* The watchers of this tab, the global ones are in tw->watch_rules */
+    GList *rules;
+
+    /* The first row that has not been scanned yet, and the last line of
+     * the rows before it. The line is scanned again together with the
+     * next rows, so that matches across the end of a chunk are found. */
+    glong next_row;
+    gchar *tail;
+
+    guint scan_source;
+    guint flash_source;
+};
+
+static const struct {
+    const gchar *name;
+    enum tilda_watch_action action;
+} action_names[] = {
+    { "flash", TILDA_WATCH_ACTION_FLASH },
+    { "notify", TILDA_WATCH_ACTION_NOTIFY },
+    { "pull", TILDA_WATCH_ACTION_PULL }
+};
+
+static void
+watch_rule_free (TildaWatchRule *rule)
+{
+    g_regex_unref (rule->regex);
+    g_free (rule);
+}
+
+static TildaWatchRule *
+watch_rule_new (const gchar *pattern, guint actions, GError **error)
+{
+    static guint next_id = 1;
+
+    TildaWatchRule *rule;
+    GRegex *regex;
+
+    regex = tilda_regex_cache_get_regex (tilda_regex_cache_get_default (),
+                                         pattern, TRUE, TRUE, error);
+
+    if (regex == NULL) {
+        return NULL;
+    }
+
+    rule = g_new0 (TildaWatchRule, 1);
+    rule->id = next_id++;
+    rule->regex = regex;
+    rule->actions = actions;
+
+    return rule;
+}
+
+gboolean
+tilda_watch_parse_actions (const gchar * const *names,
+                           guint *actions,
+                           GError **error)
+{
+    *actions = 0;
+
+    for (; *names != NULL; names++)
+    {
+        gchar *name = g_strstrip (g_strdup (*names));
+        guint i;
+
+        for (i = 0; i < G_N_ELEMENTS (action_names); i++) {
+            if (g_strcmp0 (name, action_names[i].name) == 0) {
+                *actions |= action_names[i].action;
+                break;
+            }
+        }
+
+        if (i == G_N_ELEMENTS (action_names)) {
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                         _("Unknown output watcher action \"%s\""), name);
+            g_free (name);
+            return FALSE;
+        }
+
+        g_free (name);
+    }
+
+    return TRUE;
+}
+
+void
+tilda_watch_init (tilda_window *tw)
+{
+    DEBUG_FUNCTION ("tilda_watch_init");
+    DEBUG_ASSERT (tw != NULL);
+
+    guint count = config_getsize ("output_watchers");
+
+    /* Each watcher has the form "actions:pattern", e.g.
+     * "flash,notify:BUILD FAILED|Traceback" */
+    for (guint i = 0; i < count; i++)
+    {
+        const gchar *watcher = config_getnstr ("output_watchers", i);
+        const gchar *separator = strchr (watcher, ':');
+        TildaWatchRule *rule;
+        GError *error = NULL;
+        gchar *action_list;
+        gchar **names;
+        guint actions;
+
+        if (separator == NULL) {
+            g_printerr (_("Ignoring the output watcher \"%s\", the format is \"actions:pattern\"\n"),
+                        watcher);
+            continue;
+        }
+
+        action_list = g_strndup (watcher, (gsize) (separator - watcher));
+        names = g_strsplit (action_list, ",", -1);
+        g_free (action_list);
+
+        if (tilda_watch_parse_actions ((const gchar * const *) names, &actions, &error)) {
+            rule = watch_rule_new (separator + 1, actions, &error);
+
+            if (rule != NULL) {
+                tw->watch_rules = g_list_append (tw->watch_rules, rule);
+            }
+        }
+
+        if (error != NULL) {
+            g_printerr (_("Ignoring the output watcher \"%s\": %s\n"), watcher, error->message);
+            g_error_free (error);
+        }
+
+        g_strfreev (names);
+    }
+}
+
+static glong
+get_cursor_row (tilda_term *tt)
+{
+    glong row;
+
+    vte_terminal_get_cursor_position (VTE_TERMINAL (tt->vte_term), NULL, &row);
+
+    return row;
+}
+
+static struct tilda_watch_ *
+ensure_watch (tilda_term *tt, glong next_row)
+{
+    if (tt->watch == NULL) {
+        tt->watch = g_new0 (struct tilda_watch_, 1);
+        tt->watch->next_row = next_row;
+    }
+
+    return tt->watch;
+}
+
+static gboolean
+unflash_cb (gpointer user_data)
+{
+    tilda_term *tt = user_data;
+
+    tt->watch->flash_source = 0;
+    tilda_watch_tab_shown (tt);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+flash (tilda_term *tt)
+{
+    tilda_window *tw = tt->tw;
+    GtkWidget *label;
+    gint page;
+
+    label = gtk_notebook_get_tab_label (GTK_NOTEBOOK (tw->notebook), tt->hbox);
+
+    if (label == NULL) {
+        return;
+    }
+
+    gtk_style_context_add_class (gtk_widget_get_style_context (label), TILDA_WATCH_STYLE_CLASS);
+
+    /* A tab that is already shown is only highlighted briefly, other tabs
+     * stay highlighted until the user looks at them. */
+    page = gtk_notebook_get_current_page (GTK_NOTEBOOK (tw->notebook));
+
+    if (tw->current_state == STATE_DOWN && g_list_nth_data (tw->terms, (guint) page) == tt
+        && tt->watch->flash_source == 0)
+    {
+        tt->watch->flash_source = g_timeout_add (TILDA_WATCH_FLASH_DURATION, unflash_cb, tt);
+    }
+}
+
+static void
+bus_ready_cb (G_GNUC_UNUSED GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    GVariant *parameters = user_data;
+    GDBusConnection *connection;
+
+    connection = g_bus_get_finish (result, NULL);
+
+    if (connection == NULL) {
+        g_variant_unref (parameters);
+        return;
+    }
+
+    g_dbus_connection_call (connection,
+                            "org.freedesktop.Notifications",
+                            "/org/freedesktop/Notifications",
+                            "org.freedesktop.Notifications",
+                            "Notify",
+                            parameters,
+                            NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+
+    g_object_unref (connection);
+}
+
+static void
+notify (tilda_term *tt, const gchar *line)
+{
+    GVariant *parameters;
+    gchar *title;
+    gchar *body;
+
+    title = tilda_terminal_get_title (tt);
+    body = g_utf8_substring (line, 0, TILDA_WATCH_NOTIFICATION_LENGTH);
+
+    parameters = g_variant_new ("(susss@as@a{sv}i)",
+                                "Tilda", 0, "tilda",
+                                title != NULL ? title : "Tilda",
+                                body,
+                                g_variant_new_strv (NULL, 0),
+                                g_variant_new_array (G_VARIANT_TYPE ("{sv}"), NULL, 0),
+                                -1);
+
+    /* Connecting to the bus must not block the terminal, the connection
+     * is usually already open and is then returned right away. */
+    g_bus_get (G_BUS_TYPE_SESSION, NULL, bus_ready_cb, g_variant_ref_sink (parameters));
+
+    g_free (title);
+    g_free (body);
+}
+
+static void
+show_tab (tilda_term *tt)
+{
+    tilda_window *tw = tt->tw;
+
+    if (tw->current_state == STATE_UP) {
+        pull (tw, PULL_DOWN, FALSE);
+    }
+
+    gtk_notebook_set_current_page (GTK_NOTEBOOK (tw->notebook),
+                                   gtk_notebook_page_num (GTK_NOTEBOOK (tw->notebook), tt->hbox));
+}
+
+/* Returns the line of text that contains the match at offset */
+static gchar *
+get_matched_line (const gchar *text, gint offset)
+{
+    const gchar *start = text + offset;
+    const gchar *end = strchr (start, '\n');
+
+    while (start > text && start[-1] != '\n') {
+        start--;
+    }
+
+    return end != NULL ? g_strndup (start, (gsize) (end - start)) : g_strdup (start);
+}
+
+/* Returns the last line of text, which may be incomplete, at most
+ * TILDA_WATCH_TAIL_LENGTH bytes of it */
+static gchar *
+get_last_line (const gchar *text)
+{
+    const gchar *end = text + strlen (text);
+    const gchar *start = end;
+
+    if (start > text && start[-1] == '\n') {
+        start--;
+    }
+
+    while (start > text && start[-1] != '\n') {
+        start--;
+    }
+
+    if (end - start > TILDA_WATCH_TAIL_LENGTH) {
+        start = g_utf8_find_next_char (end - TILDA_WATCH_TAIL_LENGTH - 1, NULL);
+    }
+
+    return g_strdup (start);
+}
+
+/* Finds the first match of regex in text that ends after the first
+ * carried bytes, which were already scanned with the previous chunk */
+static gboolean
+find_new_match (GRegex *regex, const gchar *text, gint carried, gint *start)
+{
+    GMatchInfo *match_info = NULL;
+    gboolean found = FALSE;
+    gint end;
+
+    g_regex_match (regex, text, 0, &match_info);
+
+    while (g_match_info_matches (match_info))
+    {
+        g_match_info_fetch_pos (match_info, 0, start, &end);
+
+        if (end > carried) {
+            found = TRUE;
+            break;
+        }
+
+        g_match_info_next (match_info, NULL);
+    }
+
+    g_match_info_free (match_info);
+
+    return found;
+}
+
+/* Checks the rules against text. Each rule is triggered at most once per
+ * scan, so a burst of matching output results in a single notification. */
+static void
+check_rules (tilda_term *tt,
+             GList *rules,
+             const gchar *text,
+             gint carried,
+             GList **triggered)
+{
+    for (GList *item = rules; item != NULL; item = item->next)
+    {
+        TildaWatchRule *rule = item->data;
+        gint start;
+
+        if (g_list_find (*triggered, rule) != NULL
+            || !find_new_match (rule->regex, text, carried, &start))
+        {
+            continue;
+        }
+
+        *triggered = g_list_prepend (*triggered, rule);
+
+        if (rule->actions & TILDA_WATCH_ACTION_FLASH) {
+            flash (tt);
+        }
+
+        if (rule->actions & TILDA_WATCH_ACTION_NOTIFY) {
+            gchar *line = get_matched_line (text, start);
+            notify (tt, line);
+            g_free (line);
+        }
+
+        if (rule->actions & TILDA_WATCH_ACTION_PULL) {
+            show_tab (tt);
+        }
+    }
+}
+
+/* Scans the rows that were completed since the last scan. Returns TRUE if
+ * the time budget ran out before all rows were scanned. */
+static gboolean
+scan_new_rows (tilda_term *tt)
+{
+    struct tilda_watch_ *watch = tt->watch;
+    GtkAdjustment *adjustment;
+    GList *triggered = NULL;
+    gint64 deadline;
+    glong cursor_row;
+    glong first_row;
+
+    adjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (tt->vte_term));
+    first_row = (glong) gtk_adjustment_get_lower (adjustment);
+    cursor_row = get_cursor_row (tt);
+
+    /* Rows may have left the history before they were scanned, and the
+     * cursor moves back if the terminal was reset. The tail does not
+     * precede the next row then. */
+    if (watch->next_row < first_row || watch->next_row > cursor_row) {
+        watch->next_row = CLAMP (watch->next_row, first_row, cursor_row);
+        g_clear_pointer (&watch->tail, g_free);
+    }
+
+    deadline = g_get_monotonic_time () + TILDA_WATCH_BUDGET;
+
+    while (watch->next_row < cursor_row && g_get_monotonic_time () < deadline)
+    {
+        glong end_row = MIN (watch->next_row + TILDA_WATCH_CHUNK, cursor_row);
+        gchar *rows = tilda_terminal_get_rows_text (tt, watch->next_row, end_row);
+        gchar *text;
+        gint carried;
+
+        watch->next_row = end_row;
+
+        if (rows == NULL) {
+            g_clear_pointer (&watch->tail, g_free);
+            continue;
+        }
+
+        carried = watch->tail != NULL ? (gint) strlen (watch->tail) : 0;
+        text = g_strconcat (watch->tail != NULL ? watch->tail : "", rows, NULL);
+        g_free (rows);
+
+        check_rules (tt, watch->rules, text, carried, &triggered);
+        check_rules (tt, tt->tw->watch_rules, text, carried, &triggered);
+
+        g_free (watch->tail);
+        watch->tail = get_last_line (text);
+
+        g_free (text);
+    }
+
+    g_list_free (triggered);
+
+    return watch->next_row < cursor_row;
+}
+
+static gboolean
+scan_cb (gpointer user_data)
+{
+    tilda_term *tt = user_data;
+
+    if (scan_new_rows (tt)) {
+        return G_SOURCE_CONTINUE;
+    }
+
+    tt->watch->scan_source = 0;
+
+    return G_SOURCE_REMOVE;
+}
+
+void
+tilda_watch_contents_changed (tilda_term *tt)
+{
+    struct tilda_watch_ *watch = tt->watch;
+
+    if (tt->tw->watch_rules == NULL && (watch == NULL || watch->rules == NULL)) {
+        return;
+    }
+
+    /* A new tab is scanned from its first row */
+    watch = ensure_watch (tt, 0);
+
+    if (watch->scan_source == 0) {
+        watch->scan_source = g_timeout_add (TILDA_WATCH_INTERVAL, scan_cb, tt);
+    }
+}
+
+guint
+tilda_watch_add (tilda_term *tt,
+                 const gchar *pattern,
+                 guint actions,
+                 GError **error)
+{
+    DEBUG_FUNCTION ("tilda_watch_add");
+    DEBUG_ASSERT (tt != NULL);
+    DEBUG_ASSERT (pattern != NULL);
+
+    struct tilda_watch_ *watch;
+    TildaWatchRule *rule;
+
+    rule = watch_rule_new (pattern, actions, error);
+
+    if (rule == NULL) {
+        return 0;
+    }
+
+    /* Output that was already there before the watcher is ignored */
+    watch = ensure_watch (tt, get_cursor_row (tt));
+    watch->rules = g_list_append (watch->rules, rule);
+
+    return rule->id;
+}
+
+gboolean
+tilda_watch_remove (tilda_term *tt, guint id)
+{
+    DEBUG_FUNCTION ("tilda_watch_remove");
+    DEBUG_ASSERT (tt != NULL);
+
+    if (tt->watch == NULL) {
+        return FALSE;
+    }
+
+    for (GList *item = tt->watch->rules; item != NULL; item = item->next)
+    {
+        TildaWatchRule *rule = item->data;
+
+        if (rule->id == id) {
+            tt->watch->rules = g_list_delete_link (tt->watch->rules, item);
+            watch_rule_free (rule);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+void
+tilda_watch_tab_shown (tilda_term *tt)
+{
+    GtkWidget *label;
+
+    if (tt->watch == NULL) {
+        return;
+    }
+
+    label = gtk_notebook_get_tab_label (GTK_NOTEBOOK (tt->tw->notebook), tt->hbox);
+
+    if (label != NULL) {
+        gtk_style_context_remove_class (gtk_widget_get_style_context (label),
+                                        TILDA_WATCH_STYLE_CLASS);
+    }
+}
+
+void
+tilda_watch_forget (tilda_term *tt)
+{
+    DEBUG_FUNCTION ("tilda_watch_forget");
+    DEBUG_ASSERT (tt != NULL);
+
+    struct tilda_watch_ *watch = tt->watch;
+
+    if (watch == NULL) {
+        return;
+    }
+
+    if (watch->scan_source) {
+        g_source_remove (watch->scan_source);
+    }
+
+    if (watch->flash_source) {
+        g_source_remove (watch->flash_source);
+    }
+
+    g_list_free_full (watch->rules, (GDestroyNotify) watch_rule_free);
+    g_free (watch->tail);
+    g_free (watch);
+
+    tt->watch = NULL;
+}
+
+void
+tilda_watch_free (tilda_window *tw)
+{
+    DEBUG_FUNCTION ("tilda_watch_free");
+    DEBUG_ASSERT (tw != NULL);
+
+    g_list_free_full (tw->watch_rules, (GDestroyNotify) watch_rule_free);
+    tw->watch_rules = NULL;
+}
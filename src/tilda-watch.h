@@ -0,0 +1,101 @@
+/*
+ * This is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Library General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILDA_WATCH_H
+#define TILDA_WATCH_H
+
+#include "tilda_window.h"
+#include "tilda_terminal.h"
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Output watchers trigger actions when new output of a tab matches a
+ * regular expression, e.g. "BUILD FAILED|Traceback".
+ *
+ * Global watchers are configured with the "output_watchers" option and
+ * apply to all tabs, watchers for a single tab can be added over D-Bus.
+ *
+ * Only rows that were completed since the last scan are searched, from the
+ * row after the last scanned one up to the row of the cursor. Bursts of
+ * output are coalesced into one scan, and each scan of a tab only gets a
+ * small time budget. If a tab produces more output than can be scanned,
+ * rows that leave the history before they were scanned are skipped.
+ */
+
+enum tilda_watch_action {
+    /* Highlight the tab label until the tab is shown */
+    TILDA_WATCH_ACTION_FLASH  = 1 << 0,
+    /* Send a desktop notification */
+    TILDA_WATCH_ACTION_NOTIFY = 1 << 1,
+    /* Pull down the window and show the tab */
+    TILDA_WATCH_ACTION_PULL   = 1 << 2
+};
+
+/**
+ * Reads the global watchers from the configuration.
+ */
+void     tilda_watch_init (tilda_window *tw);
+
+/**
+ * Parses action names ("flash", "notify", "pull") into a combination of
+ * enum tilda_watch_action values.
+ */
+gboolean tilda_watch_parse_actions (const gchar * const *names,
+                                    guint *actions,
+                                    GError **error);
+
+/**
+ * Adds a watcher for a single tab. Returns the id of the watcher, or 0 if
+ * the pattern is not a valid regular expression.
+ */
+guint    tilda_watch_add (tilda_term *tt,
+                          const gchar *pattern,
+                          guint actions,
+                          GError **error);
+
+/**
+ * Removes a watcher that was added with tilda_watch_add(). Returns FALSE
+ * if the tab has no watcher with this id.
+ */
+gboolean tilda_watch_remove (tilda_term *tt, guint id);
+
+/**
+ * Must be called when the contents of the terminal changed, schedules a
+ * scan of the new rows.
+ */
+void     tilda_watch_contents_changed (tilda_term *tt);
+
+/**
+ * Must be called when the tab was shown, removes the highlight of the
+ * flash action.
+ */
+void     tilda_watch_tab_shown (tilda_term *tt);
+
+/**
+ * Removes the watchers of the tab, must be called before the tab is freed.
+ */
+void     tilda_watch_forget (tilda_term *tt);
+
+/**
+ * Frees the global watchers.
+ */
+void     tilda_watch_free (tilda_window *tw);
+
+G_END_DECLS
+
+#endif /* TILDA_WATCH_H */
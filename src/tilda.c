@@ -41,9 +41,15 @@
 #include "debug.h"
 #include "key_grabber.h" /* for pull */
 #include "tilda-cli-options.h"
+#include "tilda-control-socket.h"
 #include "tilda-dbus-actions.h"
 #include "tilda-keybinding.h"
 #include "tilda-lock-files.h"
+#include "tilda-metrics.h"
+#include "tilda-session.h"
+#include "tilda-startup.h"
+#include "tilda-startup-profile.h"
+#include "tilda-trace.h"
 #include "tilda_window.h"
 #include "tomboykeybinder.h"
 #include "wizard.h"
@@ -64,6 +70,9 @@
 static void setup_signal_handlers (void);
 static void show_startup_dialog (int config_init_result);
 
+/* The D-Bus name owner id, 0 until the D-Bus startup task has run */
+static guint bus_identifier = 0;
+
 /**
  * Set values in the config from command-line parameters
  *
@@ -215,8 +224,56 @@ static void load_custom_css_file () {
     g_free (filename);
 }
 
+static void load_custom_css_file_task (G_GNUC_UNUSED tilda_window *tw)
+{
+    load_custom_css_file ();
+}
+
+static void init_keybinder_task (G_GNUC_UNUSED tilda_window *tw)
+{
+    tomboy_keybinder_init ();
+}
+
+static void bind_key_task (tilda_window *tw)
+{
+    gint ret = tilda_keygrabber_bind (config_getstr ("key"), tw);
+
+    if (!ret)
+    {
+        /* The key was unbindable, so we need to show the wizard */
+        const char *message = _("The keybinding you chose for \"Pull Down Terminal\" is invalid. Please choose another.");
+
+        tilda_keybinding_show_invalid_keybinding_dialog (NULL,
+                                                         message);
+        wizard (tw);
+    }
+}
+
+static void init_dbus_task (tilda_window *tw)
+{
+    gchar *bus_name = tilda_dbus_actions_get_bus_name (tw);
+
+    g_print ("Activating D-Bus interface on bus name: %s\n",
+             bus_name);
+
+    g_free (bus_name);
+
+    bus_identifier = tilda_dbus_actions_init (tw);
+    tilda_control_socket_init (tw);
+}
+
 int main (int argc, char *argv[])
 {
+    /* Toggling a running instance is bound to a hotkey and must be fast,
+     * so it is tried before anything is initialized. If the instance has
+     * no control socket, the command line is handled as usual below and
+     * the toggle goes through D-Bus. */
+    if (tilda_control_socket_try_toggle (argc, argv)) {
+        return EXIT_SUCCESS;
+    }
+
+    tilda_startup_profile_init ();
+
 #ifdef DEBUG
     /**
      * This enables the tilda log domain while we are in debug mode. This
@@ -233,6 +290,7 @@ int main (int argc, char *argv[])
     struct lock_info lock;
     gboolean need_wizard = FALSE;
     gchar *config_file;
+    gint64 phase_start;
 
 #if ENABLE_NLS
     /* Gettext Initialization */
@@ -248,8 +306,11 @@ int main (int argc, char *argv[])
     config_file = NULL;
 
     /* Parse the command line */
+    phase_start = g_get_monotonic_time ();
     tilda_cli_options *cli_options = tilda_cli_options_new ();
     need_wizard = tilda_cli_options_parse_options (cli_options, argc, argv, &config_file);
+    tilda_startup_profile_set_print (cli_options->profile_startup);
+    tilda_startup_profile_phase ("option-parse", phase_start);
 
     if (cli_options->toggle_window > -1)
     {
@@ -260,6 +321,20 @@ int main (int argc, char *argv[])
         return EXIT_SUCCESS;
     }
 
+    if (cli_options->show_stats > -1)
+    {
+        gboolean printed = tilda_dbus_actions_print_metrics (cli_options->show_stats);
+
+        g_free(cli_options);
+
+        return printed ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    tilda_metrics_init ();
+    tilda_trace_init ();
+
+    phase_start = g_get_monotonic_time ();
+
     if (!tilda_lock_files_obtain_instance_lock (&lock)) {
 
         g_free(cli_options);
@@ -267,6 +342,8 @@ int main (int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
+    tilda_startup_profile_phase ("lock-files", phase_start);
+
     if (config_file) {	  // if there was a config file specified via cli
         if (!g_file_test (config_file, G_FILE_TEST_EXISTS)) {
             g_printerr (_("Specified config file '%s' does not exist. Reverting to default path.\n"),
@@ -278,10 +355,12 @@ int main (int argc, char *argv[])
     }
 
     /* Start up the configuration system and load from file */
+    phase_start = g_get_monotonic_time ();
     gint config_init_result = config_init (config_file);
 
     /* Set up possible overridden config options */
     setup_config_from_cli_options (cli_options);
+    tilda_startup_profile_phase ("config-init", phase_start);
 
     /* Set supported backend to X11 */
     gdk_set_allowed_backends ("x11");
@@ -293,25 +372,24 @@ int main (int argc, char *argv[])
     /* Initialize GTK. Any code that interacts with GTK (e.g. creating a widget)
      * should come after this call. Gtk initialization should happen before we
      * initialize the config file. */
+    phase_start = g_get_monotonic_time ();
     gtk_init (&argc, &argv);
+    tilda_startup_profile_phase ("gtk-init", phase_start);
 
     if (config_init_result > 0) {
         show_startup_dialog (config_init_result);
     }
 
-    load_custom_css_file ();
-
     /* create new tilda_window */
+    phase_start = g_get_monotonic_time ();
     gboolean success = tilda_window_init (config_file, lock.instance, &tw);
+    tilda_startup_profile_phase ("window-init", phase_start);
 
     if(!success) {
         fprintf(stderr, "tilda.c: initialization failed\n");
         goto initialization_failed;
     }
 
-    /* Initialize and set up the keybinding to toggle tilda's visibility. */
-    tomboy_keybinder_init ();
-
     setup_signal_handlers ();
 
     /* If the config file doesn't exist open up the wizard */
@@ -325,54 +403,46 @@ int main (int argc, char *argv[])
         need_wizard = TRUE;
     }
 
-    guint bus_identifier = 0;
+    /* Everything that is not needed to show the window with a running
+     * shell is done after the first frame, see tilda-startup.c */
+    tilda_startup_add (&tw, TILDA_STARTUP_STYLE, "deferred/custom-css", load_custom_css_file_task);
 
     if (cli_options->enable_dbus) {
-
-        gchar *bus_name = tilda_dbus_actions_get_bus_name (&tw);
-
-        g_print ("Activating D-Bus interface on bus name: %s\n",
-                 bus_name);
-
-        g_free (bus_name);
-
-        bus_identifier = tilda_dbus_actions_init (&tw);
-
         tilda_window_set_dbus_enabled (&tw, TRUE);
+        tilda_startup_add (&tw, TILDA_STARTUP_DBUS, "deferred/dbus", init_dbus_task);
     }
 
+    /* Initialize and set up the keybinding to toggle tilda's visibility. */
+    tilda_startup_add (&tw, TILDA_STARTUP_KEYBINDING, "deferred/keybinder", init_keybinder_task);
+
     /* Show the wizard if we need to.
      *
      * Note that the key will be bound upon exiting the wizard */
     if (need_wizard) {
         g_print ("Starting the wizard to configure tilda options.\n");
         wizard (&tw);
-    } else {
-        if (!cli_options->enable_dbus) {
-            gint ret = tilda_keygrabber_bind (config_getstr ("key"), &tw);
-
-            if (!ret)
-            {
-                /* The key was unbindable, so we need to show the wizard */
-                const char *message = _("The keybinding you chose for \"Pull Down Terminal\" is invalid. Please choose another.");
-
-                tilda_keybinding_show_invalid_keybinding_dialog (NULL,
-                                                                 message);
-                wizard (&tw);
-            }
-        }
+    } else if (!cli_options->enable_dbus) {
+        tilda_startup_add (&tw, TILDA_STARTUP_KEYBINDING, "deferred/keybinding", bind_key_task);
     }
 
     g_free(cli_options);
 
+    phase_start = g_get_monotonic_time ();
     pull (&tw, config_getbool ("hidden") ? PULL_UP : PULL_DOWN, FALSE);
+    tilda_startup_profile_phase ("first-pull", phase_start);
+
+    tilda_startup_run (&tw);
 
     g_print ("Tilda has started. Press %s to pull down the window.\n",
         config_getstr ("key"));
     /* Whew! We're finally all set up and ready to run GTK ... */
     gtk_main();
 
+    tilda_session_save_now (&tw);
+
     if (bus_identifier != 0) {
+        tilda_control_socket_free (&tw);
+        tilda_dbus_actions_unexport (&tw);
         tilda_dbus_actions_finish (bus_identifier);
     }
 
@@ -384,8 +454,6 @@ initialization_failed:
 
     tilda_lock_files_free (&lock);
 
-    close(lock.file_descriptor);
-
     g_free (config_file);
     return 0;
 }
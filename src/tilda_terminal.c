@@ -19,7 +19,17 @@
 #include "configsys.h"
 #include "debug.h"
 #include "tilda.h"
+#include "tilda-activity.h"
 #include "tilda-context-menu.h"
+#include "tilda-dbus-actions.h"
+#include "tilda-foreground.h"
+#include "tilda-metrics.h"
+#include "tilda-paste.h"
+#include "tilda-recorder.h"
+#include "tilda-watch.h"
+#include "tilda-restart.h"
+#include "tilda-session.h"
+#include "tilda-startup-profile.h"
 #include "tilda-url-spawner.h"
 #include "tilda_window.h"
 
@@ -39,6 +49,8 @@ static gint tilda_term_config_defaults (tilda_term *tt);
 
 static void child_exited_cb (GtkWidget *widget, gint status, gpointer data);
 static void window_title_changed_cb (GtkWidget *widget, gpointer data);
+static void contents_changed_cb (GtkWidget *widget, gpointer data);
+static void current_directory_uri_changed_cb (GtkWidget *widget, gpointer data);
 static gboolean button_press_cb (GtkWidget *widget, GdkEvent *event, tilda_term *terminal);
 static gboolean key_press_cb (GtkWidget *widget, GdkEvent  *event, tilda_term *terminal);
 static void handle_left_button_click (GtkWidget * window,
@@ -67,8 +79,24 @@ gint tilda_term_free (tilda_term *term)
     DEBUG_ASSERT (term != NULL);
 
     g_free (term->initial_working_dir);
+    g_free (term->cwd);
+    g_free (term->command);
+    g_free (term->session_scrollback_file);
+    g_free (term->foreground_name);
+    g_free (term->title_cwd);
+
+    if (term->pending_input != NULL) {
+        g_string_free (term->pending_input, TRUE);
+    }
+
+    tilda_foreground_forget (term);
+    tilda_restart_forget (term);
+    tilda_paste_cancel (term);
+    tilda_recorder_free (term);
+    tilda_watch_forget (term);
 
     g_signal_handlers_disconnect_by_func (term->vte_term, child_exited_cb, term);
+    g_signal_handlers_disconnect_by_func (term->vte_term, contents_changed_cb, term);
 
     g_clear_object (&term->hbox);
     g_clear_object (&term->scrollbar);
@@ -137,9 +165,20 @@ register_match (VteRegex * regex,
 
 struct tilda_term_ *tilda_term_init (struct tilda_window_ *tw, gint index)
 {
-    DEBUG_FUNCTION ("tilda_term_init");
+    return tilda_term_init_full (tw, index, NULL, NULL, FALSE);
+}
+
+struct tilda_term_ *tilda_term_init_full (struct tilda_window_ *tw,
+                                          gint index,
+                                          const gchar *working_dir,
+                                          const gchar *command,
+                                          gboolean defer_spawn)
+{
+    DEBUG_FUNCTION ("tilda_term_init_full");
     DEBUG_ASSERT (tw != NULL);
 
+    static guint next_id = 1;
+
     struct tilda_term_ *term;
     tilda_term *current_tt;
     gint current_tt_index;
@@ -156,6 +195,11 @@ struct tilda_term_ *tilda_term_init (struct tilda_window_ *tw, gint index)
     /* Set the PID to unset value */
     term->pid = -1;
 
+    term->id = next_id++;
+    term->foreground_pid = -1;
+    term->search_anchor = -1;
+    term->command = g_strdup (command);
+
     /* Add the parent window reference */
     term->tw = tw;
 
@@ -196,11 +240,18 @@ struct tilda_term_ *tilda_term_init (struct tilda_window_ *tw, gint index)
                       G_CALLBACK(child_exited_cb), term);
     g_signal_connect (G_OBJECT(term->vte_term), "window-title-changed",
                       G_CALLBACK(window_title_changed_cb), term);
+    g_signal_connect (G_OBJECT(term->vte_term), "contents-changed",
+                      G_CALLBACK(contents_changed_cb), term);
+    g_signal_connect (G_OBJECT(term->vte_term), "current-directory-uri-changed",
+                      G_CALLBACK(current_directory_uri_changed_cb), term);
     g_signal_connect (G_OBJECT(term->vte_term), "button-press-event",
                       G_CALLBACK(button_press_cb), term);
     g_signal_connect (G_OBJECT(term->vte_term), "key-press-event",
 		      G_CALLBACK(key_press_cb), term); //needs GDK_KEY_PRESS_MASK
 
+    tilda_activity_set_monitoring (term, config_getbool ("monitor_activity"),
+                                   (guint) MAX (config_getint ("monitor_silence"), 0));
+
     /* Connect to application request signals. */
     g_signal_connect (G_OBJECT(term->vte_term), "iconify-window",
                       G_CALLBACK(iconify_window_cb), tw->window);
@@ -222,26 +273,109 @@ struct tilda_term_ *tilda_term_init (struct tilda_window_ *tw, gint index)
     TildaMatchRegistry * registry = tilda_match_registry_new ();
     term->registry = registry;
 
-    tilda_match_registry_for_each (term->registry, register_match, term);
+    /* During startup the matches of all terminals are registered later
+     * by a task of tilda-startup.c */
+    if (!tw->matches_deferred) {
+        tilda_match_registry_for_each (term->registry, register_match, term);
+    }
 
     /* Show the child widgets */
     gtk_widget_show (term->vte_term);
     gtk_widget_show (term->hbox);
 
-    /* Get current term's working directory */
-    current_tt_index = gtk_notebook_get_current_page (GTK_NOTEBOOK(tw->notebook));
-    current_tt = g_list_nth_data (tw->terms, current_tt_index);
-    if (current_tt != NULL)
+    if (working_dir != NULL)
     {
-        term->initial_working_dir = tilda_term_get_cwd (current_tt);
+        term->initial_working_dir = g_strdup (working_dir);
+        term->explicit_working_dir = TRUE;
+    }
+    else
+    {
+        /* Get current term's working directory */
+        current_tt_index = gtk_notebook_get_current_page (GTK_NOTEBOOK(tw->notebook));
+        current_tt = g_list_nth_data (tw->terms, current_tt_index);
+        if (current_tt != NULL)
+        {
+            term->initial_working_dir = tilda_term_get_cwd (current_tt);
+        }
     }
 
-    /* Fork the appropriate command into the terminal */
-    start_shell (term, FALSE);
+    /* Fork the appropriate command into the terminal, unless the caller
+     * wants to do this later. */
+    term->spawn_deferred = defer_spawn;
+
+    if (!defer_spawn) {
+        start_shell (term, FALSE);
+    }
 
     return term;
 }
 
+void tilda_term_spawn_deferred (tilda_term *tt)
+{
+    DEBUG_FUNCTION ("tilda_term_spawn_deferred");
+    DEBUG_ASSERT (tt != NULL);
+
+    if (!tt->spawn_deferred) {
+        return;
+    }
+
+    tt->spawn_deferred = FALSE;
+    start_shell (tt, FALSE);
+}
+
+gboolean tilda_term_feed_child (tilda_term *tt, const gchar *text, gssize length)
+{
+    DEBUG_FUNCTION ("tilda_term_feed_child");
+    DEBUG_ASSERT (tt != NULL);
+    DEBUG_ASSERT (text != NULL);
+
+    if (length < 0) {
+        length = (gssize) strlen (text);
+    }
+
+    /* The terminal only gets its pty once the shell was spawned */
+    if (tt->spawn_deferred || tt->spawn_pending) {
+        if (tt->pending_input == NULL) {
+            tt->pending_input = g_string_new (NULL);
+        }
+
+        g_string_append_len (tt->pending_input, text, length);
+        return TRUE;
+    }
+
+    if (tt->pid < 0) {
+        return FALSE;
+    }
+
+    vte_terminal_feed_child (VTE_TERMINAL (tt->vte_term), text, length);
+
+    return TRUE;
+}
+
+void tilda_term_respawn (tilda_term *tt)
+{
+    DEBUG_FUNCTION ("tilda_term_respawn");
+    DEBUG_ASSERT (tt != NULL);
+
+    start_shell (tt, FALSE);
+}
+
+gchar *
+tilda_terminal_get_rows_text (tilda_term *tt, glong start_row, glong end_row)
+{
+    VteTerminal *terminal = VTE_TERMINAL (tt->vte_term);
+    glong columns = vte_terminal_get_column_count (terminal);
+
+#if VTE_CHECK_VERSION (0, 72, 0)
+    return vte_terminal_get_text_range_format (terminal, VTE_FORMAT_TEXT,
+                                               start_row, 0, end_row - 1, columns,
+                                               NULL);
+#else
+    return vte_terminal_get_text_range (terminal, start_row, 0, end_row - 1, columns,
+                                        NULL, NULL, NULL);
+#endif
+}
+
 void tilda_terminal_update_matches (tilda_term *tt) {
 
     vte_terminal_match_remove_all (VTE_TERMINAL (tt->vte_term));
@@ -249,6 +383,51 @@ void tilda_terminal_update_matches (tilda_term *tt) {
     tilda_match_registry_for_each (tt->registry, register_match, tt);
 }
 
+gboolean tilda_terminal_search (tilda_term *tt,
+                                VteRegex *regex,
+                                gboolean backward,
+                                gboolean wrap_around)
+{
+    gint64 start_time = g_get_monotonic_time ();
+    VteTerminal *terminal = VTE_TERMINAL (tt->vte_term);
+    gboolean found;
+
+    vte_terminal_search_set_regex (terminal, regex, 0);
+    vte_terminal_search_set_wrap_around (terminal, wrap_around);
+
+    if (backward) {
+        found = vte_terminal_search_find_previous (terminal);
+    } else {
+        found = vte_terminal_search_find_next (terminal);
+    }
+
+    tilda_metrics_observe (TILDA_METRIC_SEARCH_TIME, g_get_monotonic_time () - start_time);
+
+    return found;
+}
+
+void tilda_terminal_search_set_anchor (tilda_term *tt)
+{
+    GtkAdjustment *adjustment;
+
+    adjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (tt->vte_term));
+    tt->search_anchor = gtk_adjustment_get_value (adjustment);
+}
+
+void tilda_terminal_search_rewind (tilda_term *tt)
+{
+    GtkAdjustment *adjustment;
+
+    /* Without a selection VTE searches from the top of the viewport
+     * forward and from its bottom backward. */
+    vte_terminal_unselect_all (VTE_TERMINAL (tt->vte_term));
+
+    if (tt->search_anchor >= 0) {
+        adjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (tt->vte_term));
+        gtk_adjustment_set_value (adjustment, tt->search_anchor);
+    }
+}
+
 void tilda_term_set_scrollbar_position (tilda_term *tt, enum tilda_term_scrollbar_positions pos)
 {
     DEBUG_FUNCTION ("tilda_term_set_scrollbar_position");
@@ -271,13 +450,26 @@ static void window_title_changed_cb (GtkWidget *widget, gpointer data)
     DEBUG_ASSERT (widget != NULL);
     DEBUG_ASSERT (data != NULL);
 
-    tilda_term *tt = TILDA_TERM(data);
+    tilda_metrics_count (TILDA_METRIC_TITLE_CHANGES);
+    tilda_terminal_update_title (TILDA_TERM(data));
+    tilda_dbus_actions_notify_title_changed (TILDA_TERM(data)->tw, TILDA_TERM(data)->id);
+}
+
+void tilda_terminal_update_title (tilda_term *tt)
+{
+    DEBUG_FUNCTION ("tilda_terminal_update_title");
+    DEBUG_ASSERT (tt != NULL);
+
     gchar * title = tilda_terminal_get_title (tt);
-    gchar * full_title = tilda_terminal_get_full_title (tt);
     GtkWidget *label;
 
     label = gtk_notebook_get_tab_label (GTK_NOTEBOOK (tt->tw->notebook), tt->hbox);
 
+    if (label == NULL) {
+        g_free (title);
+        return;
+    }
+
     /* We need to check if the widget that received the title change is the currently
      * active tab. If not we should not update the window title. */
     gint page = gtk_notebook_get_current_page (GTK_NOTEBOOK (tt->tw->notebook));
@@ -286,7 +478,7 @@ static void window_title_changed_cb (GtkWidget *widget, gpointer data)
     if (page >= 0) {
         tilda_term *currente_term;
         currente_term = g_list_nth_data (tt->tw->terms, (guint) page);
-        active = widget == currente_term->vte_term;
+        active = tt == currente_term;
     } else {
         active = TRUE;
     }
@@ -297,12 +489,132 @@ static void window_title_changed_cb (GtkWidget *widget, gpointer data)
         gtk_window_set_title (GTK_WINDOW (tt->tw->window), title);
     }
 
-    if(config_getbool("show_title_tooltip"))
-      gtk_widget_set_tooltip_text(label, full_title);
-    else
-      gtk_widget_set_tooltip_text(label, "");
+    tilda_terminal_update_tooltip (tt);
 
     g_free (title);
+
+    tilda_session_mark_dirty (tt->tw);
+}
+
+void tilda_terminal_update_tooltip (tilda_term *tt)
+{
+    DEBUG_FUNCTION ("tilda_terminal_update_tooltip");
+    DEBUG_ASSERT (tt != NULL);
+
+    GtkWidget *label;
+    GString *tooltip;
+
+    label = gtk_notebook_get_tab_label (GTK_NOTEBOOK (tt->tw->notebook), tt->hbox);
+
+    if (label == NULL) {
+        return;
+    }
+
+    tooltip = g_string_new (NULL);
+
+    if (config_getbool ("show_title_tooltip")) {
+        gchar *full_title = tilda_terminal_get_full_title (tt);
+        g_string_append (tooltip, full_title);
+        g_free (full_title);
+    }
+
+    if (tt->resources_valid) {
+        gchar *memory = g_format_size (tt->memory_usage);
+        gchar *io_rate = g_format_size (tt->io_rate);
+
+        if (tooltip->len > 0) {
+            g_string_append_c (tooltip, '\n');
+        }
+
+        g_string_append_printf (tooltip, _("CPU: %.1f%%, Memory: %s, I/O: %s/s"),
+                                tt->cpu_usage, memory, io_rate);
+
+        g_free (memory);
+        g_free (io_rate);
+    }
+
+    if (tt->restart_count > 0 || tt->restart_gave_up) {
+        if (tooltip->len > 0) {
+            g_string_append_c (tooltip, '\n');
+        }
+
+        g_string_append_printf (tooltip, _("Restarts: %u, consecutive failures: %u, last exit status: %d"),
+                                tt->restart_count, tt->restart_failures, tt->restart_last_status);
+    }
+
+    if (tilda_recorder_get_path (tt) != NULL) {
+        if (tooltip->len > 0) {
+            g_string_append_c (tooltip, '\n');
+        }
+
+        g_string_append_printf (tooltip, _("Recording to %s"), tilda_recorder_get_path (tt));
+    }
+
+    gtk_widget_set_tooltip_text (label, tooltip->str);
+
+    g_string_free (tooltip, TRUE);
+}
+
+static void contents_changed_cb (G_GNUC_UNUSED GtkWidget *widget, gpointer data)
+{
+    tilda_term *tt = TILDA_TERM(data);
+
+    tilda_foreground_queue_update (tt);
+    tilda_session_mark_term_dirty (tt);
+    tilda_watch_contents_changed (tt);
+
+    tt->output_seen = TRUE;
+
+    if (tt->pid > 0) {
+        tilda_startup_profile_first_prompt ();
+
+        if (tt->spawn_start_time != 0) {
+            tilda_metrics_observe (TILDA_METRIC_PROMPT_TIME,
+                                   g_get_monotonic_time () - tt->spawn_start_time);
+            tt->spawn_start_time = 0;
+        }
+    }
+}
+
+/* Shells with integration for VTE (e.g. by sourcing vte.sh) report their
+ * working directory with an OSC 7 escape sequence each time it changes. */
+static void current_directory_uri_changed_cb (GtkWidget *widget, gpointer data)
+{
+    DEBUG_FUNCTION ("current_directory_uri_changed_cb");
+    DEBUG_ASSERT (widget != NULL);
+    DEBUG_ASSERT (data != NULL);
+
+    tilda_term *tt = TILDA_TERM(data);
+    const gchar *uri;
+    gchar *hostname = NULL;
+    gchar *cwd;
+
+    uri = vte_terminal_get_current_directory_uri (VTE_TERMINAL (widget));
+
+    if (uri == NULL) {
+        return;
+    }
+
+    cwd = g_filename_from_uri (uri, &hostname, NULL);
+
+    /* A remote shell (e.g. over ssh) reports directories of another host,
+     * which cannot be used to start a local shell, so we ignore them. */
+    if (cwd != NULL && hostname != NULL && hostname[0] != '\0'
+        && g_strcmp0 (hostname, "localhost") != 0
+        && g_strcmp0 (hostname, g_get_host_name ()) != 0)
+    {
+        g_clear_pointer (&cwd, g_free);
+    }
+
+    if (cwd != NULL) {
+        g_free (tt->cwd);
+        tt->cwd = cwd;
+
+        /* The title may contain the working directory */
+        tilda_terminal_update_title (tt);
+    }
+
+    g_free (hostname);
 }
 
 static void iconify_window_cb (G_GNUC_UNUSED GtkWidget *widget, gpointer data)
@@ -410,6 +722,11 @@ void tilda_term_adjust_font_scale(tilda_term *term, gdouble scale) {
 }
 
 /* Returns the working directory of the terminal
+ *
+ * The directory reported by the shell via OSC 7 is preferred, since it is
+ * cached and also correct if a subprocess such as a nested shell owns the
+ * terminal. Only if the shell does not report its directory we fall back
+ * to reading the working directory of the shell process from /proc.
  *
  * @param tt the tilda_term to get working directory of
  *
@@ -422,21 +739,30 @@ char* tilda_term_get_cwd(struct tilda_term_* tt)
     char *cwd;
     GError *error = NULL;
 
+    if (tt->cwd != NULL)
+    {
+        return g_strdup (tt->cwd);
+    }
+
     if (tt->pid < 0)
     {
-        return NULL;
+        /* The shell has not been spawned yet, so the directory it
+         * will be started in is the best answer we have. */
+        return g_strdup (tt->initial_working_dir);
     }
 
     file = g_strdup_printf ("/proc/%d/cwd", tt->pid);
     cwd = g_file_read_link (file, &error);
-    g_free (file);
 
     if (cwd == NULL)
     {
-        g_printerr (_("Problem reading link %s: %s\n"), file, error->message);
+        /* This is expected if the shell has just exited */
+        g_debug ("Problem reading link %s: %s", file, error->message);
         g_error_free (error);
     }
 
+    g_free (file);
+
     return cwd;
 }
 
@@ -451,6 +777,7 @@ shell_spawned_cb (VteTerminal *terminal,
     tilda_term *tt;
 
     tt = user_data;
+    tt->spawn_pending = FALSE;
 
     if (error)
     {
@@ -458,7 +785,8 @@ shell_spawned_cb (VteTerminal *terminal,
         {
             g_printerr (_("Unable to launch default shell: %s\n"), get_default_command ());
         } else {
-            g_printerr (_("Unable to launch custom command: %s\n"), config_getstr ("command"));
+            g_printerr (_("Unable to launch custom command: %s\n"),
+                        tt->command != NULL ? tt->command : config_getstr ("command"));
             g_printerr (_("Launching custom command failed with error: %s\n"), error->message);
             g_printerr (_("Launching default shell instead\n"));
 
@@ -466,10 +794,61 @@ shell_spawned_cb (VteTerminal *terminal,
             tt->dropped_to_default_shell = TRUE;
         }
 
+        /* Nothing will receive the input if no shell is spawned again */
+        if (!tt->spawn_pending && tt->pending_input != NULL) {
+            g_string_free (tt->pending_input, TRUE);
+            tt->pending_input = NULL;
+        }
+
         return;
     }
 
     tt->pid = pid;
+
+    tilda_metrics_observe (TILDA_METRIC_SPAWN_TIME, g_get_monotonic_time () - tt->spawn_start_time);
+    tilda_restart_command_started (tt);
+
+    if (tt->pending_input != NULL) {
+        GString *input = tt->pending_input;
+
+        tt->pending_input = NULL;
+        tilda_term_feed_child (tt, input->str, (gssize) input->len);
+        g_string_free (input, TRUE);
+    }
+}
+
+/* Spawns the command into the terminal, through the tee of the recorder
+ * if recording is enabled. */
+static void
+spawn_command (tilda_term *tt,
+               const gchar *working_dir,
+               gchar **argv,
+               gchar **envv,
+               GSpawnFlags flags,
+               gint command_timeout)
+{
+    tt->spawn_start_time = g_get_monotonic_time ();
+    tt->spawn_pending = TRUE;
+
+    if (tilda_recorder_is_enabled ()) {
+        tilda_recorder_spawn_async (tt, working_dir, argv, envv, flags,
+                                    command_timeout, shell_spawned_cb, tt);
+        return;
+    }
+
+    vte_terminal_spawn_async (VTE_TERMINAL (tt->vte_term),
+                              VTE_PTY_DEFAULT, /* VtePtyFlags pty_flags */
+                              working_dir, /* const char *working_directory */
+                              argv, /* char **argv */
+                              envv, /* char **envv */
+                              flags,    /* GSpawnFlags spawn_flags */
+                              NULL, /* GSpawnChildSetupFunc child_setup */
+                              NULL, /* gpointer child_setup_data */
+                              NULL, /* GDestroyNotify child_setup_data_destroy */
+                              command_timeout, /* timeout in ms */
+                              NULL, /* GCancellable * cancellable, */
+                              shell_spawned_cb,  /* VteTerminalSpawnAsyncCallback callback */
+                              tt);   /* user_data */
 }
 
 /* Fork a shell into the VTE Terminal
@@ -486,9 +865,11 @@ static void start_shell (tilda_term *tt, gboolean ignore_custom_command)
     gchar **argv;
     GError *error = NULL;
 
-    if (config_getbool ("run_command") && !ignore_custom_command)
+    if ((tt->command != NULL || config_getbool ("run_command")) && !ignore_custom_command)
     {
-        ret = g_shell_parse_argv (config_getstr ("command"), &argc, &argv, &error);
+        const gchar *command = tt->command != NULL ? tt->command : config_getstr ("command");
+
+        ret = g_shell_parse_argv (command, &argc, &argv, &error);
 
         /* Check for error */
         if (ret == FALSE)
@@ -512,19 +893,7 @@ static void start_shell (tilda_term *tt, gboolean ignore_custom_command)
         envv[0] = path_prefixed;
         envv[1] = NULL;
 
-        vte_terminal_spawn_async (VTE_TERMINAL (tt->vte_term),
-                                  VTE_PTY_DEFAULT, /* VtePtyFlags pty_flags */
-                                  working_dir, /* const char *working_directory */
-                                  argv, /* char **argv */
-                                  envv, /* char **envv */
-                                  G_SPAWN_SEARCH_PATH,    /* GSpawnFlags spawn_flags */
-                                  NULL, /* GSpawnChildSetupFunc child_setup */
-                                  NULL, /* gpointer child_setup_data */
-                                  NULL, /* GDestroyNotify child_setup_data_destroy */
-                                  command_timeout, /* timeout in ms */
-                                  NULL, /* GCancellable * cancellable, */
-                                  shell_spawned_cb,  /* VteTerminalSpawnAsyncCallback callback */
-                                  tt);   /* user_data */
+        spawn_command (tt, working_dir, argv, envv, G_SPAWN_SEARCH_PATH, command_timeout);
 
         g_strfreev (argv);
         g_free (envv);
@@ -578,19 +947,7 @@ start_default_shell (tilda_term *tt)
         argv[1] = NULL;
     }
 
-    vte_terminal_spawn_async (VTE_TERMINAL (tt->vte_term),
-                              VTE_PTY_DEFAULT, /* VtePtyFlags pty_flags */
-                              working_dir, /* const char *working_directory */
-                              argv, /* char **argv */
-                              NULL, /* char **envv */
-                              flags,    /* GSpawnFlags spawn_flags */
-                              NULL, /* GSpawnChildSetupFunc child_setup */
-                              NULL, /* gpointer child_setup_data */
-                              NULL, /* GDestroyNotify child_setup_data_destroy */
-                              command_timeout, /* timeout in ms */
-                              NULL, /* GCancellable * cancellable, */
-                              shell_spawned_cb,  /* VteTerminalSpawnAsyncCallback callback */
-                              tt);   /* user_data */
+    spawn_command (tt, working_dir, argv, NULL, flags, command_timeout);
 
     g_free(argv1);
     g_free (argv);
@@ -615,6 +972,11 @@ gchar *get_working_directory (tilda_term *terminal)
 
     working_dir = terminal->initial_working_dir;
 
+    if (terminal->explicit_working_dir && working_dir != NULL)
+    {
+        return working_dir;
+    }
+
     if (working_dir == NULL || config_getbool ("inherit_working_dir") == FALSE)
     {
         working_dir = config_getstr ("working_dir");
@@ -633,6 +995,13 @@ static void child_exited_cb (GtkWidget *widget, gint status, gpointer data)
 
     gint index = gtk_notebook_page_num (GTK_NOTEBOOK(tt->tw->notebook), tt->hbox);
 
+    /* The shell is gone, so are its process and its working directory */
+    tt->pid = -1;
+    g_clear_pointer (&tt->cwd, g_free);
+
+    tilda_foreground_queue_update (tt);
+    tilda_dbus_actions_notify_process_exited (tt->tw, tt->id, status);
+
     /* Make sure we got a valid index */
     if (index == -1)
     {
@@ -652,11 +1021,11 @@ static void child_exited_cb (GtkWidget *widget, gint status, gpointer data)
             tilda_window_close_tab (tt->tw, index, FALSE);
             break;
         case RESTART_COMMAND:
-            vte_terminal_feed (VTE_TERMINAL(tt->vte_term), "\r\n\r\n", 4);
-            start_shell (tt, FALSE);
+            tilda_restart_command_exited (tt, status);
             break;
         case DROP_TO_DEFAULT_SHELL:
-            tt->initial_working_dir = NULL;
+            g_clear_pointer (&tt->initial_working_dir, g_free);
+            tt->explicit_working_dir = FALSE;
             start_default_shell (tt);
             tt->dropped_to_default_shell = TRUE;
             break;
@@ -814,6 +1183,18 @@ key_press_cb (GtkWidget *widget,
 {
     DEBUG_ASSERT (terminal != NULL);
 
+    if (event->key.keyval == GDK_KEY_Escape && tilda_paste_cancel (terminal)) {
+        return GDK_EVENT_STOP;
+    }
+
+    /* Enter restarts a command whose restart is pending or was given up */
+    if (terminal->pid < 0
+        && (event->key.keyval == GDK_KEY_Return || event->key.keyval == GDK_KEY_KP_Enter)
+        && tilda_restart_now (terminal))
+    {
+        return GDK_EVENT_STOP;
+    }
+
     handle_gdk_event (widget, event, terminal);
 
     return GDK_EVENT_PROPAGATE;
@@ -906,6 +1287,66 @@ static void handle_left_button_click (GtkWidget * window,
     }
 }
 
+/* Expands the placeholders in the configured title:
+ *
+ *   %p  the name of the process in the foreground
+ *   %w  the working directory
+ *   %%  a literal percent sign
+ */
+gchar *tilda_terminal_expand_title (tilda_term *tt, const gchar *format)
+{
+    GString *result;
+    const gchar *cwd;
+    const gchar *home;
+
+    if (strchr (format, '%') == NULL) {
+        return g_strdup (format);
+    }
+
+    result = g_string_new (NULL);
+
+    for (const gchar *c = format; *c != '\0'; c++)
+    {
+        if (*c != '%' || c[1] == '\0') {
+            g_string_append_c (result, *c);
+            continue;
+        }
+
+        c++;
+
+        switch (*c)
+        {
+            case 'p':
+                if (tt->foreground_name != NULL) {
+                    g_string_append (result, tt->foreground_name);
+                }
+                break;
+            case 'w':
+                cwd = tt->cwd != NULL ? tt->cwd : tt->title_cwd;
+                home = g_get_home_dir ();
+
+                if (cwd != NULL && g_str_has_prefix (cwd, home)
+                    && (cwd[strlen (home)] == '/' || cwd[strlen (home)] == '\0'))
+                {
+                    g_string_append_c (result, '~');
+                    g_string_append (result, cwd + strlen (home));
+                } else if (cwd != NULL) {
+                    g_string_append (result, cwd);
+                }
+                break;
+            case '%':
+                g_string_append_c (result, '%');
+                break;
+            default:
+                g_string_append_c (result, '%');
+                g_string_append_c (result, *c);
+                break;
+        }
+    }
+
+    return g_string_free (result, FALSE);
+}
+
 gchar * tilda_terminal_get_full_title (tilda_term *tt)
 {
     DEBUG_FUNCTION ("tilda_terminal_get_title");
@@ -917,7 +1358,7 @@ gchar * tilda_terminal_get_full_title (tilda_term *tt)
 
     vte_title = vte_terminal_get_window_title (VTE_TERMINAL (tt->vte_term));
     window_title = g_strdup (vte_title);
-    initial = g_strdup (config_getstr ("title"));
+    initial = tilda_terminal_expand_title (tt, config_getstr ("title"));
 
     /* These are not needed anywhere else. If they ever are, move them to a header file */
     enum d_set_title { NOT_DISPLAYED, AFTER_INITIAL, BEFORE_INITIAL, REPLACE_INITIAL };
@@ -27,6 +27,15 @@ G_BEGIN_DECLS
 
 typedef struct tilda_term_ tilda_term;
 
+/* The mark of a background tab, see tilda-activity.c */
+enum tilda_activity_state {
+    TILDA_ACTIVITY_NONE,
+    /* The tab produced output while it was not shown */
+    TILDA_ACTIVITY_OUTPUT,
+    /* The tab has been quiet for a while after it produced output */
+    TILDA_ACTIVITY_SILENCE
+};
+
 struct tilda_term_
 {
     GtkWidget *vte_term;
@@ -42,6 +51,96 @@ struct tilda_term_
      */
     gboolean dropped_to_default_shell;
     gchar *initial_working_dir;
+    /* The working directory last reported by the shell via OSC 7, or NULL */
+    gchar *cwd;
+    /* If TRUE the initial_working_dir was requested explicitly (e.g. by a
+     * restored session) and is used even if inherit_working_dir is off. */
+    gboolean explicit_working_dir;
+    /* A command that overrides the configured custom command, or NULL. */
+    gchar *command;
+    /* TRUE while the shell of this terminal has not been spawned yet. */
+    gboolean spawn_deferred;
+    /* TRUE from the start of spawning the shell until it is running or
+     * spawning it failed. */
+    gboolean spawn_pending;
+
+    /* Input that was sent with tilda_term_feed_child() while spawning the
+     * shell was deferred or pending, or NULL. */
+    GString *pending_input;
+
+    /* When spawning the shell was started, for the spawn time and prompt
+     * time metrics. Reset to 0 once the shell printed its first output. */
+    gint64 spawn_start_time;
+
+    /* A process wide unique and stable identifier of this terminal. */
+    guint id;
+
+    /* The process group in the foreground of the terminal, its name and
+     * whether it is a process other than the shell. These are maintained
+     * by tilda-foreground.c. */
+    GPid foreground_pid;
+    gchar *foreground_name;
+    gboolean busy;
+
+    /* The working directory of the shell for the %w title placeholder if
+     * the shell does not report it. Reading it from /proc on every title
+     * change is too expensive, so tilda-foreground.c refreshes it together
+     * with the foreground process. */
+    gchar *title_cwd;
+
+    /* The resource usage of the process tree of the shell, maintained
+     * by tilda-proc-monitor.c. resources_valid is FALSE until the first
+     * measurement is available. */
+    gboolean resources_valid;
+    gdouble cpu_usage;
+    guint64 memory_usage;
+    guint64 io_rate;
+
+    /* The state of the restart supervisor in tilda-restart.c. The number
+     * of restarts, the consecutive and the recent failures of the command
+     * and its last exit status are shown in the tab tooltip. */
+    gint64 restart_started_time;
+    guint restart_count;
+    guint restart_failures;
+    gint64 restart_window_start;
+    guint restart_window_failures;
+    gint restart_last_status;
+    gint64 restart_deadline;
+    guint restart_source;
+    gboolean restart_gave_up;
+
+    /* The large paste that is running in the terminal, or NULL. See
+     * tilda-paste.c */
+    struct tilda_paste_ *paste;
+
+    /* The tee and recording of the terminal if it was spawned with
+     * recording enabled, or NULL. See tilda-recorder.c */
+    struct tilda_recorder_ *recorder;
+
+    /* The output watchers of this tab and the scan position, or NULL if
+     * the tab was never watched. See tilda-watch.c */
+    struct tilda_watch_ *watch;
+
+    /* Activity and silence monitoring, see tilda-activity.c. The
+     * contents-changed handler only sets output_seen, everything else is
+     * evaluated by a timer of the window. monitor_silence is the number of
+     * seconds of silence after which the tab is marked, 0 if disabled. */
+    gboolean output_seen;
+    gboolean monitor_activity;
+    guint monitor_silence;
+    gboolean silence_armed;
+    gint64 last_output_time;
+    enum tilda_activity_state activity_state;
+
+    /* Set when the content of the terminal changed since the session
+     * was saved the last time. */
+    gboolean session_dirty;
+    /* Name of the file in the session directory that holds the saved
+     * scrollback of this terminal, or NULL. */
+    gchar *session_scrollback_file;
+
+    /* The scroll position where the incremental search started, or -1 */
+    gdouble search_anchor;
 
     struct tilda_window_ *tw;
 };
@@ -69,6 +168,53 @@ enum delete_keys { ASCII_DELETE, DELETE_SEQUENCE, ASCII_BACKSPACE, AUTO };
  */
 struct tilda_term_ *tilda_term_init (struct tilda_window_ *tw, gint position);
 
+/**
+ * tilda_term_init_full ()
+ *
+ * Like tilda_term_init() but allows to specify the working directory and the
+ * command of the new terminal.
+ *
+ * @param working_dir The working directory of the new terminal or NULL to
+ * determine the working directory from the configuration and the current tab.
+ *
+ * @param command The command to run in the terminal or NULL to run the
+ * configured command or the default shell.
+ *
+ * @param defer_spawn If TRUE the shell is not spawned until
+ * tilda_term_spawn_deferred() is called.
+ */
+struct tilda_term_ *tilda_term_init_full (struct tilda_window_ *tw,
+                                          gint position,
+                                          const gchar *working_dir,
+                                          const gchar *command,
+                                          gboolean defer_spawn);
+
+/**
+ * tilda_term_spawn_deferred ()
+ *
+ * Spawns the shell of a terminal that was created with defer_spawn set to TRUE.
+ * Does nothing if the shell has already been spawned.
+ */
+void tilda_term_spawn_deferred (tilda_term *tt);
+
+/**
+ * tilda_term_respawn ()
+ *
+ * Starts the command of a terminal again after it has exited.
+ */
+void tilda_term_respawn (tilda_term *tt);
+
+/**
+ * tilda_term_feed_child ()
+ *
+ * Sends text to the shell of the terminal as if it was typed. Text that is
+ * sent before the shell has been spawned is kept until it is running.
+ *
+ * Returns: FALSE if the shell has exited, e.g. in a tab that is held open
+ * after its command finished, and the text was dropped.
+ */
+gboolean tilda_term_feed_child (tilda_term *tt, const gchar *text, gssize length);
+
 /**
  * tilda_term_free ()
  *
@@ -92,8 +238,39 @@ void tilda_term_adjust_font_scale(tilda_term *term, gdouble scale);
 gchar * tilda_terminal_get_full_title (tilda_term *tt);
 gchar * tilda_terminal_get_title (tilda_term *tt);
 
+/* Expands the placeholders %p (foreground process), %w (working directory)
+ * and %% in a title format. The result must be freed with g_free. */
+gchar * tilda_terminal_expand_title (tilda_term *tt, const gchar *format);
+
+/* Updates the tab label, tooltip and if the terminal is active the window
+ * title with the current title of the terminal. */
+void tilda_terminal_update_title (tilda_term *tt);
+
+/* Updates the tooltip of the tab label with the full title and the
+ * resource usage of the terminal. */
+void tilda_terminal_update_tooltip (tilda_term *tt);
+
 void tilda_terminal_update_matches (tilda_term *tt);
 
+/* Searches the terminal for the next or previous match of regex and
+ * selects it. Returns TRUE if a match was found. */
+gboolean tilda_terminal_search (tilda_term *tt,
+                                VteRegex *regex,
+                                gboolean backward,
+                                gboolean wrap_around);
+
+/* Remembers the scroll position as the anchor of an incremental search */
+void tilda_terminal_search_set_anchor (tilda_term *tt);
+
+/* Clears the selection and scrolls back to the anchor, so that the next
+ * search starts from the anchor again. */
+void tilda_terminal_search_rewind (tilda_term *tt);
+
+/* Returns the text of the rows from start_row up to but excluding end_row.
+ * Rows are separated by newlines unless they are wrapped. The result must
+ * be freed with g_free. */
+gchar * tilda_terminal_get_rows_text (tilda_term *tt, glong start_row, glong end_row);
+
 #define TILDA_TERM(tt) ((tilda_term *)(tt))
 
 G_END_DECLS
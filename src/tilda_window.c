@@ -20,6 +20,20 @@
 #include "configsys.h"
 #include "tilda_window.h"
 #include "tilda_terminal.h"
+#include "tilda-activity.h"
+#include "tilda-cpu-policy.h"
+#include "tilda-dbus-actions.h"
+#include "tilda-foreground.h"
+#include "tilda-metrics.h"
+#include "tilda-paste.h"
+#include "tilda-proc-monitor.h"
+#include "tilda-search-all.h"
+#include "tilda-search-counter.h"
+#include "tilda-search-highlight.h"
+#include "tilda-session.h"
+#include "tilda-startup.h"
+#include "tilda-startup-profile.h"
+#include "tilda-watch.h"
 #include "key_grabber.h"
 
 #include <math.h>
@@ -103,8 +117,18 @@ void tilda_window_close_current_tab (tilda_window *tw)
     DEBUG_ASSERT (tw != NULL);
 
     gboolean can_close = TRUE;
+    tilda_term *tt = tilda_window_get_current_terminal (tw);
 
-    if (config_getbool ("confirm_close_tab")) {
+    if (config_getbool ("confirm_close_running") && tt != NULL && tilda_foreground_is_busy (tt)) {
+        gchar *message = g_markup_printf_escaped (
+                _("The process <b>%s</b> is still running in this tab. "
+                  "Are you sure you want to close this tab?"),
+                tt->foreground_name != NULL ? tt->foreground_name : "");
+
+        can_close = show_confirmation_dialog (tw, message);
+
+        g_free (message);
+    } else if (config_getbool ("confirm_close_tab")) {
         char * message = _("Are you sure you want to close this tab?");
 
         can_close = show_confirmation_dialog (tw, message);
@@ -251,21 +275,62 @@ search_cb (TildaSearchBox       *search,
            gboolean              wrap_on_search,
            tilda_window         *tw)
 {
-  VteTerminal *vte_terminal;
   tilda_term *term;
 
   term = tilda_window_get_current_terminal (tw);
 
-  vte_terminal = VTE_TERMINAL (term->vte_term);
-
-  vte_terminal_search_set_regex (vte_terminal, regex, (GRegexMatchFlags) 0);
+  return tilda_terminal_search (term, regex,
+                                direction == SEARCH_BACKWARD,
+                                wrap_on_search);
+}
 
-  vte_terminal_search_set_wrap_around (vte_terminal, wrap_on_search);
+static void
+search_all_tabs_cb (TildaSearchBox *search,
+                    GRegex         *regex,
+                    tilda_window   *tw)
+{
+  if (regex == NULL)
+    tilda_search_all_cancel (tw);
+  else
+    tilda_search_all_start (tw, regex);
+}
 
-  if (direction == SEARCH_BACKWARD)
-    return vte_terminal_search_find_previous (vte_terminal);
+static void
+count_matches_cb (TildaSearchBox       *search,
+                  GRegex               *regex,
+                  TildaSearchDirection  direction,
+                  tilda_window         *tw)
+{
+  if (regex == NULL)
+    tilda_search_counter_stop (tw);
   else
-    return vte_terminal_search_find_next (vte_terminal);
+    tilda_search_counter_update (tw, regex, direction);
+
+  tilda_search_highlight_set_regex (tw, regex);
+}
+
+static void
+search_rewind_cb (TildaSearchBox *search,
+                  gboolean        anchor,
+                  tilda_window   *tw)
+{
+  tilda_term *term;
+
+  term = tilda_window_get_current_terminal (tw);
+
+  if (anchor)
+    tilda_terminal_search_set_anchor (term);
+
+  tilda_terminal_search_rewind (term);
+}
+
+static void
+search_result_activated_cb (TildaSearchBox *search,
+                            guint           tab_id,
+                            glong           row,
+                            tilda_window   *tw)
+{
+  tilda_search_all_show_result (tw, tab_id, row);
 }
 
 static void
@@ -692,16 +757,11 @@ static gint cpaste (tilda_window *tw)
     DEBUG_ASSERT (tw != NULL);
     DEBUG_ASSERT (tw->notebook != NULL);
 
-    GtkWidget *current_page;
-    GList *list;
+    tilda_term *tt = tilda_window_get_current_terminal (tw);
 
-    gint pos = gtk_notebook_get_current_page (GTK_NOTEBOOK (tw->notebook));
-    current_page = gtk_notebook_get_nth_page (GTK_NOTEBOOK (tw->notebook), pos);
-    list = gtk_container_get_children (GTK_CONTAINER (current_page));
-    if GTK_IS_SCROLLBAR(list->data) {
-        list = list->next;
+    if (tt != NULL) {
+        tilda_paste_clipboard (tt);
     }
-    vte_terminal_paste_clipboard (VTE_TERMINAL(list->data));
 
     return GDK_EVENT_STOP;
 }
@@ -781,6 +841,33 @@ static gint tilda_window_setup_keyboard_accelerators (tilda_window *tw)
     return 0;
 }
 
+static void setup_keyboard_accelerators_task (tilda_window *tw)
+{
+    tilda_window_setup_keyboard_accelerators (tw);
+}
+
+static void register_matches_task (tilda_window *tw)
+{
+    tw->matches_deferred = FALSE;
+
+    for (GList *item = tw->terms; item != NULL; item = item->next) {
+        tilda_terminal_update_matches (item->data);
+    }
+}
+
+/* A key press during startup may be one of the accelerators, so the
+ * remaining startup tasks are run before the key is handled. */
+static gboolean startup_key_press_cb (G_GNUC_UNUSED GtkWidget *widget,
+                                      G_GNUC_UNUSED GdkEvent *event,
+                                      tilda_window *tw)
+{
+    if (tw->startup_tasks != NULL) {
+        tilda_startup_finish (tw);
+    }
+
+    return GDK_EVENT_PROPAGATE;
+}
+
 static tilda_term* tilda_window_get_current_terminal (tilda_window *tw) {
     gint pos = gtk_notebook_get_current_page (GTK_NOTEBOOK (tw->notebook));
     if (pos >= 0) {
@@ -839,6 +926,8 @@ static void page_reordered_cb (GtkNotebook  *notebook,
             break;
         }
     }
+
+    tilda_session_mark_dirty (tw);
 }
 
 static void switch_page_cb (GtkNotebook *notebook,
@@ -856,6 +945,10 @@ static void switch_page_cb (GtkNotebook *notebook,
         counter++;
     }
 
+    /* Tabs restored from a session are only brought to life once
+     * they are shown for the first time. */
+    tilda_session_materialize_tab (tw, term);
+
     char * current_title = tilda_terminal_get_title (term);
 
     if (current_title != NULL) {
@@ -863,6 +956,15 @@ static void switch_page_cb (GtkNotebook *notebook,
     }
 
     g_free (current_title);
+
+    tilda_paste_update_progress (tw);
+    tilda_watch_tab_shown (term);
+    tilda_activity_tab_shown (term);
+
+    /* Only the selected tab is visible while the window is pulled down */
+    tilda_cpu_policy_update (tw, tw->current_state == STATE_DOWN ? (gint) page_num : -1);
+
+    tilda_session_mark_dirty (tw);
 }
 
 
@@ -883,19 +985,7 @@ gboolean tilda_window_init (const gchar *config_file, const gint instance, tilda
     /* Create the main window */
     tw->window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
 
-    GError* error = NULL;
-    GtkBuilder *gtk_builder = gtk_builder_new ();
-
-#if ENABLE_NLS
-    gtk_builder_set_translation_domain (gtk_builder, PACKAGE);
-#endif
-
-    if(!gtk_builder_add_from_resource (gtk_builder, "/org/tilda/tilda.ui", &error)) {
-        fprintf (stderr, "Error: %s\n", error->message);
-        g_error_free(error);
-        return FALSE;
-    }
-    tw->gtk_builder = gtk_builder;
+    gint64 phase_start;
 
     /* The gdk_x11_get_server_time call will hang if GDK_PROPERTY_CHANGE_MASK is not set */
     gdk_window_set_events(gdk_screen_get_root_window (gtk_widget_get_screen (tw->window)), GDK_PROPERTY_CHANGE_MASK);
@@ -943,9 +1033,12 @@ gboolean tilda_window_init (const gchar *config_file, const gint instance, tilda
 
     /* Add keyboard accelerators */
     tw->accel_group = NULL; /* We can redefine the accelerator group from the wizard; this shows that it's our first time defining it. */
-    tilda_window_setup_keyboard_accelerators (tw);
+    tilda_startup_add (tw, TILDA_STARTUP_ACCELERATORS, "deferred/accelerators",
+                       setup_keyboard_accelerators_task);
+    g_signal_connect (G_OBJECT(tw->window), "key-press-event", G_CALLBACK (startup_key_press_cb), tw);
 
     /* Create the notebook */
+    phase_start = g_get_monotonic_time ();
     tw->notebook = gtk_notebook_new ();
 
     /* Adding widget title for CSS selection */
@@ -987,16 +1080,28 @@ gboolean tilda_window_init (const gchar *config_file, const gint instance, tilda
     }
 
     g_object_unref (provider);
+    tilda_startup_profile_phase ("window-init/notebook", phase_start);
 
     /* Create the linked list of terminals */
     tw->terms = NULL;
 
-    /* Add the initial terminal */
-    if (!tilda_window_add_tab (tw))
+    tilda_watch_init (tw);
+
+    /* The first terminals are shown before their matches are registered */
+    tw->matches_deferred = TRUE;
+    tilda_startup_add (tw, TILDA_STARTUP_MATCHES, "deferred/matches", register_matches_task);
+
+    /* Restore the tabs of the last session, or add the initial terminal */
+    phase_start = g_get_monotonic_time ();
+    tilda_session_init (tw);
+
+    if (!tilda_session_restore (tw) && !tilda_window_add_tab (tw))
     {
         return FALSE;
     }
 
+    tilda_startup_profile_phase ("window-init/first-tab", phase_start);
+
     /* This is required in key_grabber.c to get the x11 server time,
      * since the specification requires this flag to be set when
      * gdk_x11_get_server_time() is called.
@@ -1019,27 +1124,44 @@ gboolean tilda_window_init (const gchar *config_file, const gint instance, tilda
 
     /* Setup the tilda window. The tilda window consists of a top level window that contains the following widgets:
      *   * The main_box holds a GtkNotebook with all the terminal tabs
+     *   * The paste_progress shows the progress of large pastes
      *   * The search_box holds the TildaSearchBox widget
      */
     GtkWidget *main_box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
     tw->search = tilda_search_box_new ();
+    tw->paste_progress = gtk_progress_bar_new ();
+    gtk_progress_bar_set_show_text (GTK_PROGRESS_BAR (tw->paste_progress), TRUE);
 
     GtkStyleContext *context = gtk_widget_get_style_context(main_box);
     gtk_style_context_add_class(context, GTK_STYLE_CLASS_BACKGROUND);
 
     gtk_container_add (GTK_CONTAINER(tw->window), main_box);
     gtk_box_pack_start (GTK_BOX (main_box), tw->notebook, TRUE, TRUE, 0);
+    gtk_box_pack_start (GTK_BOX (main_box), tw->paste_progress, FALSE, TRUE, 0);
     gtk_box_pack_start (GTK_BOX (main_box), tw->search, FALSE, TRUE, 0);
 
     g_signal_connect (tw->search, "search",
                       G_CALLBACK (search_cb), tw);
 
+    g_signal_connect (tw->search, "search-all-tabs",
+                      G_CALLBACK (search_all_tabs_cb), tw);
+
+    g_signal_connect (tw->search, "count-matches",
+                      G_CALLBACK (count_matches_cb), tw);
+
+    g_signal_connect (tw->search, "rewind",
+                      G_CALLBACK (search_rewind_cb), tw);
+
+    g_signal_connect (tw->search, "result-activated",
+                      G_CALLBACK (search_result_activated_cb), tw);
+
     g_signal_connect (tw->search, "focus-out",
                       G_CALLBACK (search_focus_out_cb), tw);
 
     /* Show the widgets */
     gtk_widget_show_all (main_box);
     gtk_widget_set_visible(tw->search, FALSE);
+    gtk_widget_set_visible (tw->paste_progress, FALSE);
     /* the tw->window widget will be shown later, by pull() */
 
     /* Position the window */
@@ -1059,7 +1181,9 @@ gboolean tilda_window_init (const gchar *config_file, const gint instance, tilda
 
     /* Create GDK resources now, to prevent crashes later on */
     gtk_widget_realize (tw->window);
+    phase_start = g_get_monotonic_time ();
     generate_animation_positions (tw);
+    tilda_startup_profile_phase ("window-init/animation-positions", phase_start);
 
     /* Initialize wizard window reference to NULL */
     tw->wizard_window = NULL;
@@ -1078,11 +1202,25 @@ gboolean tilda_window_init (const gchar *config_file, const gint instance, tilda
 
     gdk_window_add_filter (root, window_filter_function, tw);
 
+    tilda_proc_monitor_start (tw);
+    tilda_cpu_policy_init (tw);
+
     return TRUE;
 }
 
 gint tilda_window_free (tilda_window *tw)
 {
+    tilda_startup_free (tw);
+
+    /* The session must not record the tabs being closed below. */
+    tilda_session_free (tw);
+    tilda_search_all_free (tw);
+    tilda_search_counter_stop (tw);
+    tilda_search_highlight_free (tw);
+
+    tilda_proc_monitor_stop (tw);
+    tilda_cpu_policy_free (tw);
+    tilda_activity_stop (tw);
 
     /* Close each tab which still exists.
      * This will free their data structures automatically. */
@@ -1098,11 +1236,10 @@ gint tilda_window_free (tilda_window *tw)
         }
     }
 
+    tilda_watch_free (tw);
+
     g_free (tw->config_file);
     gtk_widget_destroy (tw->search);
-    if (tw->gtk_builder != NULL) {
-        g_object_unref (G_OBJECT(tw->gtk_builder));
-    }
 
     tw->size_update_event_source = 0;
 
@@ -1114,30 +1251,50 @@ gint tilda_window_add_tab (tilda_window *tw)
     DEBUG_FUNCTION ("tilda_window_add_tab");
     DEBUG_ASSERT (tw != NULL);
 
+    if (tilda_window_add_tab_full (tw, -1, NULL, NULL, FALSE) == NULL) {
+        return FALSE;
+    }
+
+    return GDK_EVENT_STOP; //index;
+}
+
+tilda_term *tilda_window_add_tab_full (tilda_window *tw,
+                                       gint position,
+                                       const gchar *working_dir,
+                                       const gchar *command,
+                                       gboolean defer_spawn)
+{
+    DEBUG_FUNCTION ("tilda_window_add_tab_full");
+    DEBUG_ASSERT (tw != NULL);
+
+    gint64 start_time = g_get_monotonic_time ();
     tilda_term *tt;
     GtkWidget *label;
+    gchar *title;
     gint index;
 
     /* Determine where to insert the new terminal */
-    index = -1;
-    if (config_getbool ("insert_tab_after_current")) {
+    index = position;
+    if (index < 0 && config_getbool ("insert_tab_after_current")) {
         index = 1 + gtk_notebook_get_current_page (GTK_NOTEBOOK(tw->notebook));
     }
 
     /* Initialize the terminal */
-    tt = tilda_term_init (tw, index);
+    tt = tilda_term_init_full (tw, index, working_dir, command, defer_spawn);
 
     if (tt == NULL)
     {
         TILDA_PERROR ();
         g_printerr (_("Out of memory, cannot create tab\n"));
-        return FALSE;
+        return NULL;
     }
 
-    /* Create page and insert it into the notebook */
-    label = gtk_label_new (config_getstr("title"));
+    /* Create page and insert it into the notebook, the title may contain
+     * placeholders so it needs to be expanded for the new terminal. */
+    title = tilda_terminal_expand_title (tt, config_getstr ("title"));
+    label = gtk_label_new (title);
+    g_free (title);
     index = gtk_notebook_insert_page (GTK_NOTEBOOK(tw->notebook), tt->hbox, label, index);
-    gtk_notebook_set_current_page (GTK_NOTEBOOK(tw->notebook), index);
     gtk_notebook_set_tab_reorderable (GTK_NOTEBOOK(tw->notebook), tt->hbox, TRUE);
 
     if(config_getbool ("expand_tabs")) {
@@ -1156,10 +1313,18 @@ gint tilda_window_add_tab (tilda_window *tw)
             config_getint("tab_pos") != NB_HIDDEN)
         gtk_notebook_set_show_tabs (GTK_NOTEBOOK (tw->notebook), TRUE);
 
-    /* The new terminal should grab the focus automatically */
-    gtk_widget_grab_focus (tt->vte_term);
+    /* A deferred terminal is created in the background, otherwise the new
+     * terminal becomes the current tab and should grab the focus automatically */
+    if (!defer_spawn) {
+        gtk_notebook_set_current_page (GTK_NOTEBOOK(tw->notebook), index);
+        gtk_widget_grab_focus (tt->vte_term);
+    }
 
-    return GDK_EVENT_STOP; //index;
+    tilda_session_mark_dirty (tw);
+    tilda_dbus_actions_notify_tab_created (tw, tt->id);
+    tilda_metrics_observe (TILDA_METRIC_TAB_CREATION_TIME, g_get_monotonic_time () - start_time);
+
+    return tt;
 }
 
 gint tilda_window_close_tab (tilda_window *tw, gint tab_index, gboolean force_exit)
@@ -1181,6 +1346,9 @@ gint tilda_window_close_tab (tilda_window *tw, gint tab_index, gboolean force_ex
 
     tt = find_tt_in_g_list (tw, tab_index);
 
+    tilda_dbus_actions_notify_tab_closed (tw, tt->id);
+    tilda_metrics_count (TILDA_METRIC_TABS_CLOSED);
+
     gtk_notebook_remove_page (GTK_NOTEBOOK (tw->notebook), tab_index);
 
     /* We should hide the tabs if there is only one tab left */
@@ -1236,6 +1404,8 @@ gint tilda_window_close_tab (tilda_window *tw, gint tab_index, gboolean force_ex
     /* Remove the tilda_term from the list of terminals */
     tw->terms = g_list_remove (tw->terms, tt);
 
+    tilda_session_mark_dirty (tw);
+
     /* Free the terminal, we are done with it */
     tilda_term_free (tt);
 
@@ -1247,8 +1417,23 @@ gint tilda_window_confirm_quit (tilda_window *tw)
     DEBUG_FUNCTION(__FUNCTION__);
 
     gboolean can_quit = TRUE;
+    guint busy = 0;
+
+    if (config_getbool ("confirm_close_running")) {
+        busy = tilda_foreground_count_busy (tw);
+    }
+
+    if (busy > 0) {
+        gchar *message = g_strdup_printf (
+                ngettext ("There is still a process running in %u tab. Are you sure you want to Quit?",
+                          "There are still processes running in %u tabs. Are you sure you want to Quit?",
+                          busy),
+                busy);
+
+        can_quit = show_confirmation_dialog (tw, message);
 
-    if(config_getbool("prompt_on_exit")) {
+        g_free (message);
+    } else if(config_getbool("prompt_on_exit")) {
         char * message = _("Are you sure you want to Quit?");
 
         can_quit = show_confirmation_dialog (tw, message);
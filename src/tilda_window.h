@@ -45,11 +45,14 @@ struct tilda_window_
     GtkWidget *window;
     GtkWidget *notebook;
     GtkWidget *search;
+    /* Shows the progress of a large paste into the current tab */
+    GtkWidget *paste_progress;
 
     GList *terms;
     GtkAccelGroup * accel_group;
-    GtkBuilder *gtk_builder;
-    GtkWidget *wizard_window; /* GtkDialog that contains the wizard */
+    /* GtkDialog that contains the wizard, its GtkBuilder is only loaded
+     * while the wizard is shown. */
+    GtkWidget *wizard_window;
 
     gchar *lock_file;
     gchar *config_file;
@@ -95,6 +98,62 @@ struct tilda_window_
      * This stores the ID of the event source which handles size updates.
      */
     guint size_update_event_source;
+
+    /* State of the session subsystem, NULL if sessions are disabled */
+    struct tilda_session_ *session;
+
+    /* The resource monitor, NULL if it is not running */
+    struct tilda_proc_monitor_ *proc_monitor;
+
+    /* The CPU policy for background tabs, NULL if it is disabled */
+    struct tilda_cpu_policy_ *cpu_policy;
+
+    /* The search across all tabs, NULL until the first such search */
+    struct tilda_search_all_ *search_all;
+
+    /* Counts the matches of the search in the current tab, NULL if the
+     * search bar is not in use */
+    struct tilda_search_counter_ *search_counter;
+
+    /* Highlights the matches of the search in the current tab, NULL if
+     * the search bar is not in use */
+    struct tilda_search_highlight_ *search_highlight;
+
+    /* The output watchers that apply to all tabs, see tilda-watch.c */
+    GList *watch_rules;
+
+    /* The timer that evaluates the activity and silence monitoring of the
+     * tabs, 0 while no tab is monitored. See tilda-activity.c */
+    guint activity_source;
+
+    /* The socket that accepts toggle commands from "tilda -T", NULL if
+     * D-Bus is not enabled. See tilda-control-socket.c */
+    struct tilda_control_socket_ *control_socket;
+
+    /* The exported D-Bus interface, NULL until the bus name was acquired */
+    GDBusInterfaceSkeleton *dbus_actions;
+
+    /* The ids of the tabs whose title changed since the last
+     * TabTitleChanged signals, and the timer that emits them */
+    GHashTable *dbus_pending_titles;
+    guint dbus_title_source;
+
+    /* The frame clock handler that records the tab switch time of the
+     * last FocusTab call and when that call was made */
+    gulong dbus_switch_paint_handler;
+    gint64 dbus_switch_time;
+
+    /* The initialization tasks that have not run yet, the idle callback
+     * or frame clock handler that runs them and when they were started.
+     * See tilda-startup.c */
+    GList *startup_tasks;
+    guint startup_source;
+    gulong startup_paint_handler;
+    gint64 startup_deferred_time;
+
+    /* TRUE until the startup task registered the match regexes of the
+     * terminals, new terminals do not register them before. */
+    gboolean matches_deferred;
 };
 
 /* For use in get_display_dimension() */
@@ -112,6 +171,23 @@ enum notebook_tab_positions { NB_TOP, NB_BOTTOM, NB_LEFT, NB_RIGHT, NB_HIDDEN };
  */
 gint tilda_window_add_tab (tilda_window *tw);
 
+/**
+ * tilda_window_add_tab_full ()
+ *
+ * Create and add a new tab with the given working directory and command at
+ * the given position. If position is negative the tab is placed according to
+ * the "insert_tab_after_current" option. If defer_spawn is TRUE, then the shell
+ * of the new tab is not spawned and the new tab does not become the current tab.
+ *
+ * Success: the new tilda_term
+ * Failure: NULL
+ */
+struct tilda_term_ *tilda_window_add_tab_full (tilda_window *tw,
+                                               gint position,
+                                               const gchar *working_dir,
+                                               const gchar *command,
+                                               gboolean defer_spawn);
+
 /**
  * tilda_window_close_tab ()
  *
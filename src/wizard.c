@@ -27,6 +27,7 @@
 #include "tilda-palettes.h"
 #include "tilda_window.h"
 #include "tilda-keybinding.h"
+#include "tilda-startup.h"
 
 #include <gtk/gtk.h>
 #include <gdk/gdkkeysyms.h>
@@ -79,6 +80,9 @@ gint wizard (tilda_window *tw)
         return 0;
     }
 
+    /* The wizard changes the key binding and the accelerators */
+    tilda_startup_finish (tw);
+
     TildaWizard *wizard = g_malloc (sizeof (TildaWizard));
 
     GError* error = NULL;
@@ -88,16 +92,17 @@ gint wizard (tilda_window *tw)
     gtk_builder_set_translation_domain (xml, PACKAGE);
 #endif
 
+    /* The wizard is the only user of tilda.ui, it is loaded each time the
+     * wizard is opened and released again in wizard_close_dialog(). */
     if(!gtk_builder_add_from_resource (xml, "/org/tilda/tilda.ui", &error)) {
-        g_prefix_error(&error, "Error:");
+        g_printerr (_("Unable to load the wizard: %s\n"), error->message);
+        g_error_free (error);
+        g_object_unref (xml);
+        xml = NULL;
+        g_free (wizard);
         return EXIT_FAILURE;
     }
 
-    if (!xml) {
-        g_warning ("problem while loading the tilda.ui file");
-        return 2;
-    }
-
     wizard->builder = xml;
     wizard->tw = tw;
 
@@ -0,0 +1,90 @@
+#!/bin/sh
+#
+# Checks the activity and silence marks of a monitored tab that is not
+# shown: the tab prints output, stays quiet for longer than the silence
+# interval and prints output again. It must be marked as active, silent and
+# active again, in this order.
+#
+# Usage: tests/activity-monitor.sh [TILDA]
+#
+#   TILDA  the tilda binary to run, defaults to "tilda"
+#
+# The test runs under xvfb-run and dbus-run-session if there is no display
+# or session bus. No other tilda may be running, the started instance must
+# be instance 0.
+
+set -eu
+
+TILDA=${1:-tilda}
+
+if [ -z "${DISPLAY:-}" ]; then
+    exec xvfb-run -a "$0" "$TILDA"
+fi
+
+if [ -z "${DBUS_SESSION_BUS_ADDRESS:-}" ]; then
+    exec dbus-run-session -- "$0" "$TILDA"
+fi
+
+# The silence interval in seconds
+SILENCE=2
+
+dir=$(mktemp -d)
+pid=
+monitor_pid=
+
+trap 'kill $monitor_pid $pid 2> /dev/null || true; wait 2> /dev/null || true; rm -rf "$dir"' EXIT
+
+call () {
+    method=$1
+    shift
+    gdbus call --session --dest com.github.lanoxx.tilda.Actions0 \
+        --object-path /com/github/lanoxx/tilda/Actions0 \
+        --method "com.github.lanoxx.tilda.Actions.$method" "$@"
+}
+
+cat > "$dir/config" <<CONFIG
+restore_session = false
+CONFIG
+
+XDG_CACHE_HOME="$dir/cache" "$TILDA" --dbus -g "$dir/config" > /dev/null 2>&1 &
+pid=$!
+
+waited=0
+until call ListTabs > /dev/null 2>&1; do
+    if ! kill -0 "$pid" 2> /dev/null || [ $waited -ge 300 ]; then
+        echo "tilda did not start" >&2
+        exit 1
+    fi
+
+    sleep 0.1
+    waited=$((waited + 1))
+done
+
+gdbus monitor --session --dest com.github.lanoxx.tilda.Actions0 > "$dir/signals" &
+monitor_pid=$!
+
+# Leaves enough time to enable the monitoring before the first output
+cat > "$dir/busy.sh" <<SCRIPT
+sleep 2
+echo busy
+sleep $((SILENCE + 3))
+echo busy again
+exec cat
+SCRIPT
+
+tab=$(call NewTab "''" "'sh $dir/busy.sh'" | sed -n 's/^(uint32 \([0-9]*\),)$/\1/p')
+
+# The monitored tab must not be shown
+call NewTab "''" "''" > /dev/null
+call SetTabMonitoring "$tab" true "$SILENCE" > /dev/null
+
+sleep $((SILENCE + 8))
+
+states=$(sed -n "s/.*TabStateChanged (uint32 $tab, '\([a-z]*\)').*/\1/p" "$dir/signals" | tr '\n' ' ')
+
+if [ "$states" != "activity silence activity " ]; then
+    echo "the tab was marked as: ${states:-nothing}, expected: activity silence activity" >&2
+    exit 1
+fi
+
+echo "the tab was marked as: $states"